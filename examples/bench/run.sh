@@ -7,3 +7,7 @@ perf stat -r 100 lua5.3     gcd.lua 2>> results.txt
 perf stat -r 100 perl       gcd.pl  2>> results.txt
 perf stat -r 100 ../../knit gcd.kn  2>> results.txt
 
+perf stat -r 20  ../../knit alloc_lists.kn   2>> results.txt
+perf stat -r 20  ../../knit alloc_strings.kn 2>> results.txt
+perf stat -r 20  ../../knit dict.kn          2>> results.txt
+perf stat -r 20  ../../knit sort.kn          2>> results.txt
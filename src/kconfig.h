@@ -1,6 +1,8 @@
 #ifndef KNIT_CONFIG_H
 #define KNIT_CONFIG_H
 
-#define KNIT_MEM_STATS
+//sampling allocation profiler, see knit_mem_stats.h
+//when it's not defined allocations go straight to malloc() with no bookkeeping at all
+//#define KNIT_MEM_PROFILE
 
 #endif
@@ -2,6 +2,7 @@
 #define KNIT_DATA_H
 
 #include "kconfig.h"
+#include "knit_bitset_data.h"
 
 #define KNIT_OBJ_HEAD \
     int ktype
@@ -10,23 +11,74 @@
 *   .len > 0 :   memory is owned by the object
 *   .len == -1 : memory is read only, and not owned by the object
 *   in both cases .len and .str are valid, .str points to the empty string if the string is just initialized
+* interned strings (KNIT_STR_INTERNED) are owned by the intern table of the state, there is only one of them per content
+* so two interned strings are equal iff their .str pointers are equal, they must never be mutated
+* ropes (KNIT_STR_ROPE) are the result of concatenation, .str is NULL and .len is valid, the contents are
+* rope_left followed by rope_right, knitx_str_flatten() must be called before accessing .str
+* views (KNIT_STR_VIEW) are substrings, .str points inside the buffer of view_base and is not null terminated,
+* knitx_str_materialize() gives them their own buffer, a string that has views (KNIT_STR_SHARED) must not be mutated
+* frozen strings (KNIT_STR_FROZEN) never change contents (they can still be flattened or materialized), interned and
+* frozen strings are immutable so dicts use them as keys without copying
 */
+enum KNIT_STR_FLAGS {
+    KNIT_STR_INTERNED = 1,
+    KNIT_STR_HASHED = 2, //.hash is valid, cleared by functions that mutate the string
+    KNIT_STR_ROPE = 4,
+    KNIT_STR_VIEW = 8,
+    KNIT_STR_SHARED = 16,
+    KNIT_STR_FROZEN = 32,
+};
+//concatenations shorter than this are copied right away instead of creating a rope
+#define KNIT_STR_ROPE_MINLEN 64
+//ropes deeper than this are flattened when they are created, s = s + x in a loop would otherwise keep a node per
+//iteration alive and fill the gc heap
+#define KNIT_STR_ROPE_MAXDEPTH 32
+//substrings shorter than this are copied instead of creating a view (which would keep the whole parent alive)
+#define KNIT_STR_VIEW_MINLEN 16
+//dict keys longer than this are copied instead of interned, to avoid growing the intern table with large runtime strings
+#define KNIT_STR_INTERN_MAXLEN 64
 struct knit_str {
     KNIT_OBJ_HEAD;
     char *str; //null terminated
     int len;
     int cap; //negative values mean memory is not owned by us (const char * passed to us)
+    int flags; //enum KNIT_STR_FLAGS
+    unsigned int hash; //lazily computed, only valid if KNIT_STR_HASHED is set
+    struct knit_str *rope_left;  //only valid if KNIT_STR_ROPE is set
+    struct knit_str *rope_right;
+    int rope_depth; //only valid if KNIT_STR_ROPE is set, nodes on the longest path down to a leaf
+    struct knit_str *view_base;  //only valid if KNIT_STR_VIEW is set, owns the buffer .str points into
 };
 
 struct knit_obj; //fwd
 struct knit; //fwd
 
+/*
+* lists pick their storage from the first element pushed into them and fall back to boxed storage
+* on the first store of an element of another type, the other storages hold the elements unboxed
+* slices of lists (l[a:b]) are views: .items points inside a buffer owned by view_base, a hidden list the slices and
+* the sliced list share (slicing a list moves its buffer there). a list with a view_base gets its own copy of its
+* elements before it is mutated (knitx_list_unshare()), so views never see each other's changes
+*/
+enum KNIT_LIST_MODE {
+    KNIT_LIST_BOXED, //.items
+    KNIT_LIST_INTS,  //.ints, the values of int elements
+    KNIT_LIST_BOOLS, //.bits, a bit per true/false element
+};
 struct knit_list {
     KNIT_OBJ_HEAD;
-    struct knit_obj **items;
+    union {
+        struct knit_obj **items;
+        int *ints;
+        unsigned char *bits;
+    };
     int len;
-    int cap;
+    int cap; //in elements
+    int mode; //enum KNIT_LIST_MODE
+    struct knit_list *view_base; //NULL when the list owns .items, otherwise the list that does
 };
+//slices shorter than this are copied instead of creating a view (which keeps all of the shared buffer alive)
+#define KNIT_LIST_VIEW_MINLEN 16
 
 
 #include "strhash/superfasthash.h" //in hasht dirs
@@ -40,24 +92,96 @@ struct knit_list {
 /*end of hashtable defs*/
 #include "knit_vars_hasht.h" //autogenerated hasht.h and prefixed by vars_
 
-/*hashtable defs*/
-//TODO, have a single convention for eq funcs return meaning
-    typedef struct knit_obj *kobj_hasht_key_type; 
-    typedef struct knit_obj *kobj_hasht_value_type; 
-    static int kobj_hasht_key_eq_cmp(void *udata, kobj_hasht_key_type *key_1, kobj_hasht_key_type *key_2);
-    static size_t kobj_hasht_hash(void *udata, kobj_hasht_key_type *key);
-/*end of hashtable defs*/
-#define KOBJ_HASHT_DATA_ARG
-#include "kobj_hasht.h"  //autogenerated hasht.h and prefixed by kobj_
-
+#define KNIT_DICT_GROUP_SZ 16
+struct knit_dict_entry {
+    struct knit_obj *key;
+    struct knit_obj *value;
+};
+//see knit_dict.h
 struct knit_dict {
     KNIT_OBJ_HEAD;
-    struct kobj_hasht ht;
+    int len; //entries in the hash part
+    int cap; //slots in the index, 0 or a power of 2 multiple of KNIT_DICT_GROUP_SZ
+    int *index; //the entry of each full slot
+    signed char *ctrl; //a control byte per slot, follows the index in the same allocation
+    struct knit_dict_entry *entries; //the hash part, dense and in insertion order
+    int entries_cap;
+    struct knit_obj **array; //array part, values of the int keys 0..array_cap-1, NULL where a key is missing
+    int array_cap;
 };
 struct knit_int {
     KNIT_OBJ_HEAD;
     int value;
 };
+//returned by range(), the ints begin, begin + step ... up to end (excluded), they are only boxed when iterated
+struct knit_range {
+    KNIT_OBJ_HEAD;
+    int begin;
+    int end;
+    int step; //never 0
+};
+//returned by bitset(n), n bits packed in 64 bit words (see knit_bitset.h)
+struct knit_bitset_obj {
+    KNIT_OBJ_HEAD;
+    struct knit_bitset bits;
+};
+enum KNIT_ARRAY_TYPE {
+    KNIT_ARRAY_INT32,
+    KNIT_ARRAY_INT64,
+    KNIT_ARRAY_UINT8,
+};
+//returned by array(type, n), len numbers of elem_type stored contiguously in data (see knit_array.h)
+struct knit_array {
+    KNIT_OBJ_HEAD;
+    int elem_type; //enum KNIT_ARRAY_TYPE
+    int len;
+    int owned; //0 when data belongs to the host (knitx_set_array()), it is then never freed or resized
+    void *data;
+};
+//returned by deque(), a ring buffer (see knit_queue.h)
+struct knit_deque {
+    KNIT_OBJ_HEAD;
+    struct knit_obj **items;
+    int head; //index of the first item in items
+    int len;
+    int cap; //0 or a power of 2
+};
+struct knit_pqueue_entry {
+    struct knit_obj *key;
+    struct knit_obj *item;
+};
+//returned by heap() and heap(key), a binary min-heap (see knit_queue.h)
+struct knit_pqueue {
+    KNIT_OBJ_HEAD;
+    struct knit_pqueue_entry *entries;
+    int len;
+    int cap;
+    int key_type; //KNIT_INT or KNIT_STR, the type of all the keys while the heap isn't empty
+    struct knit_obj *key_func; //NULL when the items are their own keys
+};
+enum KNIT_SET_MODE {
+    KNIT_SET_BITMAP, //only ints, as bits of a bitmap
+    KNIT_SET_HASH,
+};
+//returned by set(), see knit_set.h
+struct knit_set {
+    KNIT_OBJ_HEAD;
+    int mode; //enum KNIT_SET_MODE
+    int len; //number of elements
+    //KNIT_SET_HASH
+    int cap; //slots, 0 or a power of 2 multiple of KNIT_DICT_GROUP_SZ
+    int used; //full and deleted slots
+    struct knit_obj **slots; //the element of each full slot
+    signed char *ctrl; //a control byte per slot, follows the slots in the same allocation
+    //KNIT_SET_BITMAP, bit i is the int base + i, base is a multiple of 64
+    int base;
+    struct knit_bitset bits;
+};
+//returned by string_builder(), appends are amortized O(1) per byte
+struct knit_strbuilder {
+    KNIT_OBJ_HEAD;
+    struct knit_str buf;
+};
 
 
 #include "knit_objp_darray.h" //autogenerated darray.h and prefixed by knit_objp_
@@ -75,6 +199,9 @@ struct knit_block {
     //this can't contain self references, there is code that assumes it is memcopyable
     int nlocals;
     int nargs;
+    //once compiled, the block is packed (see knitx_block_pack()), constants and insns then live in one 
+    //exact-sized allocation owned by constants.data and they can't grow anymore
+    int packed;
     struct insns_darray insns;
     struct knit_objp_darray constants;
 };
@@ -104,6 +231,13 @@ struct knit_obj {
         struct knit_kfunc kfunc; //huge?
         struct knit_bvalue bval; 
         struct knit_dict dict;
+        struct knit_strbuilder strbuilder;
+        struct knit_range range;
+        struct knit_bitset_obj bitset;
+        struct knit_array array;
+        struct knit_deque deque;
+        struct knit_pqueue pqueue;
+        struct knit_set set;
     } u;
 };
 
@@ -135,6 +269,13 @@ enum KNIT_TYPE {
     KNIT_KFUNC,
     KNIT_TRUE,
     KNIT_FALSE,
+    KNIT_STRBUILDER,
+    KNIT_RANGE,
+    KNIT_BITSET,
+    KNIT_ARRAY,
+    KNIT_DEQUE,
+    KNIT_PQUEUE,
+    KNIT_SET,
 };
 enum KNIT_OPT {
     KNIT_POLICY_EXIT = 1, //default
@@ -178,7 +319,6 @@ struct knit_stack {
     struct knit_frame_darray frames; //contains information about function calls and IPs
     struct knit_objp_darray vals;    //contains the objects (ints, strs, lists ...) pushed on stack
 };
-#include "knit_bitset_data.h"
 /*
 Currently the heap size cannot change once objects are allocated
 this can be implemented in the following ways:
@@ -194,15 +334,40 @@ struct knit_heap {
     struct knit_obj *objects;
     int count;
     int capacity;
+    int next_free; //free objects are searched from here, wrapping around, so allocation doesn't rescan the full prefix
+    //objects allocated by the instruction being executed, they are roots for collections triggered
+    //by a full heap or the memory limit until they are stored somewhere reachable
+    struct knit_objp_darray nursery;
+};
+
+/*
+Small list item arrays and string buffers are carved out of big chunks by size class instead of going
+to malloc one by one. Freed blocks are kept in per class free lists (linked through their first bytes)
+and reused by the next allocation of the same class. Chunks are only returned when the state is deinitialized.
+*/
+#define KNIT_SLAB_MIN_SHIFT 4 //smallest class is 16 bytes, then 32, 64 ...
+#define KNIT_SLAB_NCLASSES  6 //up to 512 bytes, bigger blocks go to malloc
+#define KNIT_SLAB_CHUNK_SZ  (64 * 1024)
+struct knit_slab_chunk {
+    struct knit_slab_chunk *next;
+};
+struct knit_slab {
+    void *free_lists[KNIT_SLAB_NCLASSES];
+    char *bump;     //unused part of the most recent chunk
+    char *bump_end;
+    struct knit_slab_chunk *chunks;
 };
 
 struct knit_exec_state {
     struct knit_vars_hasht global_ht;
+    struct knit_vars_hasht intern_ht; //key: an interned string (shares its buffer), value: the interned string itself
     struct knit_stack stack;
     
     int nresults; //the number of results returned by the last executed KRET statement
     int last_cond;
+    struct knit_str *byte_strs[256]; //interned one byte strings, filled in as iterating strings needs them
     struct knit_heap heap;
+    struct knit_slab slab;
 };
 
 struct knit_tok {
@@ -226,7 +391,11 @@ struct knit {
     unsigned char is_err_msg_owned;
     int err;
     int err_policy;
-#ifdef KNIT_MEM_STATS
+
+    size_t mem_limit; //bytes, 0 means unlimited
+    size_t mem_used;  //bytes currently allocated through knitx_rmalloc() and friends
+    int mem_gc_blocked;
+#ifdef KNIT_MEM_PROFILE
     struct knit_mem_stats mstats;
 #endif
 };
@@ -248,6 +417,7 @@ enum KNIT_TOKEN {
 
     KAT_LAND, //'and' keyword
     KAT_LOR,  //'or'  keyword
+    KAT_IN,   //'in'  keyword, only used by for (x in iterable)
 
     KAT_STRLITERAL,
     KAT_INTLITERAL,
@@ -357,6 +527,8 @@ struct knit_stmt {
             struct knit_expr *cond;
             struct knit_stmt *init;
             struct knit_stmt *mutate;
+            struct knit_expr *var;      //for (var in iterable), both are NULL for the C style for
+            struct knit_expr *iterable;
         } _for;
         struct {
             struct knit_stmt_darray body;
@@ -486,7 +658,7 @@ struct knit_expr {
         KAX_LITERAL_NULL:  nothing
         KAX_FUNCTION: kfunc
         KAX_INDEX: index
-        KAX_LIST_SLICE: slice
+        KAX_LIST_SLICE: slice (beg and end are NULL when omitted)
         KAX_VAR_REF: varref
         KAX_G: nothing
         KAX_OBJ_DOT: prefix
@@ -537,6 +709,7 @@ enum KNIT_INSN {
     KCALLR,    /*inputs: (nexpected)   op: executed right after a call, to check if the no. of returned values matches the expected*/
     KINDX,     /*inputs: (none)  op: s[t - 2] = (s[t - 2])[s[t - 1]]; t -= 1*/
     KINDX_SET, /*inputs: (none)  op: s[t - 3][s[t-2]] = s[t - 1]; t -= 3*/
+    KSLICE,    /*inputs: (none)  op: s[t - 3] = (s[t - 3])[s[t - 2] : s[t - 1]]; t -= 2*/
     KDOT,      /*inputs: (none)  op: s[t - 2] = (s[t - 2]).s[t - 1]; t -= 1*/
     KRET,      /*inputs: (count,)  op: s[prev_bsp : prev_bsp + count] = s[t-count : t] t = prev_bsp + count;*/
 
@@ -574,9 +747,26 @@ enum KNIT_INSN {
     KMUL,  /*s[t-2] = s[t-2] * s[t-1]; pop 1;*/
     KDIV,  /*s[t-2] = s[t-2] / s[t-1]; pop 1;*/
     KMOD,  /*s[t-2] = s[t-2] % s[t-1]; pop 1;*/
+
+    //for (x in iterable), the loop keeps the iterable in local idx and its position (an int only the loop sees) in local idx + 1,
+    //for dicts local idx + 2 holds the size of the array part when the loop started
+    KITER_PREP,  /*inputs: (idx)  op: s[bsp + idx] = s[t-1]; s[bsp + idx + 1] = 0; s[bsp + idx + 2] = array_cap; pop 1;*/
+    KITER_NEXT,  /*inputs: (idx)  op: if ((runtime.last_condition) = has_next(s[bsp + idx])) push next(s[bsp + idx]);*/
+
+    //counting loops: for (i = a; i < n; i = i + k), see KNIT_FOR_OP1()
+    KFORPREP,    /*inputs: (op1)  op: (runtime.last_condition) = s[t-2] cmp s[t-1]; pop2 */
+    KFORLOOP,    /*inputs: (op1)  op: s[t-2] = s[t-2] +/- step; (runtime.last_condition) = s[t-2] cmp s[t-1]; pop1 */
 };
 #define KINSN_FIRST KPUSH
-#define KINSN_LAST  KMOD
+#define KINSN_LAST  KFORLOOP
+
+//op1 of KFORPREP/KFORLOOP, cmp indexes knit_for_cmp_ops, sub is 1 for i = i - step
+#define KNIT_FOR_OP1(cmp, sub, step) ((step) * 8 + (sub) * 4 + (cmp))
+#define KNIT_FOR_CMP(op1)  ((op1) & 3)
+#define KNIT_FOR_SUB(op1)  (((op1) >> 2) & 1)
+#define KNIT_FOR_STEP(op1) ((op1) >> 3)
+#define KNIT_FOR_MAX_STEP 1999 //keeps op1 in range
+static const int knit_for_cmp_ops[] = {KTESTLT, KTESTLTEQ, KTESTGT, KTESTGTEQ};
 #define KINSN_TVALID(type)  ((type) >= KINSN_FIRST && (type) <= KINSN_LAST)
 
 //Order is tied to enum
@@ -595,6 +785,7 @@ static struct knit_insninfo {
     {KCALLR, "KCALLR", 1},
     {KINDX, "KINDX", 0},
     {KINDX_SET, "KINDX_SET", 0},
+    {KSLICE, "KSLICE", 0},
     {KDOT,  "KDOT", 0},
     {KRET,  "KRET", 1},
 
@@ -625,6 +816,10 @@ static struct knit_insninfo {
     {KMUL,  "KMUL",   0},
     {KDIV,  "KDIV",   0},
     {KMOD,  "KMOD",   0},
+    {KITER_PREP, "KITER_PREP", 1},
+    {KITER_NEXT, "KITER_NEXT", 1},
+    {KFORPREP, "KFORPREP", 1},
+    {KFORLOOP, "KFORLOOP", 1},
     {0, NULL, 0},
 };
 /* the lexer state, currently this saves all tokens, which is not ideal for performance
@@ -670,10 +865,46 @@ struct knit_curblk {
     struct knit_curblk *parent; //parent must outlive child
 };
 
+//loop optimizations, see knitx_loop_optimize()
+#define KNIT_LOOP_MAX_TMPS 8
+#define KNIT_LOOP_ASSIGNED 1
+#define KNIT_LOOP_STEPPED  2 //only assigned var = var + c or var = var - c, c an int literal
+//i * k replaced by a hidden local updated when i steps
+struct knit_loop_sr {
+    int var_idx; //i, varname indexes are of curblk->locals
+    int k;
+    int tmp_idx;
+    struct knit_loop_sr *next; //the ones of the enclosing loops
+};
+struct knit_loop {
+    char *assigned; //by varname index, one of KNIT_LOOP_ASSIGNED/KNIT_LOOP_STEPPED or 0
+    int nvars;
+    int mutates; //containers may change: index stores, method calls, calls to unknown functions
+    int writes_globals; //g.x assignments, calls to unknown functions
+    struct {
+        int var_idx;
+        int k;
+        int count;
+    } muls[KNIT_LOOP_MAX_TMPS]; //var * int literal products in the loop
+    int nmuls;
+    struct {
+        int tmp_idx;
+        struct knit_expr *expr;
+    } hoisted[KNIT_LOOP_MAX_TMPS];
+    int nhoisted;
+    struct knit_loop_sr sr[KNIT_LOOP_MAX_TMPS];
+    int nsr;
+};
+
 //the parser state
 struct knit_prs {
     struct knit_lex lex; //fwd
     struct knit_curblk *curblk;
+    struct knit_loop_sr *loop_sr; //the strength reductions of the loops being emitted
+    //the block and varname index of the variable the last statement emitted assigned an int literal to,
+    //int_var_blk is NULL if it was another statement
+    struct knit_curblk *int_var_blk;
+    int int_var;
 };
 
 
@@ -684,7 +915,55 @@ struct knit_builtins {
     } kstr; //str methods
     struct {
         struct knit_cfunc append;
+        struct knit_cfunc sort;
     } klist; //list methods
+    struct {
+        struct knit_cfunc append;
+        struct knit_cfunc build;
+    } kstrbuilder; //string builder methods
+    struct {
+        struct knit_cfunc set_range;
+        struct knit_cfunc clear_range;
+        struct knit_cfunc count;
+        struct knit_cfunc next_set;
+        struct knit_cfunc next_unset;
+        struct knit_cfunc bit_and;
+        struct knit_cfunc bit_or;
+        struct knit_cfunc bit_xor;
+        struct knit_cfunc bit_andn;
+    } kbitset; //bitset methods
+    struct {
+        struct knit_cfunc sum;
+        struct knit_cfunc min;
+        struct knit_cfunc max;
+        struct knit_cfunc dot;
+        struct knit_cfunc scale;
+        struct knit_cfunc add;
+        struct knit_cfunc mask_lt;
+        struct knit_cfunc mask_gt;
+        struct knit_cfunc mask_eq;
+    } karray; //typed array methods
+    struct {
+        struct knit_cfunc push_back;
+        struct knit_cfunc push_front;
+        struct knit_cfunc pop_back;
+        struct knit_cfunc pop_front;
+        struct knit_cfunc back;
+        struct knit_cfunc front;
+    } kdeque; //deque methods
+    struct {
+        struct knit_cfunc push;
+        struct knit_cfunc pop;
+        struct knit_cfunc peek;
+    } kpqueue; //heap methods
+    struct {
+        struct knit_cfunc add;
+        struct knit_cfunc remove;
+        struct knit_cfunc contains;
+        struct knit_cfunc union_;
+        struct knit_cfunc intersection;
+        struct knit_cfunc difference;
+    } kset; //set methods
 
     struct {
         struct knit_cfunc print;
@@ -694,6 +973,15 @@ struct knit_builtins {
         struct knit_cfunc input;
         struct knit_cfunc gcwalk;
         struct knit_cfunc meminfo;
+        struct knit_cfunc string_builder;
+        struct knit_cfunc freeze;
+        struct knit_cfunc sorted;
+        struct knit_cfunc range;
+        struct knit_cfunc bitset;
+        struct knit_cfunc array;
+        struct knit_cfunc deque;
+        struct knit_cfunc heap;
+        struct knit_cfunc set;
     } funcs; //global functions
 };
 
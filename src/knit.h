@@ -4,15 +4,22 @@
 #include <stdlib.h>
 #include <string.h>
 #include <stdint.h> //need uintptr_t
+#include <limits.h>
 #include <stdarg.h>
 #include <stdio.h>
 //there are other includes in the file. 
 
 #include "kdata.h" //data structures
 #include "knit_util.h" 
+#include "knit_dict.h" 
 #include "knit_gc.h" 
 #include "knit_bitset.h" 
 #include "knit_mem_stats.h"
+#include "knit_sort.h"
+#include "knit_array.h"
+#include "knit_queue.h"
+#include "knit_set.h"
+#include "knit_opt.h"
 
 /*
   ARC macros, currently not used in a meaningful way,
@@ -30,6 +37,7 @@ struct knit_prs;
 static const char *knitx_obj_type_name(struct knit *knit, struct knit_obj *obj);
 static inline int knitx_op_do_test_binop(struct knit *knit, struct knit_obj *a, struct knit_obj *b, int op);
 static int kexpr_expr(struct knit *knit, struct knit_prs *prs, int min_prec);
+static int kexpr_fold_unop(struct knit *knit, struct knit_prs *prs);
 static int knit_error(struct knit *knit, int err_type, const char *fmt, ...);
 static int knitx_emit_expr_eval(struct knit *knit, struct knit_prs *prs, struct knit_expr *expr, int eval_ctx, int nexpected); //fwd
 static int knitx_emit_ret(struct knit *knit, struct knit_prs *prs, int count);
@@ -37,6 +45,7 @@ static int knitx_expr(struct knit *knit, struct knit_prs *prs);
 static int knitx_expr_destroy(struct knit *knit, struct knit_prs *prs, struct knit_expr *prs_expr);
 static int knitx_int_new(struct knit *knit, struct knit_int **integerp_out, int value);
 static int knitx_int_new_gcobj(struct knit *knit, struct knit_int **integerp_out, int value);
+static int knitx_int_init(struct knit *knit, struct knit_int *integer, int value);
 static int knitx_lexer_deinit(struct knit *knit, struct knit_lex *lxr);
 static int knitx_lexer_init_str(struct knit *knit, struct knit_lex *lxr, const char *program);
 static int knitx_lexer_peek_cur(struct knit *knit, struct knit_lex *lxr, struct knit_tok **tokp);
@@ -45,6 +54,7 @@ static int knitx_obj_dump(struct knit *knit, struct knit_obj *obj);
 static int knitx_obj_rep(struct knit *knit, struct knit_obj *obj, struct knit_str *outi_str, int human);
 static int knitx_prs_if_stmt_new(struct knit *knit, struct knit_prs *prs, struct knit_stmt **if_stmt_out);
 static int knitx_stmt_array_emit(struct knit *knit, struct knit_prs *prs, struct knit_stmt_darray *array);
+static int knitx_stmt_emit(struct knit *knit, struct knit_prs *prs, struct knit_stmt *stmt);
 static int knitx_stmt_prs_emit(struct knit *knit, struct knit_prs *prs, int allowed_stmts);
 static int knitx_stmt_prs_new(struct knit *knit, struct knit_prs *prs, int allowed_stmts, struct knit_stmt **stmt_out); //fwd
 static int knitx_str_new_copy(struct knit *knit, struct knit_str **strp, struct knit_str *src);
@@ -52,56 +62,39 @@ static int knitx_str_new_copy_gcobj(struct knit *knit, struct knit_str **strp, s
 static int knitx_str_strcpy(struct knit *knit, struct knit_str *str, const char *src0);
 static int knitx_tok_extract_to_str(struct knit *knit, struct knit_lex *lxr, struct knit_tok *tok, struct knit_str *str);
 static int knitx_str_strlcpy(struct knit *knit, struct knit_str *str, const char *src, int srclen);
+static int knitx_str_streq(struct knit *knit, struct knit_str *str_a, struct knit_str *str_b);
+static int knitx_str_flatten(struct knit *knit, struct knit_str *str);
+static int knitx_str_intern(struct knit *knit, struct knit_str *src, struct knit_str **strp_out);
+static int knitx_str_intern_strl(struct knit *knit, const char *src, int len, struct knit_str **strp_out);
 
 /*
     hashtable functions
 */
+    //the hash is cached in the string until it is mutated
+    static unsigned int knitx_str_hash(struct knit_str *str) {
+        knit_assert_h(!(str->flags & KNIT_STR_ROPE), "ropes must be flattened before hashing");
+        if (!(str->flags & KNIT_STR_HASHED)) {
+            /*defined in hasht third_party/ */
+            str->hash = SuperFastHash(str->str, str->len);
+            str->flags |= KNIT_STR_HASHED;
+        }
+        return str->hash;
+    }
     static int knit_vars_hasht_key_eq_cmp(knit_vars_hasht_key_type *key_1, knit_vars_hasht_key_type *key_2) {
         struct knit_str *str1 = key_1;
         struct knit_str *str2 = key_2;
+        if (str1->flags & str2->flags & KNIT_STR_INTERNED)
+            return str1->str != str2->str; //0 if eq
         if (str1->len != str2->len)
             return 1;
+        if ((str1->flags & str2->flags & KNIT_STR_HASHED) && str1->hash != str2->hash)
+            return 1;
         return memcmp(str1->str, str2->str, str1->len); //0 if eq
     }
     static size_t knit_vars_hasht_hash(knit_vars_hasht_key_type *key) {
-        struct knit_str *str = key;
-        return SuperFastHash(str->str, str->len);
+        return knitx_str_hash(key);
     }
 
-    //boolean, 1 means eq, 0 uneq
-    static int knitx_obj_eq(struct knit *knit, struct knit_obj *obj_a, struct knit_obj *obj_b) {
-        int rv = knitx_op_do_test_binop(knit, obj_a, obj_b, KTESTEQ);
-        if (rv == KNIT_OK && knit->ex.last_cond) {
-            return 1;
-        }
-        return 0;
-    }
-    static size_t knitx_obj_hash(struct knit *knit, struct knit_obj *obj) {
-        switch (obj->u.ktype) {
-            case KNIT_INT:
-                return obj->u.integer.value;
-            case KNIT_STR:
-                /*defined in hasht third_party/ */
-                return SuperFastHash(obj->u.str.str, obj->u.str.len);
-            default:
-                return knit_error(knit, KNIT_RUNTIME_ERR, "hashing %s types is not implemented", knitx_obj_type_name(knit, obj));
-        }
-        kunreachable();
-        return 0;
-    }
-    
-    static int kobj_hasht_key_eq_cmp(void *udata, kobj_hasht_key_type *key_1, kobj_hasht_key_type *key_2) {
-        struct knit *knit = (struct knit *) udata;
-        knit_assert_h(!!knit, "NULL was passed to kobj_hasht_key_eq_cmp");
-        //we are comparing two knit_obj * pointers
-        if (*key_1 == *key_2)
-            return 0;  //eq
-        return knitx_obj_eq(knit, *key_1, *key_2) ? 0 : 1; //0 if eq
-    }
-    static size_t kobj_hasht_hash(void *udata, kobj_hasht_key_type *key) {
-        struct knit *knit = (struct knit *) udata;
-        return knitx_obj_hash(knit, *key);
-    }
 /*end of hashtable functions*/
 
 
@@ -191,6 +184,28 @@ static int knitx_obj_copy(struct knit *knit, struct knit_obj **dest, struct knit
     return KNIT_RUNTIME_ERR;
 }
 
+//ints are never mutated once created, strings are immutable when they are interned or frozen
+static int knitx_obj_is_immutable(struct knit_obj *obj) {
+    if (obj->u.ktype == KNIT_INT)
+        return 1;
+    if (obj->u.ktype == KNIT_STR)
+        return !!(obj->u.str.flags & (KNIT_STR_INTERNED | KNIT_STR_FROZEN));
+    return 0;
+}
+
+//makes obj immutable in place, so it can be shared instead of copied (e.g. as a dict key)
+static int knitx_obj_freeze(struct knit *knit, struct knit_obj *obj) {
+    switch (obj->u.ktype) {
+        case KNIT_INT:
+            return KNIT_OK;
+        case KNIT_STR:
+            obj->u.str.flags |= KNIT_STR_FROZEN;
+            return KNIT_OK;
+        default:
+            return knit_error(knit, KNIT_RUNTIME_ERR, "freezing %s types is not implemented", knitx_obj_type_name(knit, obj));
+    }
+}
+
 // Assumes the length of both was checked and it was equal!
 static int knit_strl_eq(const char *a, const char *b, size_t len) {
     return memcmp(a, b, len) == 0;
@@ -211,13 +226,32 @@ static int knitx_rstrdup(struct knit *knit, const char *s, char **out_s) {
     return KNIT_OK;
 }
 
+//bytes of storage for cap elements in the given mode
+static size_t knitx_list_storage_size(int mode, int cap) {
+    switch (mode) {
+        case KNIT_LIST_INTS:  return sizeof(int) * (size_t) cap;
+        case KNIT_LIST_BOOLS: return ((size_t) cap + 7) / 8;
+        default:              return sizeof(struct knit_obj *) * (size_t) cap;
+    }
+}
+
+//the storage mode a list made only of elements like obj would use
+static int knitx_list_mode_for(struct knit_obj *obj) {
+    switch (obj->u.ktype) {
+        case KNIT_INT:   return KNIT_LIST_INTS;
+        case KNIT_TRUE:
+        case KNIT_FALSE: return KNIT_LIST_BOOLS;
+        default:         return KNIT_LIST_BOXED;
+    }
+}
+
 static int knitx_list_init(struct knit *knit, struct knit_list *list, int isz) {
     int rv = KNIT_OK;
     if (isz < 0)
         isz = 0;
     void *p = NULL;
     if (isz > 0) {
-        rv = knitx_tmalloc(knit, sizeof(struct knit_obj *) * isz, &p); 
+        rv = knitx_slab_alloc(knit, sizeof(struct knit_obj *) * isz, &p); 
         if (rv != KNIT_OK)
             return rv;
     }
@@ -225,13 +259,15 @@ static int knitx_list_init(struct knit *knit, struct knit_list *list, int isz) {
     list->items = p;
     list->len = 0;
     list->cap = isz;
+    list->mode = KNIT_LIST_BOXED;
+    list->view_base = NULL;
     return KNIT_OK;
 }
 
 static int knitx_list_deinit(struct knit *knit, struct knit_list *list) {
     int rv = KNIT_OK;
-    if (list->items) {
-        rv = knitx_tfree(knit, list->items);
+    if (list->items && !list->view_base) {
+        rv = knitx_slab_free(knit, list->items, knitx_list_storage_size(list->mode, list->cap));
     }
     return rv;
 }
@@ -256,14 +292,14 @@ static int knitx_list_new_gcobj(struct knit *knit, struct knit_list **list, int
 static int knitx_list_destroy(struct knit *knit, struct knit_list *list) {
     //TODO: for obj in items destroy/deref obj
     knitx_list_deinit(knit, list);
-    knitx_tfree(knit, list);
+    knitx_tfree(knit, list, sizeof *list);
     return KNIT_OK;
 }
 
 static int knitx_list_resize(struct knit *knit, struct knit_list *list, int new_sz) {
-    knit_assert_h(list->cap >= list->len, "");
+    knit_assert_h(list->cap >= list->len && !list->view_base, "");
     void *p = NULL;
-    int rv = knitx_trealloc(knit, list->items, sizeof(struct knit_obj *) * new_sz, &p);
+    int rv = knitx_slab_realloc(knit, list->items, knitx_list_storage_size(list->mode, list->cap), knitx_list_storage_size(list->mode, new_sz), &p);
     if (rv != KNIT_OK) {
         return rv;
     }
@@ -272,14 +308,152 @@ static int knitx_list_resize(struct knit *knit, struct knit_list *list, int new_
     return KNIT_OK;
 }
 
-static int knitx_list_push(struct knit *knit, struct knit_list *list, struct knit_obj *obj) {
+//element i without allocating: unboxed ints are written to tmp which is returned
+static struct knit_obj *knitx_list_peek(struct knit *knit, struct knit_list *list, int i, struct knit_int *tmp) {
+    knit_assert_h(i >= 0 && i < list->len, "");
+    switch (list->mode) {
+        case KNIT_LIST_INTS:
+            knitx_int_init(knit, tmp, list->ints[i]);
+            return ktobj(tmp);
+        case KNIT_LIST_BOOLS:
+            return (struct knit_obj *) ((list->bits[i / 8] >> (i % 8)) & 1 ? &ktrue : &kfalse);
+        default:
+            return list->items[i];
+    }
+}
+
+//element i, unboxed ints are boxed into a new gc object
+static int knitx_list_get(struct knit *knit, struct knit_list *list, int i, struct knit_obj **obj_out) {
+    if (list->mode != KNIT_LIST_INTS) {
+        *obj_out = knitx_list_peek(knit, list, i, NULL);
+        return KNIT_OK;
+    }
+    struct knit_int *boxed = NULL;
+    int rv = knitx_int_new_gcobj(knit, &boxed, list->ints[i]);
+    if (rv != KNIT_OK)
+        return rv;
+    *obj_out = ktobj(boxed);
+    return KNIT_OK;
+}
+
+//stores obj at i, the list must be in the storage mode of obj or boxed
+static void knitx_list_store(struct knit_list *list, int i, struct knit_obj *obj) {
+    switch (list->mode) {
+        case KNIT_LIST_INTS:
+            list->ints[i] = obj->u.integer.value;
+            break;
+        case KNIT_LIST_BOOLS:
+            if (obj->u.ktype == KNIT_TRUE)
+                list->bits[i / 8] |= 1 << (i % 8);
+            else
+                list->bits[i / 8] &= ~(1 << (i % 8));
+            break;
+        default:
+            list->items[i] = obj;
+    }
+}
+
+//gives a view its own copy of its elements, lists call it before they are mutated. pops don't write so they don't need it
+static int knitx_list_unshare(struct knit *knit, struct knit_list *list) {
+    if (!list->view_base)
+        return KNIT_OK;
+    void *p = NULL;
+    if (list->len > 0) {
+        int rv = knitx_slab_alloc(knit, knitx_list_storage_size(list->mode, list->len), &p);
+        if (rv != KNIT_OK)
+            return rv;
+        memcpy(p, list->items, knitx_list_storage_size(list->mode, list->len));
+    }
+    list->items = p;
+    list->cap = list->len;
+    list->view_base = NULL;
+    return KNIT_OK;
+}
+
+//moves the buffer of list to a new hidden list, list then views that buffer like the slices taken from it do
+static int knitx_list_share(struct knit *knit, struct knit_list *list) {
+    if (list->view_base)
+        return KNIT_OK;
+    struct knit_list *owner = (struct knit_list *) knit_gc_new_object(knit);
+    if (!owner)
+        return KNIT_GC_NOMEM;
+    *owner = *list;
+    list->view_base = owner;
+    list->cap = list->len;
+    return KNIT_OK;
+}
+
+//switches a specialized list to boxed storage, boxing every int element. the list is unchanged if that fails
+static int knitx_list_despecialize(struct knit *knit, struct knit_list *list) {
+    knit_assert_h(!list->view_base, "");
+    if (list->mode == KNIT_LIST_BOXED)
+        return KNIT_OK;
+    //every int needs its own object and the heap doesn't grow, so check that they fit before boxing any
+    struct knit_heap *heap = &knit->ex.heap;
+    if (list->mode == KNIT_LIST_INTS && heap->capacity - heap->count < list->len) {
+        knitx_mem_collect(knit);
+        if (heap->capacity - heap->count < list->len)
+            return knit_error(knit, KNIT_GC_NOMEM, "cannot box the %d ints of a list, the gc heap only has room for %d more objects",
+                              list->len, heap->capacity - heap->count);
+    }
+    void *p = NULL;
     int rv = KNIT_OK;
+    if (list->cap > 0) {
+        rv = knitx_slab_alloc(knit, knitx_list_storage_size(KNIT_LIST_BOXED, list->cap), &p);
+        if (rv != KNIT_OK)
+            return rv;
+    }
+    struct knit_obj **items = p;
+    for (int i=0; i<list->len; i++) {
+        rv = knitx_list_get(knit, list, i, &items[i]);
+        if (rv != KNIT_OK) {
+            knitx_slab_free(knit, p, knitx_list_storage_size(KNIT_LIST_BOXED, list->cap));
+            return rv;
+        }
+    }
+    knitx_slab_free(knit, list->items, knitx_list_storage_size(list->mode, list->cap));
+    list->items = items;
+    list->mode = KNIT_LIST_BOXED;
+    return KNIT_OK;
+}
+
+static int knitx_list_set(struct knit *knit, struct knit_list *list, int i, struct knit_obj *obj) {
+    knit_assert_h(i >= 0 && i < list->len, "");
+    int rv = knitx_list_unshare(knit, list);
+    if (rv != KNIT_OK)
+        return rv;
+    if (list->mode != KNIT_LIST_BOXED && knitx_list_mode_for(obj) != list->mode) {
+        rv = knitx_list_despecialize(knit, list);
+        if (rv != KNIT_OK)
+            return rv;
+    }
+    knitx_list_store(list, i, obj);
+    return KNIT_OK;
+}
+
+static int knitx_list_push(struct knit *knit, struct knit_list *list, struct knit_obj *obj) {
+    int rv = knitx_list_unshare(knit, list);
+    if (rv != KNIT_OK)
+        return rv;
+    int mode = knitx_list_mode_for(obj);
+    if (list->len == 0 && list->mode != mode) {
+        //an empty list takes the storage of its first element
+        knitx_list_deinit(knit, list);
+        list->items = NULL;
+        list->cap = 0;
+        list->mode = mode;
+    }
+    else if (list->mode != KNIT_LIST_BOXED && list->mode != mode) {
+        rv = knitx_list_despecialize(knit, list);
+        if (rv != KNIT_OK)
+            return rv;
+    }
     if (list->len >= list->cap) {
         rv = knitx_list_resize(knit, list, list->cap == 0 ? 8 : list->cap * 2); 
         if (rv != KNIT_OK)
             return rv;
     }
-    list->items[list->len++] = obj;
+    knitx_list_store(list, list->len++, obj);
     return KNIT_OK;
 }
 
@@ -291,22 +465,174 @@ static int knitx_list_pop(struct knit *knit, struct knit_list *list) {
     return KNIT_OK;
 }
 
-static int knitx_dict_init(struct knit *knit, struct knit_dict *dict, int isz) {
-    int rv = KNIT_OK;
-    if (isz < 0)
-        isz = 0;
-    rv = kobj_hasht_init_with_udata(&dict->ht, isz, knit);
+//shallow copy of the elements [begin, end) of src that keeps its storage mode
+static int knitx_list_new_range_copy_gcobj(struct knit *knit, struct knit_list **list_out, struct knit_list *src, int begin, int end) {
+    struct knit_list *list = NULL;
+    int rv = knitx_list_new_gcobj(knit, &list, 0);
+    if (rv != KNIT_OK)
+        return rv;
+    if (end > begin) {
+        list->mode = src->mode;
+        rv = knitx_list_resize(knit, list, end - begin);
+        if (rv != KNIT_OK)
+            return rv;
+        if (src->mode == KNIT_LIST_BOOLS) {
+            //bits don't start on a byte boundary
+            for (int i=begin; i<end; i++)
+                knitx_list_store(list, i - begin, knitx_list_peek(knit, src, i, NULL));
+        }
+        else {
+            memcpy(list->items, (char *) src->items + knitx_list_storage_size(src->mode, begin), knitx_list_storage_size(src->mode, end - begin));
+        }
+        list->len = end - begin;
+    }
+    *list_out = list;
+    return KNIT_OK;
+}
+
+//shallow copy of src that keeps its storage mode
+static int knitx_list_new_copy_gcobj(struct knit *knit, struct knit_list **list_out, struct knit_list *src) {
+    return knitx_list_new_range_copy_gcobj(knit, list_out, src, 0, src->len);
+}
+
+//the elements [begin, end) of src without copying them, see knitx_list_share(). bool lists can't be viewed
+//at bit offsets, their slices are copies
+static int knitx_list_new_view_gcobj(struct knit *knit, struct knit_list **list_out, struct knit_list *src, int begin, int end) {
+    knit_assert_h(src->mode != KNIT_LIST_BOOLS && begin <= end && begin >= 0 && end <= src->len, "invalid arguments to knitx_list_new_view_gcobj()");
+    int rv = knitx_list_share(knit, src);
+    if (rv != KNIT_OK)
+        return rv;
+    struct knit_list *view = NULL;
+    rv = knitx_list_new_gcobj(knit, &view, 0);
+    if (rv != KNIT_OK)
+        return rv;
+    view->mode = src->mode;
+    view->items = (struct knit_obj **) ((char *) src->items + knitx_list_storage_size(src->mode, begin));
+    view->len = view->cap = end - begin;
+    view->view_base = src->view_base;
+    *list_out = view;
+    return KNIT_OK;
+}
 
-    if (rv != KOBJ_HASHT_OK) {
-        return knit_error(knit, KNIT_RUNTIME_ERR, "couldn't initialize dict hashtable");
+//reorders the elements of list so that element i is the element perm[i] was
+static int knitx_list_permute(struct knit *knit, struct knit_list *list, const int *perm) {
+    size_t sz = knitx_list_storage_size(list->mode, list->cap);
+    void *p = NULL;
+    int rv = knitx_slab_alloc(knit, sz, &p);
+    if (rv != KNIT_OK)
+        return rv;
+    struct knit_list sorted = *list;
+    sorted.items = p;
+    if (sorted.mode == KNIT_LIST_BOOLS)
+        memset(sorted.bits, 0, sz);
+    struct knit_int tmp;
+    for (int i=0; i<list->len; i++)
+        knitx_list_store(&sorted, i, knitx_list_peek(knit, list, perm[i], &tmp));
+    knitx_slab_free(knit, list->items, sz);
+    list->items = sorted.items;
+    return KNIT_OK;
+}
+
+//stable sort of list by the elements of keys (list itself if keys is NULL), keys must be all ints or all strings
+static int knitx_list_sort(struct knit *knit, struct knit_list *list, struct knit_list *keys) {
+    if (!keys)
+        keys = list;
+    knit_assert_h(keys->len == list->len, "");
+    int n = list->len;
+    if (n < 2)
+        return KNIT_OK;
+    int rv = knitx_list_unshare(knit, list);
+    if (rv != KNIT_OK)
+        return rv;
+    int nints = 0;
+    int nstrs = 0;
+    struct knit_int tmp_int;
+    for (int i=0; i<n && keys->mode != KNIT_LIST_INTS; i++) {
+        struct knit_obj *key = knitx_list_peek(knit, keys, i, &tmp_int);
+        if (key->u.ktype == KNIT_INT)
+            nints++;
+        else if (key->u.ktype == KNIT_STR)
+            nstrs++;
+        else
+            return knit_error(knit, KNIT_INVALID_TYPE_ERR, "sorting %s types is not implemented", knitx_obj_type_name(knit, key));
+    }
+    if (keys->mode == KNIT_LIST_INTS)
+        nints = n;
+    if (nints != n && nstrs != n)
+        return knit_error(knit, KNIT_INVALID_TYPE_ERR, "can't sort a mix of ints and strings");
+
+    void *p = NULL;
+    if (nints == n) {
+        size_t sz = sizeof(uint64_t) * 2 * (size_t) n;
+        rv = knitx_rmalloc(knit, sz, &p);
+        if (rv != KNIT_OK)
+            return rv;
+        uint64_t *a = p;
+        for (int i=0; i<n; i++) {
+            int v = keys->mode == KNIT_LIST_INTS ? keys->ints[i] : keys->items[i]->u.integer.value;
+            a[i] = (uint64_t) knit_sort_int_bias(v) << 32 | (uint32_t) i;
+        }
+        knit_sort_radix(a, a + n, n);
+        if (keys == list && list->mode == KNIT_LIST_INTS) {
+            //the common case, the values are written back without a permutation
+            for (int i=0; i<n; i++)
+                list->ints[i] = knit_sort_int_unbias(a[i] >> 32);
+        }
+        else {
+            //the permutation is built in place over the lower half of the radix buffer
+            int *perm = p;
+            for (int i=0; i<n; i++)
+                perm[i] = (int) (uint32_t) a[i];
+            rv = knitx_list_permute(knit, list, perm);
+        }
+        knitx_rfree(knit, p, sz);
+        return rv;
     }
+    size_t sz = (sizeof(struct knit_str *) + 2 * sizeof(int)) * (size_t) n;
+    rv = knitx_rmalloc(knit, sz, &p);
+    if (rv != KNIT_OK)
+        return rv;
+    struct knit_str **strs = p;
+    int *perm = (int *) (strs + n);
+    int *tmp = perm + n;
+    for (int i=0; i<n && rv == KNIT_OK; i++) {
+        strs[i] = &keys->items[i]->u.str;
+        perm[i] = i;
+        rv = knitx_str_flatten(knit, strs[i]);
+    }
+    if (rv == KNIT_OK) {
+        knit_sort_strs(strs, perm, tmp, n);
+        rv = knitx_list_permute(knit, list, perm);
+    }
+    knitx_rfree(knit, p, sz);
+    return rv;
+}
+
+static int knitx_dict_init(struct knit *knit, struct knit_dict *dict, int isz) {
     dict->ktype = KNIT_DICT;
-    dict->ht.userdata = knit;
+    dict->len = 0;
+    dict->cap = 0;
+    dict->index = NULL;
+    dict->ctrl = NULL;
+    dict->entries = NULL;
+    dict->entries_cap = 0;
+    dict->array = NULL;
+    dict->array_cap = 0;
+    if (isz > 0)
+        return knit_dict_resize(knit, dict, knit_dict_cap_for(isz), 0);
     return KNIT_OK;
 }
 
 static int knitx_dict_deinit(struct knit *knit, struct knit_dict *dict) {
-    kobj_hasht_deinit(&dict->ht);
+    if (dict->cap)
+        knitx_rfree(knit, dict->index, knit_dict_alloc_size(dict->cap));
+    knitx_slab_free(knit, dict->entries, knit_dict_entries_size(dict->entries_cap));
+    knitx_rfree(knit, dict->array, dict->array_cap * sizeof(struct knit_obj *));
+    dict->index = NULL;
+    dict->ctrl = NULL;
+    dict->entries = NULL;
+    dict->array = NULL;
+    dict->cap = dict->len = dict->entries_cap = dict->array_cap = 0;
     return KNIT_OK;
 }
 
@@ -329,42 +655,77 @@ static int knitx_dict_new_gcobj(struct knit *knit, struct knit_dict **dict, int
 static int knitx_dict_destroy(struct knit *knit, struct knit_dict *dict) {
     //TODO: for obj in items destroy/deref obj
     knitx_dict_deinit(knit, dict);
-    knitx_tfree(knit, dict);
+    knitx_tfree(knit, dict, sizeof *dict);
     return KNIT_OK;
 }
 
 static int knitx_dict_lookup(struct knit *knit, struct knit_dict *dict, struct knit_obj *key, struct knit_obj **value_out) {
-    struct kobj_hasht_iter iter;
-    int rv = kobj_hasht_find(&dict->ht, &key, &iter);
+    uint64_t hash = 0;
 #ifdef KNIT_CHECKS
     *value_out = NULL;
 #endif
-    if (rv != KOBJ_HASHT_OK) {
-        if (rv == KOBJ_HASHT_NOT_FOUND)
-            return KNIT_NOT_FOUND;
-        else 
-            return knit_error(knit, KNIT_RUNTIME_ERR, "an error occured while trying to lookup a dict key in kobj_hasht_find()");
+    if (knit_dict_in_array(dict, key)) {
+        *value_out = dict->array[key->u.integer.value];
+        return *value_out ? KNIT_OK : KNIT_NOT_FOUND;
     }
-    *value_out = iter.pair->value;
+    int rv = knit_dict_hash(knit, key, &hash);
+    if (rv != KNIT_OK)
+        return rv;
+    int idx = knit_dict_find(knit, dict, key, hash);
+    if (idx < 0)
+        return KNIT_NOT_FOUND;
+    *value_out = dict->entries[idx].value;
     return KNIT_OK;
 }
 
+//the object stored for a new key (of a dict or a set): immutable keys are shared, others are interned or
+//copied so that mutating them doesn't corrupt the table
+static int knitx_dict_key_for_insert(struct knit *knit, struct knit_obj *key, struct knit_obj **key_out) {
+    int rv = KNIT_OK;
+    if (knitx_obj_is_immutable(key)) {
+        *key_out = key;
+    }
+    else if (key->u.ktype == KNIT_STR && key->u.str.len <= KNIT_STR_INTERN_MAXLEN) {
+        struct knit_str *interned = NULL;
+        rv = knitx_str_intern(knit, &key->u.str, &interned);
+        *key_out = ktobj(interned);
+    }
+    else {
+        rv = knitx_obj_copy(knit, key_out, key); 
+    }
+    return rv;
+}
+
 static int knitx_dict_set(struct knit *knit, struct knit_dict *dict, struct knit_obj *key, struct knit_obj *value) {
-    struct kobj_hasht_iter iter;
-    int rv = kobj_hasht_find(&dict->ht, &key, &iter);
-    if (rv == KOBJ_HASHT_OK) {
+    if (knit_dict_in_array(dict, key)) {
+        dict->array[key->u.integer.value] = value;
+        return KNIT_OK;
+    }
+    uint64_t hash = 0;
+    int rv = knit_dict_hash(knit, key, &hash);
+    if (rv != KNIT_OK)
+        return rv;
+    int idx = knit_dict_find(knit, dict, key, hash);
+    if (idx >= 0) {
         //todo destroy previous value 
-        iter.pair->value = value;
+        dict->entries[idx].value = value;
     }
-    else if (rv == KOBJ_HASHT_NOT_FOUND) {
+    else {
+        if (knit_dict_hash_full(dict)) {
+            rv = knit_dict_rehash(knit, dict, key);
+            if (rv != KNIT_OK)
+                return rv;
+            if (knit_dict_in_array(dict, key)) {
+                dict->array[key->u.integer.value] = value;
+                return KNIT_OK;
+            }
+        }
         struct knit_obj *new_key = NULL;
-        rv = knitx_obj_copy(knit, &new_key, key); 
+        rv = knitx_dict_key_for_insert(knit, key, &new_key);
         if (rv != KNIT_OK)
             return rv;
-        rv = kobj_hasht_insert(&dict->ht, &new_key, &value);
-    }
-    else {
-        return knit_error(knit, KNIT_RUNTIME_ERR, "knitx_dict_set(): assignment failed");
+        //the copy hashes the same as key
+        return knit_dict_insert_new(knit, dict, new_key, hash, value);
     }
     return KNIT_OK;
 }
@@ -390,19 +751,34 @@ static int knitx_int_new_gcobj(struct knit *knit, struct knit_int **integerp_out
 
 static int knitx_int_destroy(struct knit *knit, struct knit_int *integer, int value) {
     int rv = knitx_int_deinit(knit, integer);
-    int rv2 = knitx_tfree(knit, integer);
+    int rv2 = knitx_tfree(knit, integer, sizeof *integer);
     if (rv != KNIT_OK)
         return rv;
     return rv2;
 }
 
+//interned strings and strings that have views share their buffer
+static void knitx_str_assert_mutable(struct knit_str *str) {
+    knit_assert_h(!(str->flags & (KNIT_STR_INTERNED | KNIT_STR_SHARED)), "attempting to mutate an interned or shared string");
+}
+
+//frozen strings can still change representation (flatten, materialize) but not contents
+static void knitx_str_assert_unfrozen(struct knit_str *str) {
+    knit_assert_h(!(str->flags & KNIT_STR_FROZEN), "attempting to change the contents of a frozen string");
+}
+
 //see valid string states at kdata.h
 static int knitx_str_init(struct knit *knit, struct knit_str *str) {
     (void) knit;
     str->ktype = KNIT_STR;
     str->str = "";
     str->cap = -1;
-    str->len = 1;
+    str->len = 0;
+    str->flags = 0;
+    str->hash = 0;
+    str->rope_left = NULL;
+    str->rope_right = NULL;
+    str->view_base = NULL;
     return KNIT_OK;
 }
 
@@ -414,16 +790,25 @@ static int knitx_str_init_const_str(struct knit *knit, struct knit_str *str, con
     str->str = (char *) src0;
     str->len = strlen(src0);
     str->cap = -1;
+    str->flags = 0;
+    str->hash = 0;
+    str->rope_left = NULL;
+    str->rope_right = NULL;
+    str->view_base = NULL;
     return KNIT_OK;
 }
 
 static int knitx_str_deinit(struct knit *knit, struct knit_str *str) {
     if (str->cap >= 0) {
-        knitx_tfree(knit, str->str);
+        knitx_slab_free(knit, str->str, str->cap);
     }
     str->str = NULL;
     str->cap = 0;
     str->len = 0;
+    str->flags = 0;
+    str->rope_left = NULL;
+    str->rope_right = NULL;
+    str->view_base = NULL;
     return KNIT_OK;
 }
 
@@ -456,7 +841,7 @@ static int knitx_str_new_gcobj(struct knit *knit, struct knit_str **strp) {
 
 static int knitx_str_destroy(struct knit *knit, struct knit_str *strp) {
     int rv = knitx_str_deinit(knit, strp);
-    int rv2 = knitx_tfree(knit, strp);
+    int rv2 = knitx_tfree(knit, strp, sizeof(struct knit_str));
     if (rv != KNIT_OK)
         return rv;
     return rv2;
@@ -498,6 +883,9 @@ static int knitx_str_new_strcpy_gcobj(struct knit *knit, struct knit_str **strp,
 
 static int knitx_str_clear(struct knit *knit, struct knit_str *str) {
     (void) knit;
+    knitx_str_assert_mutable(str);
+    knitx_str_assert_unfrozen(str);
+    str->flags &= ~KNIT_STR_HASHED;
     if (str->cap > 0) {
         str->str[0] = 0;
         str->len = 0;
@@ -511,33 +899,47 @@ static int knitx_str_clear(struct knit *knit, struct knit_str *str) {
 }
 
 static int knitx_str_set_cap(struct knit *knit, struct knit_str *str, int capacity) {
+    knitx_str_assert_mutable(str);
+    if (str->flags & KNIT_STR_ROPE) {
+        int rv = knitx_str_flatten(knit, str);
+        if (rv != KNIT_OK)
+            return rv;
+    }
     if (capacity == 0) {
         return knitx_str_clear(knit, str);
     }
+    int alloc_cap = knit_slab_usable_size(capacity); //saves reallocations when growing small strings
     if (str->cap < 0) {
         void *p;
-        int rv  = knitx_tmalloc(knit, capacity, &p);
+        int rv  = knitx_slab_alloc(knit, alloc_cap, &p);
         if (rv != KNIT_OK) {
             return rv;
         }
+        if (str->len >= capacity)
+            str->len = capacity - 1;
         memcpy(p, str->str, str->len);
         str->str = p;
         str->str[str->len] = 0;
+        //a view now owns a copy of its contents
+        str->flags &= ~KNIT_STR_VIEW;
+        str->view_base = NULL;
     }
     else {
         void *p = NULL;
-        int rv = knitx_trealloc(knit, str->str, capacity, &p);
+        int rv = knitx_slab_realloc(knit, str->str, str->cap, alloc_cap, &p);
         if (rv != KNIT_OK) {
             return rv;
         }
         str->str = p;
     }
-    str->cap = capacity;
+    str->cap = alloc_cap;
     return KNIT_OK;
 }
 
 static int knitx_str_strlcpy(struct knit *knit, struct knit_str *str, const char *src, int srclen) {
     int rv;
+    knitx_str_assert_mutable(str);
+    knitx_str_assert_unfrozen(str);
     if (str->cap <= srclen) {
         rv = knitx_str_set_cap(knit, str, srclen + 1);
         if (rv != KNIT_OK) {
@@ -547,13 +949,20 @@ static int knitx_str_strlcpy(struct knit *knit, struct knit_str *str, const char
     memcpy(str->str, src, srclen);
     str->len = srclen;
     str->str[str->len] = 0;
+    str->flags &= ~KNIT_STR_HASHED;
     return KNIT_OK;
 }
 
+//grows geometrically, so repeated appends to the same string are amortized O(srclen)
 static int knitx_str_strlappend(struct knit *knit, struct knit_str *str, const char *src, int srclen) {
     int rv;
+    knitx_str_assert_mutable(str);
+    knitx_str_assert_unfrozen(str);
     if (str->cap <= (str->len + srclen)) {
-        rv = knitx_str_set_cap(knit, str, str->len + srclen + 1);
+        int capacity = str->len + srclen + 1;
+        if (str->cap > 0 && capacity < str->cap * 2)
+            capacity = str->cap * 2;
+        rv = knitx_str_set_cap(knit, str, capacity);
         if (rv != KNIT_OK) {
             return rv;
         }
@@ -561,6 +970,7 @@ static int knitx_str_strlappend(struct knit *knit, struct knit_str *str, const c
     memcpy(str->str + str->len, src, srclen);
     str->len += srclen;
     str->str[str->len] = 0;
+    str->flags &= ~KNIT_STR_HASHED;
     return KNIT_OK;
 }
 
@@ -573,7 +983,10 @@ static int knitx_str_strappend(struct knit *knit, struct knit_str *str, const ch
 }
 
 static int knitx_str_init_copy(struct knit *knit, struct knit_str *str, struct knit_str *src) {
-    int rv = knitx_str_init(knit, str); 
+    int rv = knitx_str_flatten(knit, src); 
+    if (rv != KNIT_OK)
+        return rv;
+    rv = knitx_str_init(knit, str); 
     if (rv != KNIT_OK)
         return rv;
     rv = knitx_str_strlcpy(knit, str, src->str, src->len);
@@ -585,7 +998,10 @@ static int knitx_str_init_copy(struct knit *knit, struct knit_str *str, struct k
 }
 
 static int knitx_str_new_copy(struct knit *knit, struct knit_str **strp, struct knit_str *src) {
-    int rv = knitx_str_new(knit, strp);
+    int rv = knitx_str_flatten(knit, src); 
+    if (rv != KNIT_OK)
+        return rv;
+    rv = knitx_str_new(knit, strp);
     if (rv != KNIT_OK) {
         return rv;
     }
@@ -598,7 +1014,10 @@ static int knitx_str_new_copy(struct knit *knit, struct knit_str **strp, struct
 }
 
 static int knitx_str_new_copy_gcobj(struct knit *knit, struct knit_str **strp, struct knit_str *src) {
-    int rv = knitx_str_new_gcobj(knit, strp);
+    int rv = knitx_str_flatten(knit, src); 
+    if (rv != KNIT_OK)
+        return rv;
+    rv = knitx_str_new_gcobj(knit, strp);
     if (rv != KNIT_OK) {
         return rv;
     }
@@ -606,6 +1025,11 @@ static int knitx_str_new_copy_gcobj(struct knit *knit, struct knit_str **strp, s
     if (rv != KNIT_OK) {
         knitx_str_destroy(knit, *strp);
         *strp = NULL;
+        return rv;
+    }
+    if (src->flags & KNIT_STR_HASHED) {
+        (*strp)->hash = src->hash;
+        (*strp)->flags |= KNIT_STR_HASHED;
     }
     return KNIT_OK;
 }
@@ -613,16 +1037,28 @@ static int knitx_str_new_copy_gcobj(struct knit *knit, struct knit_str **strp, s
 //exclusive end, inclusive begin
 static int knitx_str_mutsubstr(struct knit *knit, struct knit_str *str, int begin, int end) {
     knit_assert_h((begin <= end) && (begin <= str->len) && (end <= str->len), "invalid arguments to mutsubstr()");
-    void *p = NULL;
+    knitx_str_assert_mutable(str);
+    knitx_str_assert_unfrozen(str);
     int len = end - begin;
-    int rv  = knitx_tmalloc(knit, len + 1, &p); 
+    if (str->flags & KNIT_STR_VIEW) {
+        //views just narrow their window into the base buffer
+        str->str += begin;
+        str->len = len;
+        str->flags &= ~KNIT_STR_HASHED;
+        return KNIT_OK;
+    }
+    void *p = NULL;
+    int rv  = knitx_slab_alloc(knit, len + 1, &p); 
     if (rv != KNIT_OK)
         return rv;
     memcpy(p, str->str + begin, len);
-    knitx_tfree(knit, str->str);
+    if (str->cap >= 0)
+        knitx_slab_free(knit, str->str, str->cap);
+    str->cap = len + 1;
     str->str = p;
     str->len = len;
     str->str[len] = 0;
+    str->flags &= ~KNIT_STR_HASHED;
     return KNIT_OK;
 }
 
@@ -633,7 +1069,11 @@ enum knitx_str_mutstrip {
 };
 
 //stripchars are treated like a set, each assumed to be one char to be excluded repeatedly from beginning and end
-static int knitx_str_mutstrip(struct knit *knit, struct knit_str *str, const char *stripchars, enum knitx_str_mutstrip opts) {
+//computes the remaining range [begin, end) without modifying str
+static int knitx_str_strip_bounds(struct knit *knit, struct knit_str *str, const char *stripchars, enum knitx_str_mutstrip opts, int *beginp, int *endp) {
+    int rv = knitx_str_flatten(knit, str);
+    if (rv != KNIT_OK)
+        return rv;
     if (!opts)
         opts = KNITX_STRIP_LEFT + KNITX_STRIP_RIGHT;
     int begin = 0;
@@ -642,46 +1082,409 @@ static int knitx_str_mutstrip(struct knit *knit, struct knit_str *str, const cha
         for (int i=0; i < str->len && strchr(stripchars, str->str[i]); i++)
             begin++;
     }
-    if (opts & KNITX_STRIP_RIGHT) {
-        for (int i=str->len - 1; i > begin && strchr(stripchars, str->str[i]); i--)
-            end--;
+    if (opts & KNITX_STRIP_RIGHT) {
+        for (int i=str->len - 1; i > begin && strchr(stripchars, str->str[i]); i--)
+            end--;
+    }
+    *beginp = begin;
+    *endp = end;
+    return KNIT_OK;
+}
+
+static int knitx_str_mutstrip(struct knit *knit, struct knit_str *str, const char *stripchars, enum knitx_str_mutstrip opts) {
+    int begin, end;
+    int rv = knitx_str_strip_bounds(knit, str, stripchars, opts, &begin, &end);
+    if (rv != KNIT_OK)
+        return rv;
+    if (begin == 0 && end == str->len)
+        return KNIT_OK; //unchanged, a cached hash is still valid
+    return knitx_str_mutsubstr(knit, str, begin, end); //invalidates the cached hash
+}
+
+//boolean
+static int knitx_str_streqc(struct knit *knit, struct knit_str *str, const char *src0) {
+    if (knitx_str_flatten(knit, str) != KNIT_OK)
+        return 0;
+    size_t len = strlen(src0);
+    if ((size_t) str->len != len)
+        return 0;
+    knit_assert_h(!!str->str, "invalid string passed to be compared");
+    return knit_strl_eq(str->str, src0, len);
+}
+
+//boolean
+static int knitx_str_streq(struct knit *knit, struct knit_str *str_a, struct knit_str *str_b) {
+    if (str_a->flags & str_b->flags & KNIT_STR_INTERNED)
+        return str_a->str == str_b->str;
+    if (str_a->len != str_b->len)
+        return 0;
+    if ((str_a->flags & str_b->flags & KNIT_STR_HASHED) && str_a->hash != str_b->hash)
+        return 0;
+    if (knitx_str_flatten(knit, str_a) != KNIT_OK || knitx_str_flatten(knit, str_b) != KNIT_OK)
+        return 0;
+    else if (str_a->len == 0)
+        return 1;
+    return knit_strl_eq(str_a->str, str_b->str, str_a->len);
+}
+
+static int knitx_str_init_strcpy(struct knit *knit, struct knit_str *str, const char *src0) {
+    int rv = knitx_str_init(knit, str);
+    if (rv != KNIT_OK)
+        return rv;
+    rv = knitx_str_strcpy(knit, str, src0);
+    if (rv != KNIT_OK) {
+        knitx_str_deinit(knit, str);
+        return rv;
+    }
+    return KNIT_OK;
+}
+
+static int knitx_str_flatten(struct knit *knit, struct knit_str *str); //fwd
+//creates a rope whose contents are left followed by right, both must outlive it (the gc walks them)
+//a rope deeper than KNIT_STR_ROPE_MAXDEPTH is flattened right away
+static int knitx_str_new_rope_gcobj(struct knit *knit, struct knit_str **strp, struct knit_str *left, struct knit_str *right) {
+    int rv = knitx_str_new_gcobj(knit, strp);
+    if (rv != KNIT_OK)
+        return rv;
+    struct knit_str *str = *strp;
+    int left_depth = left->flags & KNIT_STR_ROPE ? left->rope_depth : 0;
+    int right_depth = right->flags & KNIT_STR_ROPE ? right->rope_depth : 0;
+    str->str = NULL;
+    str->len = left->len + right->len;
+    str->flags = KNIT_STR_ROPE;
+    str->rope_left = left;
+    str->rope_right = right;
+    str->rope_depth = 1 + (left_depth > right_depth ? left_depth : right_depth);
+    if (str->rope_depth > KNIT_STR_ROPE_MAXDEPTH)
+        return knitx_str_flatten(knit, str);
+    return KNIT_OK;
+}
+
+//turns a rope into a normal string that owns a contiguous null terminated buffer, no op for other strings
+static int knitx_str_flatten(struct knit *knit, struct knit_str *str) {
+    if (!(str->flags & KNIT_STR_ROPE))
+        return KNIT_OK;
+    void *p = NULL;
+    int rv = knitx_slab_alloc(knit, str->len + 1, &p);
+    if (rv != KNIT_OK)
+        return rv;
+    char *buf = p;
+    //ropes can be arbitrarily deep (s = s + x in a loop), so an explicit stack is used instead of recursion
+    struct knit_objp_darray pending;
+    if (knit_objp_darray_init(&pending, 16) != KNIT_OBJP_DARRAY_OK) {
+        knitx_slab_free(knit, buf, str->len + 1);
+        return knit_error(knit, KNIT_NOMEM, "knitx_str_flatten(): allocation failed");
+    }
+    struct knit_obj *node = ktobj(str);
+    knit_objp_darray_push(&pending, &node);
+    //the buffer is filled from the end, so right children are visited first
+    int pos = str->len;
+    while (pending.len > 0) {
+        struct knit_str *cur = (struct knit_str *) pending.data[--pending.len];
+        if (cur->flags & KNIT_STR_ROPE) {
+            struct knit_obj *left = ktobj(cur->rope_left);
+            struct knit_obj *right = ktobj(cur->rope_right);
+            if (knit_objp_darray_push(&pending, &left)  != KNIT_OBJP_DARRAY_OK ||
+                knit_objp_darray_push(&pending, &right) != KNIT_OBJP_DARRAY_OK)
+            {
+                knit_objp_darray_deinit(&pending);
+                knitx_slab_free(knit, buf, str->len + 1);
+                return knit_error(knit, KNIT_NOMEM, "knitx_str_flatten(): allocation failed");
+            }
+        }
+        else {
+            pos -= cur->len;
+            memcpy(buf + pos, cur->str, cur->len);
+        }
+    }
+    knit_objp_darray_deinit(&pending);
+    knit_assert_h(pos == 0, "knitx_str_flatten(): rope length mismatch");
+    buf[str->len] = 0;
+    str->str = buf;
+    str->cap = str->len + 1;
+    str->flags &= ~KNIT_STR_ROPE;
+    str->rope_left = NULL;
+    str->rope_right = NULL;
+    str->view_base = NULL;
+    return KNIT_OK;
+}
+
+//a + b, short results are copied, otherwise a rope is created
+static int knitx_str_concat_gcobj(struct knit *knit, struct knit_str **strp, struct knit_str *a, struct knit_str *b) {
+    if (a->len + b->len >= KNIT_STR_ROPE_MINLEN)
+        return knitx_str_new_rope_gcobj(knit, strp, a, b);
+    int rv = knitx_str_flatten(knit, a);
+    if (rv == KNIT_OK)
+        rv = knitx_str_flatten(knit, b);
+    if (rv == KNIT_OK)
+        rv = knitx_str_new_gcobj(knit, strp);
+    if (rv != KNIT_OK)
+        return rv;
+    rv = knitx_str_set_cap(knit, *strp, a->len + b->len + 1);
+    if (rv == KNIT_OK)
+        rv = knitx_str_strlcpy(knit, *strp, a->str, a->len);
+    if (rv == KNIT_OK)
+        rv = knitx_str_strlappend(knit, *strp, b->str, b->len);
+    return rv;
+}
+
+//makes sure ->str is a null terminated buffer, ropes and views don't have one
+static int knitx_str_materialize(struct knit *knit, struct knit_str *str) {
+    if (str->flags & KNIT_STR_ROPE)
+        return knitx_str_flatten(knit, str);
+    if (str->flags & KNIT_STR_VIEW)
+        return knitx_str_set_cap(knit, str, str->len + 1);
+    return KNIT_OK;
+}
+
+//zero-copy substring [begin, end) of src, the gc keeps the owner of the buffer alive through view_base
+//short substrings are copied since a view would pin a possibly much larger buffer for little gain
+static int knitx_str_new_view_gcobj(struct knit *knit, struct knit_str **strp, struct knit_str *src, int begin, int end) {
+    int rv = knitx_str_flatten(knit, src);
+    if (rv != KNIT_OK)
+        return rv;
+    knit_assert_h((begin <= end) && (begin >= 0) && (end <= src->len), "invalid arguments to knitx_str_new_view_gcobj()");
+    if (end - begin < KNIT_STR_VIEW_MINLEN)
+        return knitx_str_new_strlcpy_gcobj(knit, strp, src->str + begin, end - begin);
+    rv = knitx_str_new_gcobj(knit, strp);
+    if (rv != KNIT_OK)
+        return rv;
+    struct knit_str *base = (src->flags & KNIT_STR_VIEW) ? src->view_base : src;
+    struct knit_str *str = *strp;
+    str->str = src->str + begin;
+    str->len = end - begin;
+    str->cap = -1;
+    str->flags = KNIT_STR_VIEW;
+    str->view_base = base;
+    base->flags |= KNIT_STR_SHARED;
+    return KNIT_OK;
+}
+
+static int knitx_strbuilder_init(struct knit *knit, struct knit_strbuilder *sb) {
+    sb->ktype = KNIT_STRBUILDER;
+    return knitx_str_init(knit, &sb->buf);
+}
+
+static int knitx_strbuilder_deinit(struct knit *knit, struct knit_strbuilder *sb) {
+    return knitx_str_deinit(knit, &sb->buf);
+}
+
+static int knitx_strbuilder_new_gcobj(struct knit *knit, struct knit_strbuilder **sbp) {
+    void *p = knit_gc_new_object(knit);
+    if (!p) {
+        *sbp = NULL;
+        return KNIT_GC_NOMEM;
+    }
+    int rv = knitx_strbuilder_init(knit, p);
+    if (rv != KNIT_OK) {
+        knit_gc_obj_null(knit, p);
+        *sbp = NULL;
+        return rv;
+    }
+    *sbp = p;
+    return KNIT_OK;
+}
+
+static int knitx_range_new_gcobj(struct knit *knit, struct knit_range **rangep, int begin, int end, int step) {
+    knit_assert_h(step != 0, "");
+    struct knit_range *range = (struct knit_range *) knit_gc_new_object(knit);
+    if (!range) {
+        *rangep = NULL;
+        return KNIT_GC_NOMEM;
+    }
+    range->ktype = KNIT_RANGE;
+    range->begin = begin;
+    range->end = end;
+    range->step = step;
+    *rangep = range;
+    return KNIT_OK;
+}
+
+//the number of ints in the range
+static int knitx_range_len(const struct knit_range *range) {
+    long long span = range->step > 0 ? (long long) range->end - range->begin : (long long) range->begin - range->end;
+    long long step = range->step > 0 ? range->step : -(long long) range->step;
+    if (span <= 0)
+        return 0;
+    return (int) ((span + step - 1) / step);
+}
+
+//bitset(n), all the bits start cleared, the words are allocated like the other buffers of knit objects
+static int knitx_bitset_new_gcobj(struct knit *knit, struct knit_bitset_obj **bsp, int nbits) {
+    knit_assert_h(nbits >= 0, "");
+    struct knit_bitset_obj *bs = (struct knit_bitset_obj *) knit_gc_new_object(knit);
+    if (!bs) {
+        *bsp = NULL;
+        return KNIT_GC_NOMEM;
+    }
+    bs->ktype = KNIT_BITSET;
+    bs->bits.data = NULL;
+    bs->bits.bit_len = 0;
+    size_t sz = bitset_nbytes(nbits);
+    if (sz) {
+        void *p = NULL;
+        int rv = knitx_rmalloc(knit, sz, &p);
+        if (rv != KNIT_OK) {
+            knit_gc_obj_null(knit, (struct knit_obj *) bs);
+            *bsp = NULL;
+            return rv;
+        }
+        memset(p, 0, sz);
+        bs->bits.data = p;
+    }
+    bs->bits.bit_len = nbits;
+    *bsp = bs;
+    return KNIT_OK;
+}
+
+static void knitx_bitset_deinit(struct knit *knit, struct knit_bitset_obj *bs) {
+    if (bs->bits.data)
+        knitx_rfree(knit, bs->bits.data, bitset_nbytes(bs->bits.bit_len));
+    bs->bits.data = NULL;
+    bs->bits.bit_len = 0;
+}
+
+//array(type, n), the elements start at 0. when data isn't NULL the array uses it instead and doesn't own it
+static int knitx_array_new_gcobj(struct knit *knit, struct knit_array **arrp, int elem_type, int len, void *data) {
+    knit_assert_h(len >= 0, "");
+    struct knit_array *arr = (struct knit_array *) knit_gc_new_object(knit);
+    if (!arr) {
+        *arrp = NULL;
+        return KNIT_GC_NOMEM;
+    }
+    arr->ktype = KNIT_ARRAY;
+    arr->elem_type = elem_type;
+    arr->len = 0;
+    arr->owned = data == NULL;
+    arr->data = data;
+    size_t sz = (size_t) len * knit_array_types[elem_type].elem_size;
+    if (!data && sz) {
+        void *p = NULL;
+        int rv = knitx_rmalloc(knit, sz, &p);
+        if (rv != KNIT_OK) {
+            knit_gc_obj_null(knit, (struct knit_obj *) arr);
+            *arrp = NULL;
+            return rv;
+        }
+        memset(p, 0, sz);
+        arr->data = p;
+    }
+    arr->len = len;
+    *arrp = arr;
+    return KNIT_OK;
+}
+
+static int knitx_deque_new_gcobj(struct knit *knit, struct knit_deque **dqp) {
+    struct knit_deque *dq = (struct knit_deque *) knit_gc_new_object(knit);
+    if (!dq) {
+        *dqp = NULL;
+        return KNIT_GC_NOMEM;
     }
-    if (begin == 0 && end == str->len)
-        return KNIT_OK;
-    return knitx_str_mutsubstr(knit, str, begin, end);
+    knit_deque_init(dq);
+    *dqp = dq;
+    return KNIT_OK;
 }
 
-//boolean
-static int knitx_str_streqc(struct knit *knit, struct knit_str *str, const char *src0) {
-    if (!str->len && !src0[0])
-        return 1;
-    if (!str->len || !src0[0])
-        return 0;
-    knit_assert_h(!!str->str, "invalid string passed to be compared");
-    return strcmp(str->str, src0) == 0;
+//key_func is NULL when the items are their own keys
+static int knitx_pqueue_new_gcobj(struct knit *knit, struct knit_pqueue **pqp, struct knit_obj *key_func) {
+    struct knit_pqueue *pq = (struct knit_pqueue *) knit_gc_new_object(knit);
+    if (!pq) {
+        *pqp = NULL;
+        return KNIT_GC_NOMEM;
+    }
+    knit_pqueue_init(pq, key_func);
+    *pqp = pq;
+    return KNIT_OK;
 }
 
-//boolean
-static int knitx_str_streq(struct knit *knit, struct knit_str *str_a, struct knit_str *str_b) {
-    if (str_a->len != str_b->len)
-        return 0;
-    else if (str_a->len == 0)
-        return 1;
-    return knit_strl_eq(str_a->str, str_b->str, str_a->len);
+static int knitx_set_new_gcobj(struct knit *knit, struct knit_set **setp) {
+    struct knit_set *set = (struct knit_set *) knit_gc_new_object(knit);
+    if (!set) {
+        *setp = NULL;
+        return KNIT_GC_NOMEM;
+    }
+    knit_set_init(set);
+    *setp = set;
+    return KNIT_OK;
 }
 
-static int knitx_str_init_strcpy(struct knit *knit, struct knit_str *str, const char *src0) {
-    int rv = knitx_str_init(knit, str);
+static void knitx_array_deinit(struct knit *knit, struct knit_array *arr) {
+    if (arr->owned && arr->data)
+        knitx_rfree(knit, arr->data, (size_t) arr->len * knit_array_types[arr->elem_type].elem_size);
+    arr->data = NULL;
+    arr->len = 0;
+}
+
+/*
+ * string interning: returns the state owned copy of the string, there is one per content.
+ * interned strings aren't gc objects, they live until the state is deinitialized
+ */
+static int knitx_str_intern_strl(struct knit *knit, const char *src, int len, struct knit_str **strp_out) {
+    struct knit_str key;
+    int rv = knitx_str_init(knit, &key);
     if (rv != KNIT_OK)
         return rv;
-    rv = knitx_str_strcpy(knit, str, src0);
+    key.str = (char *) src;
+    key.len = len;
+    struct knit_exec_state *exs = &knit->ex;
+    struct knit_vars_hasht_iter iter;
+    rv = knit_vars_hasht_find(&exs->intern_ht, &key, &iter);
+    if (rv == KNIT_VARS_HASHT_OK) {
+        *strp_out = (struct knit_str *) iter.pair->value;
+        return KNIT_OK;
+    }
+    else if (rv != KNIT_VARS_HASHT_NOT_FOUND) {
+        *strp_out = NULL;
+        return knit_error(knit, KNIT_RUNTIME_ERR, "an error occured while trying to lookup a string in the intern table");
+    }
+    struct knit_str *str = NULL;
+    rv = knitx_str_new(knit, &str);
     if (rv != KNIT_OK) {
-        knitx_str_deinit(knit, str);
+        *strp_out = NULL;
         return rv;
     }
+    rv = knitx_str_strlcpy(knit, str, src, len);
+    if (rv != KNIT_OK) {
+        knitx_str_destroy(knit, str);
+        *strp_out = NULL;
+        return rv;
+    }
+    knitx_str_hash(str);
+    str->flags |= KNIT_STR_INTERNED;
+    struct knit_obj *objp = ktobj(str);
+    rv = knit_vars_hasht_insert(&exs->intern_ht, str, &objp);
+    if (rv != KNIT_VARS_HASHT_OK) {
+        str->flags &= ~KNIT_STR_INTERNED;
+        knitx_str_destroy(knit, str);
+        *strp_out = NULL;
+        return knit_error(knit, KNIT_RUNTIME_ERR, "inserting a string into the intern table failed");
+    }
+    *strp_out = str;
     return KNIT_OK;
 }
 
+static int knitx_str_intern(struct knit *knit, struct knit_str *src, struct knit_str **strp_out) {
+    if (src->flags & KNIT_STR_INTERNED) {
+        *strp_out = src;
+        return KNIT_OK;
+    }
+    int rv = knitx_str_flatten(knit, src);
+    if (rv != KNIT_OK)
+        return rv;
+    return knitx_str_intern_strl(knit, src->str, src->len, strp_out);
+}
+
+static void knitx_str_intern_table_deinit(struct knit *knit, struct knit_vars_hasht *intern_ht) {
+    struct knit_vars_hasht_iter iter;
+    knit_vars_hasht_begin_iterator(intern_ht, &iter);
+    for (; knit_vars_hasht_iter_check(&iter); knit_vars_hasht_iter_next(intern_ht, &iter)) {
+        struct knit_str *str = (struct knit_str *) iter.pair->value;
+        str->flags &= ~KNIT_STR_INTERNED;
+        knitx_str_destroy(knit, str);
+    }
+    knit_vars_hasht_deinit(intern_ht);
+}
+
 static int knitx_getvar_(struct knit *knit, const char *varname, struct knit_obj **objp) {
 
     struct knit_str key;
@@ -709,7 +1512,10 @@ static int knitx_vardump(struct knit *knit, const char *varname) {
     if (rv == KNIT_OK) {
         if (valpo->u.ktype == KNIT_STR) {
             struct knit_str *valp = &valpo->u.str;
-            fprintf(stderr, "'%s'", valp->str);
+            rv = knitx_str_flatten(knit, valp);
+            if (rv != KNIT_OK)
+                return rv;
+            fprintf(stderr, "'%.*s'", valp->len, valp->str);
         }
         else if (valpo->u.ktype == KNIT_LIST) {
             fprintf(stderr, "LIST");
@@ -777,6 +1583,7 @@ static int knit_vsprintf(struct knit *knit, struct knit_str *str, const char *fm
         va_end(ap);
     }
     str->len = needed;
+    str->flags &= ~KNIT_STR_HASHED;
     return KNIT_OK;
 }
 
@@ -791,7 +1598,7 @@ static int knit_sprintf(struct knit *knit, struct knit_str *str, const char *fmt
 static void knit_clear_error(struct knit *knit) {
     knit->err = 0;
     if (knit->is_err_msg_owned)
-        knitx_rfree(knit, knit->err_msg);
+        knitx_rfree(knit, knit->err_msg, strlen(knit->err_msg) + 1);
     knit->err_msg = NULL;
     knit->is_err_msg_owned = 0;
 }
@@ -810,9 +1617,7 @@ static void knit_error_act(struct knit *knit, int err_type) {
             fprintf(stderr, "an unknown error occured (no err msg)\n");
         exit(1);
     }
-    else {
-        knit_fatal("other error handling policies are not implemented");
-    }
+    //KNIT_POLICY_CONTINUE: the error code is propagated up to knitx_exec_str() which unwinds the stack
 }
 
 static int knit_error(struct knit *knit, int err_type, const char *fmt, ...) {
@@ -832,6 +1637,7 @@ static int knit_error(struct knit *knit, int err_type, const char *fmt, ...) {
     if (rv == KNIT_OK) {
         knit_assert_h(!!tmp.str, "");
         rv = knitx_rstrdup(knit, tmp.str, &knit->err_msg);
+        knit->is_err_msg_owned = rv == KNIT_OK;
     }
     knitx_str_deinit(knit, &tmp);
     knit_error_act(knit, err_type);
@@ -839,25 +1645,22 @@ static int knit_error(struct knit *knit, int err_type, const char *fmt, ...) {
 }
 
 static int knitx_set_str(struct knit *knit, const char *key, const char *value) {
-    struct knit_str key_str;
-    int rv = knitx_str_init(knit, &key_str);
+    struct knit_str *key_str = NULL;
+    int rv = knitx_str_intern_strl(knit, key, strlen(key), &key_str);
     if (rv != KNIT_OK) {
         return rv;
     }
-    rv = knitx_str_strcpy(knit, &key_str, key);
-    if (rv != KNIT_OK)
-        goto cleanup_key;
     struct knit_str *val_strp;
     rv = knitx_str_new_gcobj(knit, &val_strp);
     if (rv != KNIT_OK) 
-        goto cleanup_key;
+        return rv;
     rv = knitx_str_strcpy(knit, val_strp, value);
     if (rv != KNIT_OK) 
         goto cleanup_val;
-    //ownership of key is transferred to the vars hashtable
+    //the key is interned, the vars hashtable shares its buffer
     struct knit_obj *objp = (struct knit_obj *) val_strp; //defined operation?
     struct knit_exec_state *exs = &knit->ex;
-    rv = knit_vars_hasht_insert(&exs->global_ht, &key_str, &objp);
+    rv = knit_vars_hasht_insert(&exs->global_ht, key_str, &objp);
     if (rv != KNIT_VARS_HASHT_OK) {
         rv = knit_error(knit, KNIT_RUNTIME_ERR, "knitx_set_str(): inserting key into vars hashtable failed");
         goto cleanup_val;
@@ -866,8 +1669,6 @@ static int knitx_set_str(struct knit *knit, const char *key, const char *value)
 
 cleanup_val:
     knitx_str_destroy(knit, val_strp);
-cleanup_key:
-    knitx_str_deinit(knit, &key_str);
     return rv;
 }
 
@@ -878,7 +1679,7 @@ static int knitx_get_str(struct knit *knit, const char *varname, struct knit_str
     if (rv != KNIT_OK)
         return rv;
     *kstrp = knit_as_str(objp);
-    return KNIT_OK;
+    return knitx_str_materialize(knit, *kstrp);
 }
 
 static int knitx_type_str_get_property(struct knit *knit, struct knit_str *property_name, struct knit_obj **obj_out) {
@@ -895,10 +1696,138 @@ static int knitx_type_list_get_property(struct knit *knit, struct knit_str *prop
         *obj_out = (struct knit_obj *) &kbuiltins.klist.append;
         return KNIT_OK;
     }
+    if (property_name->len == 4 && knit_strl_eq(property_name->str, "sort", 4)) {
+        *obj_out = (struct knit_obj *) &kbuiltins.klist.sort;
+        return KNIT_OK;
+    }
     *obj_out = NULL;
     return knit_error(knit, KNIT_UNDEFINED, "knitx_type_list_get_property(): property %s is not defined", property_name->str);
 }
 
+static int knitx_type_strbuilder_get_property(struct knit *knit, struct knit_str *property_name, struct knit_obj **obj_out) {
+    if (property_name->len == 6 && knit_strl_eq(property_name->str, "append", 6)) {
+        *obj_out = (struct knit_obj *) &kbuiltins.kstrbuilder.append;
+        return KNIT_OK;
+    }
+    else if (property_name->len == 5 && knit_strl_eq(property_name->str, "build", 5)) {
+        *obj_out = (struct knit_obj *) &kbuiltins.kstrbuilder.build;
+        return KNIT_OK;
+    }
+    *obj_out = NULL;
+    return knit_error(knit, KNIT_UNDEFINED, "knitx_type_strbuilder_get_property(): property %s is not defined", property_name->str);
+}
+
+static int knitx_type_bitset_get_property(struct knit *knit, struct knit_str *property_name, struct knit_obj **obj_out) {
+    static const struct {
+        const char *name;
+        const struct knit_cfunc *method;
+    } methods[] = {
+        {"set_range",   &kbuiltins.kbitset.set_range},
+        {"clear_range", &kbuiltins.kbitset.clear_range},
+        {"count",       &kbuiltins.kbitset.count},
+        {"next_set",    &kbuiltins.kbitset.next_set},
+        {"next_unset",  &kbuiltins.kbitset.next_unset},
+        {"bit_and",     &kbuiltins.kbitset.bit_and},
+        {"bit_or",      &kbuiltins.kbitset.bit_or},
+        {"bit_xor",     &kbuiltins.kbitset.bit_xor},
+        {"bit_andn",    &kbuiltins.kbitset.bit_andn},
+    };
+    for (size_t i=0; i<sizeof methods / sizeof methods[0]; i++) {
+        if ((size_t) property_name->len == strlen(methods[i].name) && knit_strl_eq(property_name->str, methods[i].name, property_name->len)) {
+            *obj_out = (struct knit_obj *) methods[i].method;
+            return KNIT_OK;
+        }
+    }
+    *obj_out = NULL;
+    return knit_error(knit, KNIT_UNDEFINED, "knitx_type_bitset_get_property(): property %s is not defined", property_name->str);
+}
+
+static int knitx_type_array_get_property(struct knit *knit, struct knit_str *property_name, struct knit_obj **obj_out) {
+    static const struct {
+        const char *name;
+        const struct knit_cfunc *method;
+    } methods[] = {
+        {"sum",     &kbuiltins.karray.sum},
+        {"min",     &kbuiltins.karray.min},
+        {"max",     &kbuiltins.karray.max},
+        {"dot",     &kbuiltins.karray.dot},
+        {"scale",   &kbuiltins.karray.scale},
+        {"add",     &kbuiltins.karray.add},
+        {"mask_lt", &kbuiltins.karray.mask_lt},
+        {"mask_gt", &kbuiltins.karray.mask_gt},
+        {"mask_eq", &kbuiltins.karray.mask_eq},
+    };
+    for (size_t i=0; i<sizeof methods / sizeof methods[0]; i++) {
+        if ((size_t) property_name->len == strlen(methods[i].name) && knit_strl_eq(property_name->str, methods[i].name, property_name->len)) {
+            *obj_out = (struct knit_obj *) methods[i].method;
+            return KNIT_OK;
+        }
+    }
+    *obj_out = NULL;
+    return knit_error(knit, KNIT_UNDEFINED, "knitx_type_array_get_property(): property %s is not defined", property_name->str);
+}
+
+static int knitx_type_deque_get_property(struct knit *knit, struct knit_str *property_name, struct knit_obj **obj_out) {
+    static const struct {
+        const char *name;
+        const struct knit_cfunc *method;
+    } methods[] = {
+        {"push_back",  &kbuiltins.kdeque.push_back},
+        {"push_front", &kbuiltins.kdeque.push_front},
+        {"pop_back",   &kbuiltins.kdeque.pop_back},
+        {"pop_front",  &kbuiltins.kdeque.pop_front},
+        {"back",       &kbuiltins.kdeque.back},
+        {"front",      &kbuiltins.kdeque.front},
+    };
+    for (size_t i=0; i<sizeof methods / sizeof methods[0]; i++) {
+        if ((size_t) property_name->len == strlen(methods[i].name) && knit_strl_eq(property_name->str, methods[i].name, property_name->len)) {
+            *obj_out = (struct knit_obj *) methods[i].method;
+            return KNIT_OK;
+        }
+    }
+    *obj_out = NULL;
+    return knit_error(knit, KNIT_UNDEFINED, "knitx_type_deque_get_property(): property %s is not defined", property_name->str);
+}
+
+static int knitx_type_set_get_property(struct knit *knit, struct knit_str *property_name, struct knit_obj **obj_out) {
+    static const struct {
+        const char *name;
+        const struct knit_cfunc *method;
+    } methods[] = {
+        {"add",          &kbuiltins.kset.add},
+        {"remove",       &kbuiltins.kset.remove},
+        {"contains",     &kbuiltins.kset.contains},
+        {"union",        &kbuiltins.kset.union_},
+        {"intersection", &kbuiltins.kset.intersection},
+        {"difference",   &kbuiltins.kset.difference},
+    };
+    for (size_t i=0; i<sizeof methods / sizeof methods[0]; i++) {
+        if ((size_t) property_name->len == strlen(methods[i].name) && knit_strl_eq(property_name->str, methods[i].name, property_name->len)) {
+            *obj_out = (struct knit_obj *) methods[i].method;
+            return KNIT_OK;
+        }
+    }
+    *obj_out = NULL;
+    return knit_error(knit, KNIT_UNDEFINED, "knitx_type_set_get_property(): property %s is not defined", property_name->str);
+}
+
+static int knitx_type_pqueue_get_property(struct knit *knit, struct knit_str *property_name, struct knit_obj **obj_out) {
+    if (property_name->len == 4 && knit_strl_eq(property_name->str, "push", 4)) {
+        *obj_out = (struct knit_obj *) &kbuiltins.kpqueue.push;
+        return KNIT_OK;
+    }
+    else if (property_name->len == 3 && knit_strl_eq(property_name->str, "pop", 3)) {
+        *obj_out = (struct knit_obj *) &kbuiltins.kpqueue.pop;
+        return KNIT_OK;
+    }
+    else if (property_name->len == 4 && knit_strl_eq(property_name->str, "peek", 4)) {
+        *obj_out = (struct knit_obj *) &kbuiltins.kpqueue.peek;
+        return KNIT_OK;
+    }
+    *obj_out = NULL;
+    return knit_error(knit, KNIT_UNDEFINED, "knitx_type_pqueue_get_property(): property %s is not defined", property_name->str);
+}
+
 static int knitx_obj_get_property(struct knit *knit, struct knit_obj *obj, struct knit_str *name, struct knit_obj **obj_out) {
     if (obj->u.ktype == KNIT_STR) {
         return knitx_type_str_get_property(knit, name, obj_out);
@@ -906,11 +1835,92 @@ static int knitx_obj_get_property(struct knit *knit, struct knit_obj *obj, struc
     else if (obj->u.ktype == KNIT_LIST) {
         return knitx_type_list_get_property(knit, name, obj_out);
     }
+    else if (obj->u.ktype == KNIT_STRBUILDER) {
+        return knitx_type_strbuilder_get_property(knit, name, obj_out);
+    }
+    else if (obj->u.ktype == KNIT_BITSET) {
+        return knitx_type_bitset_get_property(knit, name, obj_out);
+    }
+    else if (obj->u.ktype == KNIT_ARRAY) {
+        return knitx_type_array_get_property(knit, name, obj_out);
+    }
+    else if (obj->u.ktype == KNIT_DEQUE) {
+        return knitx_type_deque_get_property(knit, name, obj_out);
+    }
+    else if (obj->u.ktype == KNIT_PQUEUE) {
+        return knitx_type_pqueue_get_property(knit, name, obj_out);
+    }
+    else if (obj->u.ktype == KNIT_SET) {
+        return knitx_type_set_get_property(knit, name, obj_out);
+    }
     else {
         return knit_error(knit, KNIT_RUNTIME_ERR, "cannot get a property out of this type of object");
     }
 }
 
+//resolves optional slice bounds (null means omitted) like python, negative bounds count from the end
+static int knitx_slice_bounds(struct knit *knit, struct knit_obj *beg, struct knit_obj *end, int len, int *begp, int *endp) {
+    int b = 0;
+    int e = len;
+    if (beg->u.ktype == KNIT_INT)
+        b = beg->u.integer.value;
+    else if (beg->u.ktype != KNIT_NULL)
+        return knit_error(knit, KNIT_INVALID_TYPE_ERR, "slice bounds must be ints");
+    if (end->u.ktype == KNIT_INT)
+        e = end->u.integer.value;
+    else if (end->u.ktype != KNIT_NULL)
+        return knit_error(knit, KNIT_INVALID_TYPE_ERR, "slice bounds must be ints");
+    if (b < 0)
+        b += len;
+    if (e < 0)
+        e += len;
+    b = b < 0 ? 0 : (b > len ? len : b);
+    e = e < 0 ? 0 : (e > len ? len : e);
+    if (e < b)
+        e = b;
+    *begp = b;
+    *endp = e;
+    return KNIT_OK;
+}
+
+static int knitx_obj_slice(struct knit *knit, struct knit_obj *obj, struct knit_obj *beg, struct knit_obj *end, struct knit_obj **obj_out) {
+    int b = 0, e = 0;
+    int rv;
+    if (obj->u.ktype == KNIT_STR) {
+        struct knit_str *str = (struct knit_str *) obj;
+        rv = knitx_slice_bounds(knit, beg, end, str->len, &b, &e);
+        if (rv != KNIT_OK)
+            return rv;
+        if (b == 0 && e == str->len) {
+            *obj_out = obj; //strings are immutable from scripts
+            return KNIT_OK;
+        }
+        struct knit_str *view = NULL;
+        rv = knitx_str_new_view_gcobj(knit, &view, str, b, e);
+        if (rv != KNIT_OK)
+            return rv;
+        view->flags |= KNIT_STR_FROZEN;
+        *obj_out = ktobj(view);
+        return KNIT_OK;
+    }
+    else if (obj->u.ktype == KNIT_LIST) {
+        struct knit_list *list = (struct knit_list *) obj;
+        rv = knitx_slice_bounds(knit, beg, end, list->len, &b, &e);
+        if (rv != KNIT_OK)
+            return rv;
+        struct knit_list *slice = NULL;
+        if (e - b < KNIT_LIST_VIEW_MINLEN || list->mode == KNIT_LIST_BOOLS)
+            rv = knitx_list_new_range_copy_gcobj(knit, &slice, list, b, e);
+        else
+            rv = knitx_list_new_view_gcobj(knit, &slice, list, b, e);
+        if (rv != KNIT_OK)
+            return rv;
+        *obj_out = ktobj(slice);
+        return KNIT_OK;
+    }
+    return knit_error(knit, KNIT_INVALID_TYPE_ERR, "trying to slice a type other than strings/lists");
+}
+
 static int knitx_lexer_init(struct knit *knit, struct knit_lex *lxr) {
     lxr->lineno = 1;
     lxr->colno = 1;
@@ -985,6 +1995,7 @@ static int knitx_block_init(struct knit *knit, struct knit_block *block) {
         goto fail_objp_darray;
     block->nargs = 0;
     block->nlocals = 0;
+    block->packed = 0;
     return KNIT_OK;
 
 fail_objp_darray:
@@ -993,6 +2004,7 @@ fail_objp_darray:
 }
 
 static int knitx_block_add_insn(struct knit *knit, struct knit_block *block, struct knit_insn *insn) {
+    knit_assert_h(!block->packed, "adding an instruction to a packed block");
     int rv = insns_darray_push(&block->insns, insn);
     if (rv != INSNS_DARRAY_OK) {
         return knit_error(knit, KNIT_RUNTIME_ERR, "knitx_block_add_insn(): adding a insn to insns darray failed");
@@ -1002,6 +2014,7 @@ static int knitx_block_add_insn(struct knit *knit, struct knit_block *block, str
 
 //block owns allocd_obj, it is expected to be a tmallocd ptr (TODO check)
 static int knitx_block_add_constant(struct knit *knit, struct knit_block *block, struct knit_obj *allocd_obj, int *index_out) {
+    knit_assert_h(!block->packed, "adding a constant to a packed block");
     int rv = knit_objp_darray_push(&block->constants, &allocd_obj);
     if (rv != KNIT_OBJP_DARRAY_OK) {
         *index_out = -1;
@@ -1035,20 +2048,53 @@ static int knit_runtime_error(struct knit *knit, const char *fmt, ...) {
     return KNIT_RUNTIME_ERR;
 }
 
-//doesn't own src
+//doesn't own src, the added constant is interned
 static int knitx_current_block_add_strl_constant(struct knit *knit, struct knit_prs *prs,  const char *src, int len, int *index_out) {
     struct knit_str *str = NULL;
-    int rv = knitx_str_new(knit, &str); 
+    int rv = knitx_str_intern_strl(knit, src, len, &str); 
     if (rv != KNIT_OK)
         return rv;
-    rv = knitx_str_strlcpy(knit, str, src, len);  
+    return knitx_block_add_constant(knit, &prs->curblk->block, ktobj(str), index_out);
+}
+
+//moves the constants and the instructions of a compiled block into a single exact-sized allocation,
+//the compilation darrays are preallocated generously, which adds up for scripts with many small functions.
+//constant pointers go first so both parts are aligned, the layout is still read through .constants and .insns
+static int knitx_block_pack(struct knit *knit, struct knit_block *block) {
+    knit_assert_h(!block->packed, "block is already packed");
+    size_t constants_sz = block->constants.len * sizeof(struct knit_obj *);
+    size_t insns_sz = block->insns.len * sizeof(struct knit_insn);
+    if (!constants_sz && !insns_sz)
+        return KNIT_OK;
+    void *p = NULL;
+    int rv = knitx_tmalloc(knit, constants_sz + insns_sz, &p); 
     if (rv != KNIT_OK)
         return rv;
-    return knitx_block_add_constant(knit, &prs->curblk->block, ktobj(str), index_out);
+    memcpy(p, block->constants.data, constants_sz);
+    memcpy((char *) p + constants_sz, block->insns.data, insns_sz);
+    int nconstants = block->constants.len;
+    int ninsns = block->insns.len;
+    knit_objp_darray_deinit(&block->constants);
+    insns_darray_deinit(&block->insns);
+    block->constants.data = p;
+    block->constants.len = block->constants.cap = nconstants;
+    block->insns.data = (struct knit_insn *) ((char *) p + constants_sz);
+    block->insns.len = block->insns.cap = ninsns;
+    block->packed = 1;
+    return KNIT_OK;
 }
 
 static int knitx_block_deinit(struct knit *knit, struct knit_block *block) {
+    if (block->packed) {
+        knitx_tfree(knit, block->constants.data, block->constants.len * sizeof(struct knit_obj *) +
+                                                  block->insns.len * sizeof(struct knit_insn));
+        block->constants.data = NULL;
+        block->insns.data = NULL;
+        block->packed = 0;
+        return KNIT_OK;
+    }
     insns_darray_deinit(&block->insns);
+    knit_objp_darray_deinit(&block->constants);
     return KNIT_OK;
 }
 
@@ -1057,6 +2103,13 @@ static const char *knitx_obj_type_name(struct knit *knit, struct knit_obj *obj)
     if (obj->u.ktype == KNIT_INT)      return "KNIT_INT";
     else if (obj->u.ktype == KNIT_STR) return "KNIT_STR";
     else if (obj->u.ktype == KNIT_LIST) return "KNIT_LIST";
+    else if (obj->u.ktype == KNIT_STRBUILDER) return "KNIT_STRBUILDER";
+    else if (obj->u.ktype == KNIT_RANGE) return "KNIT_RANGE";
+    else if (obj->u.ktype == KNIT_BITSET) return "KNIT_BITSET";
+    else if (obj->u.ktype == KNIT_ARRAY) return "KNIT_ARRAY";
+    else if (obj->u.ktype == KNIT_DEQUE) return "KNIT_DEQUE";
+    else if (obj->u.ktype == KNIT_PQUEUE) return "KNIT_PQUEUE";
+    else if (obj->u.ktype == KNIT_SET) return "KNIT_SET";
     return "ERR_UNKNOWN_TYPE";
 }
 
@@ -1073,6 +2126,9 @@ static int knitx_obj_rep(struct knit *knit, struct knit_obj *obj, struct knit_st
     }
     else if (obj->u.ktype == KNIT_STR) {
         struct knit_str *objstr = (struct knit_str *) obj;
+        rv = knitx_str_flatten(knit, objstr); 
+        if (rv != KNIT_OK)
+            return rv;
         if (!human) {
             rv = knitx_str_strlcpy(knit, outi_str, "\"", 1); 
             if (rv != KNIT_OK)
@@ -1096,6 +2152,7 @@ static int knitx_obj_rep(struct knit *knit, struct knit_obj *obj, struct knit_st
         rv = knitx_str_strlcpy(knit, outi_str, "[", 1); 
         if (rv != KNIT_OK)
             return rv;
+        struct knit_int tmp_int;
         for (int i=0; i<objlist->len; i++) {
             if (i) {
                 rv = knitx_str_strlappend(knit, outi_str, ", ", 2); 
@@ -1106,7 +2163,7 @@ static int knitx_obj_rep(struct knit *knit, struct knit_obj *obj, struct knit_st
             rv = knitx_str_new(knit, &tmpstr); 
             if (rv != KNIT_OK)
                 return rv;
-            rv = knitx_obj_rep(knit, objlist->items[i], tmpstr, 0);
+            rv = knitx_obj_rep(knit, knitx_list_peek(knit, objlist, i, &tmp_int), tmpstr, 0);
             if (rv != KNIT_OK) {
                 knitx_str_destroy(knit, tmpstr);
                 return rv;
@@ -1120,22 +2177,98 @@ static int knitx_obj_rep(struct knit *knit, struct knit_obj *obj, struct knit_st
         if (rv != KNIT_OK)
             return rv;
     }
+    else if (obj->u.ktype == KNIT_DEQUE) {
+        struct knit_deque *dq = (struct knit_deque *) obj;
+        rv = knitx_str_strcpy(knit, outi_str, "deque(["); 
+        if (rv != KNIT_OK)
+            return rv;
+        for (int i=0; i<dq->len; i++) {
+            if (i) {
+                rv = knitx_str_strlappend(knit, outi_str, ", ", 2); 
+                if (rv != KNIT_OK)
+                    return rv;
+            }
+            struct knit_str *tmpstr = NULL;
+            rv = knitx_str_new(knit, &tmpstr); 
+            if (rv != KNIT_OK)
+                return rv;
+            rv = knitx_obj_rep(knit, knit_deque_at(dq, i), tmpstr, 0);
+            if (rv != KNIT_OK) {
+                knitx_str_destroy(knit, tmpstr);
+                return rv;
+            }
+            rv = knitx_str_strlappend(knit, outi_str, tmpstr->str, tmpstr->len); 
+            knitx_str_destroy(knit, tmpstr);
+            if (rv != KNIT_OK)
+                return rv;
+        }
+        rv = knitx_str_strlappend(knit, outi_str, "])", 2); 
+        if (rv != KNIT_OK)
+            return rv;
+    }
+    else if (obj->u.ktype == KNIT_SET) {
+        struct knit_set *set = &obj->u.set;
+        rv = knitx_str_strcpy(knit, outi_str, "set(["); 
+        if (rv != KNIT_OK)
+            return rv;
+        int pos = 0, v = 0, first = 1;
+        struct knit_obj *elem = NULL;
+        struct knit_int tmp_int;
+        while (knit_set_next(set, &pos, &elem, &v)) {
+            if (!elem) {
+                knitx_int_init(knit, &tmp_int, v);
+                elem = ktobj(&tmp_int);
+            }
+            if (!first) {
+                rv = knitx_str_strlappend(knit, outi_str, ", ", 2); 
+                if (rv != KNIT_OK)
+                    return rv;
+            }
+            first = 0;
+            struct knit_str *tmpstr = NULL;
+            rv = knitx_str_new(knit, &tmpstr); 
+            if (rv != KNIT_OK)
+                return rv;
+            rv = knitx_obj_rep(knit, elem, tmpstr, 0);
+            if (rv != KNIT_OK) {
+                knitx_str_destroy(knit, tmpstr);
+                return rv;
+            }
+            rv = knitx_str_strlappend(knit, outi_str, tmpstr->str, tmpstr->len); 
+            knitx_str_destroy(knit, tmpstr);
+            if (rv != KNIT_OK)
+                return rv;
+        }
+        rv = knitx_str_strlappend(knit, outi_str, "])", 2); 
+        if (rv != KNIT_OK)
+            return rv;
+    }
     else if (obj->u.ktype == KNIT_DICT) {
         struct knit_dict *objdict = (struct knit_dict *) obj;
         rv = knitx_str_strlcpy(knit, outi_str, "{", 1); 
         if (rv != KNIT_OK)
             return rv;
-        struct kobj_hasht_iter iter;
-        kobj_hasht_begin_iterator(&objdict->ht, &iter);
-        for (int i=0; kobj_hasht_iter_check(&iter); i++, kobj_hasht_iter_next(&objdict->ht, &iter)) 
-        {
-            struct knit_obj *key = iter.pair->key;
-            struct knit_obj *value = iter.pair->value;
-            if (i) {
+        int first = 1;
+        //the array part (in key order) then the hash part (in insertion order), i counts the array part and then the entries
+        for (int i=0; i < objdict->array_cap + objdict->len; i++) {
+            struct knit_obj *value = NULL;
+            struct knit_int array_key;
+            struct knit_obj *key = ktobj(&array_key);
+            if (i < objdict->array_cap) {
+                if (!(value = objdict->array[i]))
+                    continue;
+                knitx_int_init(knit, &array_key, i);
+            }
+            else {
+                key = objdict->entries[i - objdict->array_cap].key;
+                value = objdict->entries[i - objdict->array_cap].value;
+            }
+            if (!first) {
                 rv = knitx_str_strlappend(knit, outi_str, ", ", 2); 
                 if (rv != KNIT_OK)
                     return rv;
             }
+            first = 0;
             struct knit_str *tmpstr = NULL;
             rv = knitx_str_new(knit, &tmpstr); 
             if (rv != KNIT_OK)
@@ -1165,6 +2298,49 @@ static int knitx_obj_rep(struct knit *knit, struct knit_obj *obj, struct knit_st
         if (rv != KNIT_OK)
             return rv;
     }
+    else if (obj->u.ktype == KNIT_STRBUILDER) {
+        rv = knitx_str_strcpy(knit, outi_str, "<string builder>"); 
+        if (rv != KNIT_OK)
+            return rv;
+    }
+    else if (obj->u.ktype == KNIT_RANGE) {
+        char buf[64];
+        snprintf(buf, sizeof buf, "range(%d, %d, %d)", obj->u.range.begin, obj->u.range.end, obj->u.range.step);
+        rv = knitx_str_strcpy(knit, outi_str, buf); 
+        if (rv != KNIT_OK)
+            return rv;
+    }
+    else if (obj->u.ktype == KNIT_BITSET) {
+        char buf[64];
+        snprintf(buf, sizeof buf, "<bitset of %zu bits>", obj->u.bitset.bits.bit_len);
+        rv = knitx_str_strcpy(knit, outi_str, buf); 
+        if (rv != KNIT_OK)
+            return rv;
+    }
+    else if (obj->u.ktype == KNIT_PQUEUE) {
+        char buf[64];
+        snprintf(buf, sizeof buf, "<heap of %d items>", obj->u.pqueue.len);
+        rv = knitx_str_strcpy(knit, outi_str, buf); 
+        if (rv != KNIT_OK)
+            return rv;
+    }
+    else if (obj->u.ktype == KNIT_ARRAY) {
+        struct knit_array *arr = &obj->u.array;
+        char buf[64];
+        snprintf(buf, sizeof buf, "array(%s)[", knit_array_types[arr->elem_type].name);
+        rv = knitx_str_strcpy(knit, outi_str, buf); 
+        if (rv != KNIT_OK)
+            return rv;
+        for (int i=0; i<arr->len; i++) {
+            int n = snprintf(buf, sizeof buf, "%s%lld", i ? ", " : "", (long long) knit_array_get(arr, i));
+            rv = knitx_str_strlappend(knit, outi_str, buf, n); 
+            if (rv != KNIT_OK)
+                return rv;
+        }
+        rv = knitx_str_strlappend(knit, outi_str, "]", 1); 
+        if (rv != KNIT_OK)
+            return rv;
+    }
     else if (obj->u.ktype == KNIT_CFUNC) {
         rv = knitx_str_strcpy(knit, outi_str, "<C function>"); 
         if (rv != KNIT_OK)
@@ -1353,6 +2529,20 @@ cleanup_tmpstr:
     return rv;
 }
 
+/*
+The stack darrays allocate through libc, so their capacity is charged to the memory limit by hand:
+the growth a push would cause is charged before pushing.
+*/
+static int knitx_stack_charge_growth(struct knit *knit, int len, int cap, int n, size_t elem_sz) {
+    if (len + n <= cap)
+        return KNIT_OK;
+    int new_cap = cap ? cap : 1;
+    do {
+        new_cap *= 2; //same policy as darray.h
+    } while (len + n > new_cap);
+    return knitx_mem_charge(knit, (size_t) (new_cap - cap) * elem_sz);
+}
+
 static int knitx_stack_init(struct knit *knit, struct knit_stack *stack) {
     int rv = knit_frame_darray_init(&stack->frames, 128);
     if (rv != KNIT_FRAME_DARRAY_OK) {
@@ -1363,10 +2553,12 @@ static int knitx_stack_init(struct knit *knit, struct knit_stack *stack) {
         knit_frame_darray_deinit(&stack->frames);
         return knit_error(knit, KNIT_RUNTIME_ERR, "knit_stack_init(): initializing values stack failed");
     }
+    knit->mem_used += stack->frames.cap * sizeof(struct knit_frame) + stack->vals.cap * sizeof(struct knit_obj *);
     return KNIT_OK;
 }
 
 static int knitx_stack_deinit(struct knit *knit, struct knit_stack *stack) {
+    knitx_mem_uncharge(knit, stack->frames.cap * sizeof(struct knit_frame) + stack->vals.cap * sizeof(struct knit_obj *));
     int rv1 = knit_objp_darray_deinit(&stack->vals);
     int rv  = knit_frame_darray_deinit(&stack->frames);
     if (rv1 != KNIT_OBJP_DARRAY_OK || rv != KNIT_FRAME_DARRAY_OK)
@@ -1481,9 +2673,12 @@ cleanup_tmpstr1:
 //push n nulls to the stack
 static int knitx_stack_reserve_values(struct knit *knit, struct knit_stack *stack, int nvalues) {
     knit_assert_h(nvalues >= 0, "");
+    int rv = knitx_stack_charge_growth(knit, stack->vals.len, stack->vals.cap, nvalues, sizeof(struct knit_obj *));
+    if (rv != KNIT_OK)
+        return rv;
     struct knit_obj *obj = NULL;
     for (int i=0; i<nvalues; i++) {
-        int rv = knit_objp_darray_push(&stack->vals, &obj);
+        rv = knit_objp_darray_push(&stack->vals, &obj);
         if (rv != KNIT_OBJP_DARRAY_OK) {
             return knit_error(knit, KNIT_RUNTIME_ERR, "knit_stack_value: pushing a stack value failed");
         }
@@ -1503,6 +2698,11 @@ static int knitx_stack_push_frame_for_kcall(struct knit *knit, struct knit_block
         return rv;
     }
     struct knit_exec_state *exs = &knit->ex;
+    rv = knitx_stack_charge_growth(knit, exs->stack.frames.len, exs->stack.frames.cap, 1, sizeof(struct knit_frame));
+    if (rv != KNIT_OK) {
+        knitx_frame_deinit(knit, &frm);
+        return rv;
+    }
     rv = knit_frame_darray_push(&exs->stack.frames, &frm);
     if (rv != KNIT_FRAME_DARRAY_OK) {
         knitx_frame_deinit(knit, &frm);
@@ -1520,6 +2720,11 @@ static int knitx_stack_push_frame_for_ccall(struct knit *knit, struct knit_cfunc
         return rv;
     }
     struct knit_exec_state *exs = &knit->ex;
+    rv = knitx_stack_charge_growth(knit, exs->stack.frames.len, exs->stack.frames.cap, 1, sizeof(struct knit_frame));
+    if (rv != KNIT_OK) {
+        knitx_frame_deinit(knit, &frm);
+        return rv;
+    }
     rv = knit_frame_darray_push(&exs->stack.frames, &frm);
     if (rv != KNIT_FRAME_DARRAY_OK) {
         knitx_frame_deinit(knit, &frm);
@@ -1557,19 +2762,28 @@ static int knitx_stack_pop_frame(struct knit *knit, struct knit_stack *stack) {
 }
 
 static int knitx_exec_state_init(struct knit *knit, struct knit_exec_state *exs) {
+    knit_slab_init(&exs->slab);
     int rv = knit_vars_hasht_init_with_udata(&exs->global_ht, 32, knit);
     if (rv != KNIT_VARS_HASHT_OK) {
         return knit_error(knit, KNIT_RUNTIME_ERR, "couldn't initialize vars hashtable");;
     }
+    rv = knit_vars_hasht_init_with_udata(&exs->intern_ht, 64, knit);
+    if (rv != KNIT_VARS_HASHT_OK) {
+        rv = knit_error(knit, KNIT_RUNTIME_ERR, "couldn't initialize intern hashtable");
+        goto cleanup_vars_ht;
+    }
+    memset(exs->byte_strs, 0, sizeof exs->byte_strs);
     rv = knitx_stack_init(knit, &exs->stack);
     if (rv != KNIT_OK)
-        goto cleanup_vars_ht;
+        goto cleanup_intern_ht;
     if ((rv = knit_heap_init(knit, &exs->heap, 32000)) != KNIT_OK) {
         goto cleanup_stack;
     }
     return KNIT_OK;
 cleanup_stack:
     knitx_stack_deinit(knit, &exs->stack);
+cleanup_intern_ht:
+    knit_vars_hasht_deinit(&exs->intern_ht);
 cleanup_vars_ht:
     knit_vars_hasht_deinit(&exs->global_ht);
     return rv;
@@ -1577,8 +2791,12 @@ cleanup_vars_ht:
 
 static int knitx_exec_state_deinit(struct knit *knit, struct knit_exec_state *exs) {
     knit_vars_hasht_deinit(&exs->global_ht);
+    //global keys share the buffers of interned strings, so this goes after global_ht
+    knitx_str_intern_table_deinit(knit, &exs->intern_ht);
     int rv = knitx_stack_deinit(knit, &exs->stack);
     knit_heap_deinit(knit, &exs->heap);
+    //buffers of objects that were still alive are reclaimed with their chunks
+    knit_slab_deinit(knit, &exs->slab);
     return rv;
 }
 
@@ -1757,6 +2975,9 @@ static int knitx_lexer_add_keyword_or_var(struct knit *knit, struct knit_lex *lx
     else if (len == 2 && knit_strl_eq(lxr->input->str + beg, "if", 2)) {
         type = KAT_IF;
     }
+    else if (len == 2 && knit_strl_eq(lxr->input->str + beg, "in", 2)) {
+        type = KAT_IN;
+    }
     return knitx_lexer_add_tok(knit, lxr, type, beg, len, lxr->lineno, lxr->colno, NULL);
 }
 
@@ -1914,22 +3135,22 @@ static int knitx_lexer_peek_cur(struct knit *knit, struct knit_lex *lxr, struct
     return KNIT_OK;
 }
 
+//the token after the current one, or KAT_EOF
 static int knitx_lexer_peek_la(struct knit *knit, struct knit_lex *lxr, struct knit_tok **tokp) {
-    for (int i=0; i<2; i++) {
-        if (lxr->tokno < lxr->tokens.len && lxr->tokens.data[lxr->tokno].toktype == KAT_EOF) {
-            *tokp = &lxr->tokens.data[lxr->tokno];
-            return KNIT_OK;
-        }
-        if (lxr->tokno + 1 >= lxr->tokens.len) {
-            int rv = knitx_lexer_lex(knit, lxr);
-            if (rv != KNIT_OK) {
-                *tokp = NULL;
-                return rv;
-            }
+    int rv = knitx_lexer_peek_cur(knit, lxr, tokp);
+    if (rv != KNIT_OK)
+        return rv;
+    if ((*tokp)->toktype == KAT_EOF)
+        return KNIT_OK;
+    if (lxr->tokno + 1 >= lxr->tokens.len) {
+        rv = knitx_lexer_lex(knit, lxr);
+        if (rv != KNIT_OK) {
+            *tokp = NULL;
+            return rv;
         }
     }
-    knit_assert_h(lxr->tokno < lxr->tokens.len, "");
-    *tokp = &lxr->tokens.data[lxr->tokno];
+    knit_assert_h(lxr->tokno + 1 < lxr->tokens.len, "");
+    *tokp = &lxr->tokens.data[lxr->tokno + 1];
     return KNIT_OK;
 }
 
@@ -1998,6 +3219,7 @@ static const char *knit_knit_tok_name(int name) {
         {KAT_WHILE, "KAT_WHILE"},
         {KAT_LAND, "KAT_LAND"},
         {KAT_LOR,  "KAT_LOR"},
+        {KAT_IN,   "KAT_IN"},
         {KAT_NULL,  "KAT_NULL"},
         {KAT_STRLITERAL, "KAT_STRLITERAL"},
         {KAT_INTLITERAL, "KAT_INTLITERAL"},
@@ -2131,7 +3353,7 @@ static int knit_cur_block_destroy(struct knit *knit, struct knit_curblk *curblk)
         knitx_str_deinit(knit, &curblk->locals.data[i].name);
     }
     knit_varname_darray_deinit(&curblk->locals);
-    knitx_tfree(knit, curblk);
+    knitx_tfree(knit, curblk, sizeof(struct knit_curblk));
     return KNIT_OK;
 }
 
@@ -2156,7 +3378,7 @@ static int knit_patch_loc_list_destroy(struct knit *knit, struct knit_patch_list
     *outp = NULL;
     while (node) {
         next = node->next;
-        knitx_rfree(knit, node);
+        knitx_rfree(knit, node, sizeof *node);
         node = next;
     }
     return KNIT_OK;
@@ -2662,7 +3884,7 @@ static int knitx_expr_destroy(struct knit *knit, struct knit_prs *prs, struct kn
     else if (prs_expr->exptype == KAX_LITERAL_LIST) {
         knit_expr_list_deinit(knit, prs, &prs_expr->u.elist);
     }
-    knitx_tfree(knit, prs_expr); 
+    knitx_tfree(knit, prs_expr, sizeof *prs_expr); 
     return KNIT_OK;
 }
 
@@ -2758,7 +3980,13 @@ static int kexpr_funcdef(struct knit *knit, struct knit_prs *prs) {
     }
     if (rv != KNIT_OK)
         return rv;
-    rv = knitx_emit_ret(knit, prs, 0); //this can be redundant if the function already has a return stmt
+    rv = knitx_emit_ret(knit, prs, 0); //this can be redundant if the function already has a return stmt
+    if (rv != KNIT_OK)
+        return rv;
+    rv = knit_opt_block(knit, &curblk->block);
+    if (rv != KNIT_OK)
+        return rv;
+    rv = knitx_block_pack(knit, &curblk->block); 
     if (rv != KNIT_OK)
         return rv;
 
@@ -2789,7 +4017,7 @@ static int kexpr_funcdef(struct knit *knit, struct knit_prs *prs) {
 
     /*this destroys everything in curblock except .block itsel, (but what if we need debug info?, it should be optionally saved somewhere)f*/
     knit_varname_darray_deinit(&curblk->locals);
-    knitx_tfree(knit, curblk);
+    knitx_tfree(knit, curblk, sizeof(struct knit_curblk));
 
     prs->curblk->expr.exptype = KAX_FUNCTION;
     prs->curblk->expr.u.kfunc = kfunc;
@@ -2803,7 +4031,7 @@ static void knit_kfunc_deinit(struct knit *knit, struct knit_kfunc *kfunc) {
 
 static void knit_kfunc_destroy(struct knit *knit, struct knit_kfunc *kfunc) {
     knit_kfunc_deinit(knit, kfunc);
-    knitx_rfree(knit, kfunc);
+    knitx_rfree(knit, kfunc, sizeof(struct knit_kfunc));
 }
 
 static int kexpr_prefix(struct knit *knit, struct knit_prs *prs) {
@@ -2871,28 +4099,52 @@ static int kexpr_prefix(struct knit *knit, struct knit_prs *prs) {
             prs_expr->u.call.args = arglist;
         }
         else if (K_TOKEN_MATCHES(KAT_OBRACKET)) {
-            //NOTE: slicing should be supported here in the future
+            //a[i] or a slice a[beg:end] where both bounds are optional
             if ((rv = knitx_lexer_skip(knit, &prs->lex)) != KNIT_OK) return rv; //[
             struct knit_expr *indexed_expr =  NULL;
             rv = knitx_save_expr(knit, prs, &indexed_expr);  
             if (rv != KNIT_OK)
                 return rv;
             struct knit_expr *index_expr =  NULL;
-            rv = knitx_expr(knit, prs); 
-            if (rv != KNIT_OK)
-                return rv;
-            rv = knitx_save_expr(knit, prs, &index_expr);  
-            if (rv != KNIT_OK)
-                return rv;
+            if (!K_TOKEN_MATCHES(KAT_COLON)) {
+                rv = knitx_expr(knit, prs); 
+                if (rv != KNIT_OK)
+                    return rv;
+                rv = knitx_save_expr(knit, prs, &index_expr);  
+                if (rv != KNIT_OK)
+                    return rv;
+            }
+            int is_slice = 0;
+            struct knit_expr *end_expr =  NULL;
+            if (K_TOKEN_MATCHES(KAT_COLON)) {
+                is_slice = 1;
+                if ((rv = knitx_lexer_skip(knit, &prs->lex)) != KNIT_OK) return rv; //:
+                if (!K_TOKEN_MATCHES(KAT_CBRACKET)) {
+                    rv = knitx_expr(knit, prs); 
+                    if (rv != KNIT_OK)
+                        return rv;
+                    rv = knitx_save_expr(knit, prs, &end_expr);  
+                    if (rv != KNIT_OK)
+                        return rv;
+                }
+            }
             if (!K_TOKEN_MATCHES(KAT_CBRACKET)) {
                 return knit_error_expected(knit, prs, "]", ""); 
             }
             if ((rv = knitx_lexer_skip(knit, &prs->lex)) != KNIT_OK) return rv; //]
 
             struct knit_expr *prs_expr =  &prs->curblk->expr;
-            prs_expr->exptype = KAX_INDEX;
-            prs_expr->u.index.indexed = indexed_expr;
-            prs_expr->u.index.index = index_expr;
+            if (is_slice) {
+                prs_expr->exptype = KAX_LIST_SLICE;
+                prs_expr->u.slice.exp = indexed_expr;
+                prs_expr->u.slice.beg = index_expr;
+                prs_expr->u.slice.end = end_expr;
+            }
+            else {
+                prs_expr->exptype = KAX_INDEX;
+                prs_expr->u.index.indexed = indexed_expr;
+                prs_expr->u.index.index = index_expr;
+            }
         }
     }
     return KNIT_OK;
@@ -2945,6 +4197,7 @@ static int kexpr_atom(struct knit *knit, struct knit_prs *prs) {
         prs_expr->exptype = KAX_UN_OP;
         prs_expr->u.un.op = op;
         prs_expr->u.un.operand = operand;
+        rv = kexpr_fold_unop(knit, prs);
     }
     else if (K_TOKEN_MATCHES(KAT_FUNCTION)) {
         rv = kexpr_funcdef(knit, prs);
@@ -2988,17 +4241,20 @@ static int kexpr_atom(struct knit *knit, struct knit_prs *prs) {
     }
     else if (K_TOKEN_MATCHES(KAT_STRLITERAL)) {
         prs_expr->exptype = KAX_LITERAL_STR;
-        rv = knitx_str_new_gcobj(knit, &prs_expr->u.str); 
+        struct knit_str tokstr;
+        rv = knitx_str_init(knit, &tokstr); 
         if (rv != KNIT_OK)
             return rv;
-        rv = knitx_tok_extract_to_str(knit, &prs->lex, K_TOKEN(), prs_expr->u.str); 
+        rv = knitx_tok_extract_to_str(knit, &prs->lex, K_TOKEN(), &tokstr); 
         if (rv != KNIT_OK)
             return rv;
-        knit_assert_h( (prs_expr->u.str->len >= 2) && 
-                        ((prs_expr->u.str->str[0] == '\'' && prs_expr->u.str->str[prs_expr->u.str->len - 1] == '\'') ||
-                         (prs_expr->u.str->str[0] == '"' && prs_expr->u.str->str[prs_expr->u.str->len - 1] == '"')   ),
+        knit_assert_h( (tokstr.len >= 2) && 
+                        ((tokstr.str[0] == '\'' && tokstr.str[tokstr.len - 1] == '\'') ||
+                         (tokstr.str[0] == '"' && tokstr.str[tokstr.len - 1] == '"')   ),
                        "expected quoted string literal");
-        rv = knitx_str_mutsubstr(knit, prs_expr->u.str, 1, prs_expr->u.str->len - 1); 
+        //string literals are interned, the quotes are excluded
+        rv = knitx_str_intern_strl(knit, tokstr.str + 1, tokstr.len - 2, &prs_expr->u.str); 
+        knitx_str_deinit(knit, &tokstr);
         if (rv != KNIT_OK)
             return rv;
         if ((rv = knitx_lexer_skip(knit, &prs->lex)) != KNIT_OK) return rv;
@@ -3127,8 +4383,10 @@ enum knit_eval_context {
 };
 
 //emit instructions that do assignment, taking in consideration what kind of lhs we have
+//rhs is NULL when the value was already pushed (for-in loops), lhs must then be a variable
 static int knitx_emit_assignment(struct knit *knit, struct knit_prs *prs, struct knit_expr *lhs, struct knit_expr *rhs) {
     int rv = KNIT_OK;
+    knit_assert_h(rhs || lhs->exptype == KAX_VAR_REF, "");
     if (lhs->exptype == KAX_VAR_REF) {
         knit_assert_s(lhs->u.varref.varname_idx >= 0 && lhs->u.varref.varname_idx < prs->curblk->locals.len,  "");
         int vn_idx = lhs->u.varref.varname_idx;
@@ -3148,9 +4406,11 @@ static int knitx_emit_assignment(struct knit *knit, struct knit_prs *prs, struct
             }
         }
         if (vn->location == KLOC_LOCAL_VAR || vn->location == KLOC_ARG)  {
-            rv = knitx_emit_expr_eval(knit, prs, rhs, KEVAL_VALUE, 1);  
-            if (rv != KNIT_OK)
-                return rv; 
+            if (rhs) {
+                rv = knitx_emit_expr_eval(knit, prs, rhs, KEVAL_VALUE, 1);  
+                if (rv != KNIT_OK)
+                    return rv; 
+            }
             int offset = 0; //stack offset relative to bsp
             if (vn->location == KLOC_LOCAL_VAR) {
                 offset = vn->idx;
@@ -3187,6 +4447,16 @@ static int knitx_emit_assignment(struct knit *knit, struct knit_prs *prs, struct
                 rv = knitx_emit_2(knit, prs, KCLOAD, idx); //load name of global variable
                 if (rv != KNIT_OK)
                     return rv; 
+                if (!rhs) {
+                    //the value is under the name, copy it on top then drop it after the store
+                    rv = knitx_emit_2(knit, prs, KPUSH, -2);
+                    if (rv != KNIT_OK)
+                        return rv;
+                    rv = knitx_emit_1(knit, prs, K_GLB_STORE);
+                    if (rv != KNIT_OK)
+                        return rv;
+                    return knitx_emit_2(knit, prs, KPOP, 1);
+                }
                 rv = knitx_emit_expr_eval(knit, prs, rhs, KEVAL_VALUE, 1); //evaluate the result of rhs and push it
                 if (rv != KNIT_OK)
                     return rv; 
@@ -3568,7 +4838,30 @@ static int knitx_emit_expr_eval(struct knit *knit, struct knit_prs *prs, struct
         }
     }
     else if (expr->exptype == KAX_LIST_SLICE) {
-        return knit_parse_error(prs, "expr eval currently not implemented");
+        rv = knitx_emit_expr_eval(knit, prs, expr->u.slice.exp, KEVAL_VALUE, 1);  
+        if (rv != KNIT_OK)
+            return rv;
+        //omitted bounds are pushed as null
+        if (expr->u.slice.beg)
+            rv = knitx_emit_expr_eval(knit, prs, expr->u.slice.beg, KEVAL_VALUE, 1);  
+        else
+            rv = knitx_emit_2(knit, prs, KEMIT, KEMNULL); 
+        if (rv != KNIT_OK)
+            return rv;
+        if (expr->u.slice.end)
+            rv = knitx_emit_expr_eval(knit, prs, expr->u.slice.end, KEVAL_VALUE, 1);  
+        else
+            rv = knitx_emit_2(knit, prs, KEMIT, KEMNULL); 
+        if (rv != KNIT_OK)
+            return rv;
+        rv = knitx_emit_1(knit, prs, KSLICE);  
+        if (rv != KNIT_OK)
+            return rv;
+        if (eval_ctx == KEVAL_BOOLEAN || nexpected == KRES_UNKNOWN_DISCARD_RET) {
+            rv = knitx_emit_1(knit, prs, KTEST); 
+            if (rv != KNIT_OK)
+                return rv;
+        }
     }
     else if (expr->exptype == KAX_G) {
         return knit_parse_error(prs, "g eval currently not implemented");
@@ -3658,9 +4951,7 @@ static int knitx_emit_expr_eval(struct knit *knit, struct knit_prs *prs, struct
                 //this should improved to be statically computed when possible somehow
                 int idx = -1;
 
-                struct knit_str *namecpy = NULL;
-                rv = knitx_str_new_copy_gcobj(knit, &namecpy, chain->name);
-                rv = knitx_block_add_constant(knit, &prs->curblk->block, (struct knit_obj *) namecpy, &idx); 
+                rv = knitx_current_block_add_strl_constant(knit, prs, chain->name->str, chain->name->len, &idx); 
                 if (rv != KNIT_OK)
                     return rv;
 
@@ -3698,7 +4989,7 @@ static int knitx_emit_expr_eval(struct knit *knit, struct knit_prs *prs, struct
              expr->exptype == KAX_LITERAL_FALSE   ) 
     {
         int emkind = -1;
-        if (nexpected != 1) {
+        if (nexpected != 1 && eval_ctx != KEVAL_BOOLEAN && nexpected != KRES_UNKNOWN_DISCARD_RET) {
             return knit_parse_error(prs, "expr eval of a literal cant be discarded, it must return a single value");
         }
         switch (expr->exptype) {
@@ -3734,6 +5025,173 @@ static int knitx_emit_expr_eval(struct knit *knit, struct knit_prs *prs, struct
     return KNIT_OK;
 }
 
+/*
+    constant folding, applied bottom up as binary and unary op nodes are built (their operands are already folded)
+
+    ops on int and string literals are replaced by their result, and/or with a literal lhs is replaced by the side
+    that would be evaluated. folding never changes behavior: ops that raise an error at runtime (division by zero,
+    mismatched types) are left to raise it, and x+0, x-0, x*1, 1*x are only reduced to x when x is known to be an int
+*/
+static int kexpr_is_literal(struct knit_expr *expr) {
+    switch (expr->exptype) {
+        case KAX_LITERAL_INT:
+        case KAX_LITERAL_STR:
+        case KAX_LITERAL_TRUE:
+        case KAX_LITERAL_FALSE:
+        case KAX_LITERAL_NULL:
+            return 1;
+    }
+    return 0;
+}
+//expr is a literal
+static int kexpr_literal_truth(struct knit_expr *expr) {
+    return expr->exptype != KAX_LITERAL_FALSE && expr->exptype != KAX_LITERAL_NULL;
+}
+//1 if evaluating expr can only produce an int (or raise an error)
+static int kexpr_is_int_valued(struct knit_expr *expr) {
+    if (expr->exptype == KAX_LITERAL_INT)
+        return 1;
+    if (expr->exptype == KAX_UN_OP)
+        return expr->u.un.op == KAT_SUB;
+    if (expr->exptype == KAX_BIN_OP) {
+        switch (expr->u.bin.op) {
+            case KSUB: case KMUL: case KDIV: case KMOD:
+                return 1;
+            case KADD:
+                return kexpr_is_int_valued(expr->u.bin.lhs) && kexpr_is_int_valued(expr->u.bin.rhs);
+        }
+    }
+    return 0;
+}
+static int kexpr_is_int_literal(struct knit_expr *expr, int value) {
+    return expr->exptype == KAX_LITERAL_INT && expr->u.integer == value;
+}
+//replaces the node being built by *expr, which is freed
+static void kexpr_fold_into(struct knit *knit, struct knit_prs *prs, struct knit_expr *expr) {
+    prs->curblk->expr = *expr;
+    knitx_tfree(knit, expr, sizeof *expr);
+}
+static void kexpr_fold_bool(struct knit_prs *prs, int value) {
+    prs->curblk->expr.exptype = value ? KAX_LITERAL_TRUE : KAX_LITERAL_FALSE;
+}
+static int kexpr_fold_int_binop(int op, int a, int b, struct knit_expr *out) {
+    unsigned int ua = a, ub = b;
+    switch (op) {
+        case KADD: out->exptype = KAX_LITERAL_INT; out->u.integer = (int) (ua + ub); return 1;
+        case KSUB: out->exptype = KAX_LITERAL_INT; out->u.integer = (int) (ua - ub); return 1;
+        case KMUL: out->exptype = KAX_LITERAL_INT; out->u.integer = (int) (ua * ub); return 1;
+        case KDIV:
+        case KMOD:
+            if (b == 0 || (a == INT_MIN && b == -1))
+                return 0; //left to the runtime
+            out->exptype = KAX_LITERAL_INT;
+            out->u.integer = op == KDIV ? a / b : a % b;
+            return 1;
+        case KTESTEQ:   out->exptype = a == b ? KAX_LITERAL_TRUE : KAX_LITERAL_FALSE; return 1;
+        case KTESTNEQ:  out->exptype = a != b ? KAX_LITERAL_TRUE : KAX_LITERAL_FALSE; return 1;
+        case KTESTGT:   out->exptype = a >  b ? KAX_LITERAL_TRUE : KAX_LITERAL_FALSE; return 1;
+        case KTESTLT:   out->exptype = a <  b ? KAX_LITERAL_TRUE : KAX_LITERAL_FALSE; return 1;
+        case KTESTGTEQ: out->exptype = a >= b ? KAX_LITERAL_TRUE : KAX_LITERAL_FALSE; return 1;
+        case KTESTLTEQ: out->exptype = a <= b ? KAX_LITERAL_TRUE : KAX_LITERAL_FALSE; return 1;
+    }
+    return 0;
+}
+static int kexpr_fold_str_binop(struct knit *knit, int op, struct knit_str *a, struct knit_str *b, struct knit_expr *out) {
+    if (op == KTESTEQ) {
+        out->exptype = (a->len == b->len && memcmp(a->str, b->str, a->len) == 0) ? KAX_LITERAL_TRUE : KAX_LITERAL_FALSE;
+        return KNIT_OK;
+    }
+    knit_assert_h(op == KADD, "");
+    void *p = NULL;
+    int len = a->len + b->len;
+    int rv = knitx_tmalloc(knit, len + 1, &p);
+    if (rv != KNIT_OK)
+        return rv;
+    memcpy(p, a->str, a->len);
+    memcpy((char *) p + a->len, b->str, b->len);
+    struct knit_str *str = NULL;
+    rv = knitx_str_intern_strl(knit, p, len, &str);
+    knitx_tfree(knit, p, len + 1);
+    if (rv != KNIT_OK)
+        return rv;
+    out->exptype = KAX_LITERAL_STR;
+    out->u.str = str;
+    return KNIT_OK;
+}
+//prs->curblk->expr is a KAX_BIN_OP or a KAX_LOGICAL_BINOP that was just built
+static int kexpr_fold_binop(struct knit *knit, struct knit_prs *prs) {
+    struct knit_expr *prs_expr = &prs->curblk->expr;
+    if (prs_expr->exptype == KAX_LOGICAL_BINOP) {
+        struct knit_expr *lhs = prs_expr->u.logic_bin.lhs;
+        struct knit_expr *rhs = prs_expr->u.logic_bin.rhs;
+        if (!kexpr_is_literal(lhs))
+            return KNIT_OK;
+        int truth = kexpr_literal_truth(lhs);
+        //and: a falsy lhs is the result, or: a truthy lhs is the result, otherwise the result is rhs
+        int take_lhs = prs_expr->u.logic_bin.op == KAT_LAND ? !truth : truth;
+        kexpr_fold_into(knit, prs, take_lhs ? lhs : rhs);
+        knitx_expr_destroy(knit, prs, take_lhs ? rhs : lhs);
+        return KNIT_OK;
+    }
+    knit_assert_h(prs_expr->exptype == KAX_BIN_OP, "");
+    int op = prs_expr->u.bin.op;
+    struct knit_expr *lhs = prs_expr->u.bin.lhs;
+    struct knit_expr *rhs = prs_expr->u.bin.rhs;
+    struct knit_expr folded;
+    int did_fold = 0;
+    if (lhs->exptype == KAX_LITERAL_INT && rhs->exptype == KAX_LITERAL_INT) {
+        did_fold = kexpr_fold_int_binop(op, lhs->u.integer, rhs->u.integer, &folded);
+    }
+    else if (lhs->exptype == KAX_LITERAL_STR && rhs->exptype == KAX_LITERAL_STR && (op == KADD || op == KTESTEQ)) {
+        int rv = kexpr_fold_str_binop(knit, op, lhs->u.str, rhs->u.str, &folded);
+        if (rv != KNIT_OK)
+            return rv;
+        did_fold = 1;
+    }
+    if (did_fold) {
+        *prs_expr = folded;
+        knitx_expr_destroy(knit, prs, lhs);
+        knitx_expr_destroy(knit, prs, rhs);
+        return KNIT_OK;
+    }
+    //algebraic identities, only when the kept operand is an int so type errors are still raised
+    if ((op == KADD || op == KSUB) && kexpr_is_int_literal(rhs, 0) && kexpr_is_int_valued(lhs)) {
+        knitx_expr_destroy(knit, prs, rhs);
+        kexpr_fold_into(knit, prs, lhs);
+    }
+    else if (op == KADD && kexpr_is_int_literal(lhs, 0) && kexpr_is_int_valued(rhs)) {
+        knitx_expr_destroy(knit, prs, lhs);
+        kexpr_fold_into(knit, prs, rhs);
+    }
+    else if ((op == KMUL || op == KDIV) && kexpr_is_int_literal(rhs, 1) && kexpr_is_int_valued(lhs)) {
+        knitx_expr_destroy(knit, prs, rhs);
+        kexpr_fold_into(knit, prs, lhs);
+    }
+    else if (op == KMUL && kexpr_is_int_literal(lhs, 1) && kexpr_is_int_valued(rhs)) {
+        knitx_expr_destroy(knit, prs, lhs);
+        kexpr_fold_into(knit, prs, rhs);
+    }
+    return KNIT_OK;
+}
+//prs->curblk->expr is a KAX_UN_OP that was just built
+static int kexpr_fold_unop(struct knit *knit, struct knit_prs *prs) {
+    struct knit_expr *prs_expr = &prs->curblk->expr;
+    struct knit_expr *operand = prs_expr->u.un.operand;
+    if (prs_expr->u.un.op == KAT_ADD) {
+        kexpr_fold_into(knit, prs, operand); //unary + is a no-op for every type
+    }
+    else if (prs_expr->u.un.op == KAT_SUB && operand->exptype == KAX_LITERAL_INT) {
+        prs_expr->exptype = KAX_LITERAL_INT;
+        prs_expr->u.integer = (int) (0u - (unsigned int) operand->u.integer);
+        knitx_expr_destroy(knit, prs, operand);
+    }
+    else if (prs_expr->u.un.op == KAT_OPU_NOT && kexpr_is_literal(operand)) {
+        kexpr_fold_bool(prs, !kexpr_literal_truth(operand));
+        knitx_expr_destroy(knit, prs, operand);
+    }
+    return KNIT_OK;
+}
+
 //turn a binary op into a sequence of bytecode insns that result in its result being at the top of the stack
 static int kexpr_binoperation(struct knit *knit, struct knit_prs *prs, int op_token, struct knit_expr *lhs_expr, struct knit_expr *rhs_expr) {
     struct knit_expr *prs_expr = &prs->curblk->expr;
@@ -3768,7 +5226,7 @@ static int kexpr_binoperation(struct knit *knit, struct knit_prs *prs, int op_to
         prs_expr->u.bin.lhs = lhs_expr;
         prs_expr->u.bin.rhs = rhs_expr;
     }
-    return KNIT_OK;
+    return kexpr_fold_binop(knit, prs);
 }
 
 static int kexpr_expr(struct knit *knit, struct knit_prs *prs, int min_prec) {
@@ -3875,7 +5333,7 @@ static int knit_prs_sblock_stmt_new(struct knit *knit, struct knit_prs *prs, str
     struct knit_stmt_darray *array = &sblock_stmt->u._sblock.body;
     rv = knit_prs_sblock_into_darray(knit, prs, array); 
     if (rv != KNIT_OK) {
-        knitx_tfree(knit, p);
+        knitx_tfree(knit, p, sizeof(struct knit_stmt));
         return knit_error(knit, KNIT_RUNTIME_ERR, "failed to allocate mmeory for sblock stmt"); 
     }
     sblock_stmt->stmttype = KSTMT_SBLOCK;
@@ -3944,13 +5402,55 @@ static int knitx_prs_if_stmt_new(struct knit *knit, struct knit_prs *prs, struct
     struct knit_stmt *if_stmt = p;
     rv = knitx_prs_if_stmt(knit, prs, if_stmt);
     if (rv != KNIT_OK) {
-        knitx_tfree(knit, if_stmt);
+        knitx_tfree(knit, if_stmt, sizeof(struct knit_stmt));
         return rv;
     }
     *if_stmt_out = if_stmt;
     return KNIT_OK;
 }
 
+//for (var in iterable) { ... }, 'for' and the optional '(' were skipped
+static int knitx_prs_for_in_stmt(struct knit *knit, struct knit_prs *prs, int has_paren, struct knit_stmt *stmt_out) {
+    int rv = knitx_expr(knit, prs);
+    if (rv != KNIT_OK)
+        return rv;
+    if (prs->curblk->expr.exptype != KAX_VAR_REF)
+        return knit_parse_error(prs, "expected a variable name before 'in'");
+    struct knit_expr *var_expr = NULL;
+    rv = knitx_save_expr(knit, prs, &var_expr);
+    if (rv != KNIT_OK)
+        return rv;
+    if (!K_TOKEN_MATCHES(KAT_IN)) {
+        return knit_error_expected(knit, prs, "in", "");
+    }
+    if ((rv = knitx_lexer_skip(knit, &prs->lex)) != KNIT_OK) return rv; // in
+    rv = knitx_expr(knit, prs);
+    if (rv != KNIT_OK)
+        return rv;
+    struct knit_expr *iterable_expr = NULL;
+    rv = knitx_save_expr(knit, prs, &iterable_expr);
+    if (rv != KNIT_OK)
+        return rv;
+    if (has_paren) {
+        if (!K_TOKEN_MATCHES(KAT_CPAREN)) {
+            return knit_error_expected(knit, prs, ")", "");
+        }
+        if ((rv = knitx_lexer_skip(knit, &prs->lex)) != KNIT_OK) return rv; // )
+    }
+
+    rv = knit_prs_sblock_into_darray(knit, prs, &stmt_out->u._for.body);
+    if (rv != KNIT_OK)
+        return rv;
+
+    stmt_out->stmttype = KSTMT_FOR;
+    stmt_out->u._for.init   = NULL;
+    stmt_out->u._for.mutate = NULL;
+    stmt_out->u._for.cond   = NULL;
+    stmt_out->u._for.var    = var_expr;
+    stmt_out->u._for.iterable = iterable_expr;
+    return KNIT_OK;
+}
+
 static int knitx_prs_for_stmt(struct knit *knit, struct knit_prs *prs, struct knit_stmt *stmt_out) {
     int rv = KNIT_OK;
     knit_assert_h(K_TOKEN_MATCHES(KAT_FOR), "");
@@ -3963,6 +5463,8 @@ static int knitx_prs_for_stmt(struct knit *knit, struct knit_prs *prs, struct kn
         has_paren = 1;
         if ((rv = knitx_lexer_skip(knit, &prs->lex)) != KNIT_OK) return rv; // (
     }
+    if (K_TOKEN_MATCHES(KAT_VAR) && K_LA_TOKEN_MATCHES(KAT_IN))
+        return knitx_prs_for_in_stmt(knit, prs, has_paren, stmt_out);
     //init
     if (!K_TOKEN_MATCHES(KAT_SEMICOLON)) {
         //TODO defer emitting code for this statement when it becomes possible in the future
@@ -4013,6 +5515,8 @@ static int knitx_prs_for_stmt(struct knit *knit, struct knit_prs *prs, struct kn
     stmt_out->u._for.init   = init_stmt;
     stmt_out->u._for.mutate = inc_stmt;
     stmt_out->u._for.cond   = cond_expr;
+    stmt_out->u._for.var    = NULL;
+    stmt_out->u._for.iterable = NULL;
 
     return KNIT_OK;
 }
@@ -4101,46 +5605,639 @@ static int knitx_stmt_prs(struct knit *knit, struct knit_prs *prs, int allowed_s
     else if ((a & KSTMT_FOR) && K_TOKEN_MATCHES(KAT_FOR)) {
         rv = knitx_prs_for_stmt(knit, prs, stmt_out); 
         if (rv != KNIT_OK)
-            return rv;
-    }
-    else if ((a & KSTMT_WHILE) && K_TOKEN_MATCHES(KAT_WHILE)) {
-        rv = knitx_while_stmt(knit, prs, stmt_out); 
+            return rv;
+    }
+    else if ((a & KSTMT_WHILE) && K_TOKEN_MATCHES(KAT_WHILE)) {
+        rv = knitx_while_stmt(knit, prs, stmt_out); 
+        if (rv != KNIT_OK)
+            return rv;
+    }
+    else if ((a & KSTMT_RETURN) && K_TOKEN_MATCHES(KAT_RETURN)) {
+
+        if ((rv = knitx_lexer_skip(knit, &prs->lex)) != KNIT_OK) return rv; //return
+        rv = knitx_expr(knit, prs); 
+        if (rv != KNIT_OK)
+            return rv;
+        struct knit_expr *root_expr = NULL;
+        rv = knitx_save_expr(knit, prs, &root_expr);  
+        if (rv != KNIT_OK)
+            return rv;
+        //?knitx_expr_destroy(knit, prs, root_expr);
+        stmt_out->u._expr = root_expr;
+        stmt_out->stmttype = KSTMT_RETURN;
+        if (skip_semicolon && K_TOKEN_MATCHES(KAT_SEMICOLON)) {
+            if ((rv = knitx_lexer_skip(knit, &prs->lex)) != KNIT_OK) return rv; //skip ';'
+        }
+    }
+    else {
+        return knit_error_expected(knit, prs, "a statement", "");
+    }
+    rv = knitx_skip_nl(knit, prs);
+    return rv;
+
+}
+
+static int knitx_emit_ret(struct knit *knit, struct knit_prs *prs, int count) {
+    if (count > 1 || count < 0)
+        return knit_parse_error(prs, "returning multiple values is not implemented");
+    return knitx_emit_2(knit, prs, KRET, count);
+}
+
+/*
+ * for (var in iterable) body
+ *
+ * iterable
+ * KITER_PREP idx
+ * L1:
+ * KITER_NEXT idx
+ * KJMPFALSE L2
+ * var = (the pushed item)
+ * body
+ * KJMP L1
+ * L2:
+ */
+static int knitx_emit_for_in(struct knit *knit, struct knit_prs *prs, struct knit_stmt *stmt) {
+    struct knit_block *block = &prs->curblk->block;
+    //three locals without a name hold the iterable, the position and the layout of a dict
+    int idx = block->nlocals;
+    block->nlocals += 3;
+    int rv = knitx_emit_expr_eval(knit, prs, stmt->u._for.iterable, KEVAL_VALUE, 1);
+    if (rv != KNIT_OK)
+        return rv;
+    rv = knitx_emit_2(knit, prs, KITER_PREP, idx);
+    if (rv != KNIT_OK)
+        return rv;
+    int L1_address = block->insns.len;
+    rv = knitx_emit_2(knit, prs, KITER_NEXT, idx);
+    if (rv != KNIT_OK)
+        return rv;
+    rv = knitx_emit_2(knit, prs, KJMPFALSE, KINSN_ADDR_UNK); //will be backpatched to point to L2
+    if (rv != KNIT_OK)
+        return rv;
+    struct knit_patch_list *L2_pos = NULL;
+    rv = knit_patch_loc_new_or_insert(knit, block->insns.len - 1, &L2_pos);
+    if (rv != KNIT_OK)
+        return rv;
+    rv = knitx_emit_assignment(knit, prs, stmt->u._for.var, NULL);
+    if (rv != KNIT_OK)
+        return rv;
+    rv = knitx_stmt_array_emit(knit, prs, &stmt->u._for.body);
+    if (rv != KNIT_OK)
+        return rv;
+    rv = knitx_emit_2(knit, prs, KJMP, L1_address);
+    if (rv != KNIT_OK)
+        return rv;
+    return knit_patch_loc_list_patch_and_destroy(knit, block, &L2_pos, block->insns.len);
+}
+
+static int knitx_expr_is_var(struct knit_expr *expr, int vn_idx) {
+    return expr->exptype == KAX_VAR_REF && expr->u.varref.varname_idx == vn_idx;
+}
+
+/*
+Loop optimizations, done on a while or a C style for before it is emitted, see knitx_loop_optimize()
+
+Invariant parts of the condition are computed once before the loop into hidden locals. The condition is tested
+before every iteration, the first one included, so computing them where it would first be tested doesn't change
+what runs. A part is invariant if it only reads variables the loop doesn't assign, with operators and indexing,
+indexing also needs the loop to leave containers alone (no index stores, method calls or calls). They are only
+hoisted from conditions made of nothing else, and only when the condition always evaluates them (not the right
+side of and/or). for (i = 0; i < n / 2; i = i + 1) becomes a counting loop.
+
+v * k (k an int literal) is strength reduced when the loop has it at least twice and v is an induction variable: an
+int when the loop starts (the for's init or the statement before the while assigns it an int literal) that the loop
+only changes with v = v + c or v = v - c. A hidden local t = v * k is set before the loop and t = t + c * k follows
+every step of v, one add replaces the multiplication at each use.
+
+Calls, len() and print() included, are assumed to change containers and globals: any global, builtins
+included, can be rebound by a program that runs after the loop was compiled.
+*/
+static int knitx_loop_assigned(struct knit_loop *loop, int vn_idx) {
+    return vn_idx < loop->nvars ? loop->assigned[vn_idx] : 0;
+}
+static void knitx_loop_set_assigned(struct knit_loop *loop, int vn_idx, int stepped) {
+    if (vn_idx >= loop->nvars)
+        return;
+    if (!stepped)
+        loop->assigned[vn_idx] = KNIT_LOOP_ASSIGNED;
+    else if (!loop->assigned[vn_idx])
+        loop->assigned[vn_idx] = KNIT_LOOP_STEPPED;
+}
+//1 if the variable is a global, one not resolved yet becomes a local when a function assigns it
+static int knitx_loop_var_is_global(struct knit *knit, struct knit_prs *prs, struct knit_loop *loop, int vn_idx) {
+    int location = knit_get_varname_by_idx(prs->curblk, vn_idx)->location;
+    if (location == KLOC_UNKNOWN)
+        return knitx_is_in_filescope(knit, prs) || !knitx_loop_assigned(loop, vn_idx);
+    return location == KLOC_GLOBAL_R || location == KLOC_GLOBAL_RW;
+}
+//stmt is var = var + c or var = var - c, c an int literal, *step is c or -c
+static int knitx_loop_step(struct knit_stmt *stmt, int *var_idx, int *step) {
+    if (stmt->stmttype != KSTMT_ASSIGN || stmt->u._assign.lhs->exptype != KAX_VAR_REF)
+        return 0;
+    int vn_idx = stmt->u._assign.lhs->u.varref.varname_idx;
+    struct knit_expr *rhs = stmt->u._assign.rhs;
+    if (rhs->exptype != KAX_BIN_OP || (rhs->u.bin.op != KADD && rhs->u.bin.op != KSUB))
+        return 0;
+    if (!knitx_expr_is_var(rhs->u.bin.lhs, vn_idx) || rhs->u.bin.rhs->exptype != KAX_LITERAL_INT)
+        return 0;
+    unsigned int c = rhs->u.bin.rhs->u.integer;
+    *var_idx = vn_idx;
+    *step = (int) (rhs->u.bin.op == KSUB ? 0u - c : c);
+    return 1;
+}
+//expr is var * k or k * var, k an int literal
+static int knitx_loop_mul(struct knit_expr *expr, int *var_idx, int *k) {
+    if (expr->exptype != KAX_BIN_OP || expr->u.bin.op != KMUL)
+        return 0;
+    struct knit_expr *a = expr->u.bin.lhs;
+    struct knit_expr *b = expr->u.bin.rhs;
+    if (a->exptype == KAX_LITERAL_INT) {
+        b = expr->u.bin.lhs;
+        a = expr->u.bin.rhs;
+    }
+    if (a->exptype != KAX_VAR_REF || b->exptype != KAX_LITERAL_INT)
+        return 0;
+    *var_idx = a->u.varref.varname_idx;
+    *k = b->u.integer;
+    return 1;
+}
+
+static void knitx_loop_count_mul(struct knit_loop *loop, int var_idx, int k) {
+    for (int i=0; i<loop->nmuls; i++) {
+        if (loop->muls[i].var_idx == var_idx && loop->muls[i].k == k) {
+            loop->muls[i].count++;
+            return;
+        }
+    }
+    if (loop->nmuls < KNIT_LOOP_MAX_TMPS) {
+        loop->muls[loop->nmuls].var_idx = var_idx;
+        loop->muls[loop->nmuls].k = k;
+        loop->muls[loop->nmuls].count = 1;
+        loop->nmuls++;
+    }
+}
+static void knitx_loop_reduce_mul(struct knit_loop *loop, struct knit_expr *expr, int var_idx, int k) {
+    for (int i=0; i<loop->nsr; i++) {
+        if (loop->sr[i].var_idx == var_idx && loop->sr[i].k == k) {
+            expr->exptype = KAX_VAR_REF;
+            expr->u.varref.varname_idx = loop->sr[i].tmp_idx;
+        }
+    }
+}
+//scans the expressions of the loop (reduce is 0) or replaces the strength reduced products (reduce is 1)
+static void knitx_loop_walk_expr(struct knit *knit, struct knit_prs *prs, struct knit_loop *loop, struct knit_expr *expr, int reduce) {
+    if (!expr)
+        return;
+    int var_idx = -1;
+    int k = 0;
+    if (knitx_loop_mul(expr, &var_idx, &k)) {
+        if (reduce)
+            knitx_loop_reduce_mul(loop, expr, var_idx, k);
+        else
+            knitx_loop_count_mul(loop, var_idx, k);
+        return;
+    }
+    switch (expr->exptype) {
+        case KAX_CALL:
+            if (!reduce) {
+                loop->mutates = 1;
+                loop->writes_globals = 1;
+            }
+            knitx_loop_walk_expr(knit, prs, loop, expr->u.call.called, reduce);
+            for (int i=0; i<expr->u.call.args.len; i++)
+                knitx_loop_walk_expr(knit, prs, loop, expr->u.call.args.data[i], reduce);
+            break;
+        case KAX_PAIR:
+        case KAX_BIN_OP:
+            knitx_loop_walk_expr(knit, prs, loop, expr->u.bin.lhs, reduce);
+            knitx_loop_walk_expr(knit, prs, loop, expr->u.bin.rhs, reduce);
+            break;
+        case KAX_LOGICAL_BINOP:
+            knitx_loop_walk_expr(knit, prs, loop, expr->u.logic_bin.lhs, reduce);
+            knitx_loop_walk_expr(knit, prs, loop, expr->u.logic_bin.rhs, reduce);
+            break;
+        case KAX_UN_OP:
+            knitx_loop_walk_expr(knit, prs, loop, expr->u.un.operand, reduce);
+            break;
+        case KAX_LITERAL_LIST:
+        case KAX_LITERAL_DICT:
+            for (int i=0; i<expr->u.elist.len; i++)
+                knitx_loop_walk_expr(knit, prs, loop, expr->u.elist.data[i], reduce);
+            break;
+        case KAX_INDEX:
+            knitx_loop_walk_expr(knit, prs, loop, expr->u.index.indexed, reduce);
+            knitx_loop_walk_expr(knit, prs, loop, expr->u.index.index, reduce);
+            break;
+        case KAX_LIST_SLICE:
+            knitx_loop_walk_expr(knit, prs, loop, expr->u.slice.exp, reduce);
+            knitx_loop_walk_expr(knit, prs, loop, expr->u.slice.beg, reduce);
+            knitx_loop_walk_expr(knit, prs, loop, expr->u.slice.end, reduce);
+            break;
+        case KAX_OBJ_DOT:
+            knitx_loop_walk_expr(knit, prs, loop, expr->u.prefix.parent, reduce);
+            break;
+    }
+}
+static void knitx_loop_walk_stmts(struct knit *knit, struct knit_prs *prs, struct knit_loop *loop, struct knit_stmt_darray *stmts, int reduce);
+static void knitx_loop_walk_stmt(struct knit *knit, struct knit_prs *prs, struct knit_loop *loop, struct knit_stmt *stmt, int reduce) {
+    if (!stmt)
+        return;
+    if (stmt->stmttype == KSTMT_ASSIGN) {
+        struct knit_expr *lhs = stmt->u._assign.lhs;
+        int var_idx = -1;
+        int step = 0;
+        if (!reduce && lhs->exptype == KAX_VAR_REF)
+            knitx_loop_set_assigned(loop, lhs->u.varref.varname_idx, knitx_loop_step(stmt, &var_idx, &step));
+        else if (!reduce && lhs->exptype == KAX_INDEX)
+            loop->mutates = 1;
+        else if (!reduce)
+            loop->writes_globals = 1; //g.name =
+        if (lhs->exptype == KAX_INDEX) {
+            knitx_loop_walk_expr(knit, prs, loop, lhs->u.index.indexed, reduce);
+            knitx_loop_walk_expr(knit, prs, loop, lhs->u.index.index, reduce);
+        }
+        knitx_loop_walk_expr(knit, prs, loop, stmt->u._assign.rhs, reduce);
+    }
+    else if (stmt->stmttype == KSTMT_FOR) {
+        if (stmt->u._for.var && stmt->u._for.var->exptype == KAX_VAR_REF && !reduce)
+            knitx_loop_set_assigned(loop, stmt->u._for.var->u.varref.varname_idx, 0);
+        knitx_loop_walk_expr(knit, prs, loop, stmt->u._for.iterable, reduce);
+        knitx_loop_walk_stmt(knit, prs, loop, stmt->u._for.init, reduce);
+        knitx_loop_walk_expr(knit, prs, loop, stmt->u._for.cond, reduce);
+        knitx_loop_walk_stmt(knit, prs, loop, stmt->u._for.mutate, reduce);
+        knitx_loop_walk_stmts(knit, prs, loop, &stmt->u._for.body, reduce);
+    }
+    else if (stmt->stmttype == KSTMT_WHILE) {
+        knitx_loop_walk_expr(knit, prs, loop, stmt->u._while.cond, reduce);
+        knitx_loop_walk_stmts(knit, prs, loop, &stmt->u._while.body, reduce);
+    }
+    else if (stmt->stmttype == KSTMT_IF) {
+        knitx_loop_walk_expr(knit, prs, loop, stmt->u._if.cond, reduce);
+        knitx_loop_walk_stmts(knit, prs, loop, &stmt->u._if.body, reduce);
+        knitx_loop_walk_stmt(knit, prs, loop, stmt->u._if._else, reduce);
+    }
+    else if (stmt->stmttype == KSTMT_SBLOCK) {
+        knitx_loop_walk_stmts(knit, prs, loop, &stmt->u._sblock.body, reduce);
+    }
+    else {
+        knitx_loop_walk_expr(knit, prs, loop, stmt->u._expr, reduce); //KSTMT_EXPR, KSTMT_RETURN
+    }
+}
+static void knitx_loop_walk_stmts(struct knit *knit, struct knit_prs *prs, struct knit_loop *loop, struct knit_stmt_darray *stmts, int reduce) {
+    for (int i=0; i<stmts->len; i++)
+        knitx_loop_walk_stmt(knit, prs, loop, stmts->data[i], reduce);
+}
+//the condition, body and mutate statement of the loop
+static void knitx_loop_walk(struct knit *knit, struct knit_prs *prs, struct knit_loop *loop, struct knit_stmt *stmt, int reduce) {
+    if (stmt->stmttype == KSTMT_WHILE) {
+        knitx_loop_walk_expr(knit, prs, loop, stmt->u._while.cond, reduce);
+        knitx_loop_walk_stmts(knit, prs, loop, &stmt->u._while.body, reduce);
+    }
+    else {
+        knitx_loop_walk_expr(knit, prs, loop, stmt->u._for.cond, reduce);
+        knitx_loop_walk_stmts(knit, prs, loop, &stmt->u._for.body, reduce);
+        knitx_loop_walk_stmt(knit, prs, loop, stmt->u._for.mutate, reduce);
+    }
+}
+
+//1 if evaluating expr can only read: variables, literals, operators, indexing and len()
+static int knitx_loop_expr_is_pure(struct knit *knit, struct knit_prs *prs, struct knit_expr *expr) {
+    switch (expr->exptype) {
+        case KAX_LITERAL_INT: case KAX_LITERAL_STR: case KAX_LITERAL_TRUE: case KAX_LITERAL_FALSE:
+        case KAX_LITERAL_NULL: case KAX_VAR_REF:
+            return 1;
+        case KAX_BIN_OP:
+            return knitx_loop_expr_is_pure(knit, prs, expr->u.bin.lhs) && knitx_loop_expr_is_pure(knit, prs, expr->u.bin.rhs);
+        case KAX_LOGICAL_BINOP:
+            return knitx_loop_expr_is_pure(knit, prs, expr->u.logic_bin.lhs) &&
+                   knitx_loop_expr_is_pure(knit, prs, expr->u.logic_bin.rhs);
+        case KAX_UN_OP:
+            return knitx_loop_expr_is_pure(knit, prs, expr->u.un.operand);
+        case KAX_INDEX:
+            return knitx_loop_expr_is_pure(knit, prs, expr->u.index.indexed) &&
+                   knitx_loop_expr_is_pure(knit, prs, expr->u.index.index);
+    }
+    return 0;
+}
+//1 if a pure expr has the same value in every iteration
+static int knitx_loop_expr_is_invariant(struct knit *knit, struct knit_prs *prs, struct knit_loop *loop, struct knit_expr *expr) {
+    switch (expr->exptype) {
+        case KAX_VAR_REF: {
+            int vn_idx = expr->u.varref.varname_idx;
+            if (knitx_loop_assigned(loop, vn_idx))
+                return 0;
+            return !knitx_loop_var_is_global(knit, prs, loop, vn_idx) || !loop->writes_globals;
+        }
+        case KAX_BIN_OP:
+            return knitx_loop_expr_is_invariant(knit, prs, loop, expr->u.bin.lhs) &&
+                   knitx_loop_expr_is_invariant(knit, prs, loop, expr->u.bin.rhs);
+        case KAX_UN_OP:
+            return knitx_loop_expr_is_invariant(knit, prs, loop, expr->u.un.operand);
+        case KAX_INDEX:
+            return !loop->mutates && knitx_loop_expr_is_invariant(knit, prs, loop, expr->u.index.indexed) &&
+                   knitx_loop_expr_is_invariant(knit, prs, loop, expr->u.index.index);
+        case KAX_LOGICAL_BINOP:
+            return 0;
+    }
+    return 1; //literals
+}
+//a local without a name the program could use
+static int knitx_loop_new_tmp(struct knit *knit, struct knit_prs *prs, int *vn_idx) {
+    char buf[32];
+    snprintf(buf, sizeof buf, "(loop %d)", prs->curblk->locals.len);
+    struct knit_str name;
+    int rv = knitx_str_init_const_str(knit, &name, buf);
+    if (rv != KNIT_OK)
+        return rv;
+    rv = knitx_add_block_var(knit, prs->curblk, &name, vn_idx);
+    if (rv != KNIT_OK)
+        return rv;
+    return knitx_varname_set_location(knit, prs->curblk, *vn_idx, KLOC_LOCAL_VAR);
+}
+static int knitx_loop_hoist(struct knit *knit, struct knit_prs *prs, struct knit_loop *loop, struct knit_expr *expr);
+static int knitx_loop_hoist_operand(struct knit *knit, struct knit_prs *prs, struct knit_loop *loop, struct knit_expr *expr) {
+    int computed = expr->exptype == KAX_BIN_OP || expr->exptype == KAX_UN_OP || expr->exptype == KAX_INDEX;
+    if (!computed || !knitx_loop_expr_is_invariant(knit, prs, loop, expr))
+        return knitx_loop_hoist(knit, prs, loop, expr);
+    if (loop->nhoisted == KNIT_LOOP_MAX_TMPS)
+        return KNIT_OK;
+    int tmp_idx = -1;
+    int rv = knitx_loop_new_tmp(knit, prs, &tmp_idx);
+    if (rv != KNIT_OK)
+        return rv;
+    void *p = NULL;
+    rv = knitx_tmalloc(knit, sizeof(struct knit_expr), &p);
+    if (rv != KNIT_OK)
+        return rv;
+    struct knit_expr *moved = p;
+    *moved = *expr;
+    expr->exptype = KAX_VAR_REF;
+    expr->u.varref.varname_idx = tmp_idx;
+    loop->hoisted[loop->nhoisted].tmp_idx = tmp_idx;
+    loop->hoisted[loop->nhoisted].expr = moved;
+    loop->nhoisted++;
+    return KNIT_OK;
+}
+//hoists the invariant operands of expr the condition always evaluates
+static int knitx_loop_hoist(struct knit *knit, struct knit_prs *prs, struct knit_loop *loop, struct knit_expr *expr) {
+    int rv = KNIT_OK;
+    switch (expr->exptype) {
+        case KAX_BIN_OP:
+            rv = knitx_loop_hoist_operand(knit, prs, loop, expr->u.bin.lhs);
+            if (rv != KNIT_OK)
+                return rv;
+            return knitx_loop_hoist_operand(knit, prs, loop, expr->u.bin.rhs);
+        case KAX_LOGICAL_BINOP:
+            return knitx_loop_hoist_operand(knit, prs, loop, expr->u.logic_bin.lhs);
+        case KAX_UN_OP:
+            return knitx_loop_hoist_operand(knit, prs, loop, expr->u.un.operand);
+        case KAX_INDEX:
+            rv = knitx_loop_hoist_operand(knit, prs, loop, expr->u.index.indexed);
+            if (rv != KNIT_OK)
+                return rv;
+            return knitx_loop_hoist_operand(knit, prs, loop, expr->u.index.index);
+    }
+    return rv;
+}
+//1 if the variable holds an int when the loop starts
+static int knitx_loop_int_at_entry(struct knit_prs *prs, struct knit_stmt *stmt, int vn_idx) {
+    if (stmt->stmttype == KSTMT_FOR) {
+        struct knit_stmt *init = stmt->u._for.init;
+        return init && init->stmttype == KSTMT_ASSIGN && knitx_expr_is_var(init->u._assign.lhs, vn_idx) &&
+               init->u._assign.rhs->exptype == KAX_LITERAL_INT;
+    }
+    return prs->int_var_blk == prs->curblk && prs->int_var == vn_idx;
+}
+
+//the hoisted expressions are only emitted by the preheader, the statement tree refers to their temporaries
+static void knitx_loop_free_hoisted(struct knit *knit, struct knit_loop *loop) {
+    for (int i=0; i<loop->nhoisted; i++)
+        knitx_tfree(knit, loop->hoisted[i].expr, sizeof *loop->hoisted[i].expr);
+    loop->nhoisted = 0;
+}
+
+//rewrites the while or C style for stmt, what to emit before it is left in loop
+static int knitx_loop_optimize(struct knit *knit, struct knit_prs *prs, struct knit_stmt *stmt, struct knit_loop *loop) {
+    memset(loop, 0, sizeof *loop);
+    struct knit_expr *cond = stmt->stmttype == KSTMT_WHILE ? stmt->u._while.cond : stmt->u._for.cond;
+    if (!cond)
+        return KNIT_OK;
+    loop->nvars = prs->curblk->locals.len;
+    void *p = NULL;
+    int rv = knitx_tmalloc(knit, loop->nvars + 1, &p);
+    if (rv != KNIT_OK)
+        return rv;
+    loop->assigned = p;
+    memset(loop->assigned, 0, loop->nvars + 1);
+    knitx_loop_walk(knit, prs, loop, stmt, 0);
+    //the products reduced by enclosing loops change when their variable does
+    for (struct knit_loop_sr *sr = prs->loop_sr; sr; sr = sr->next) {
+        if (knitx_loop_assigned(loop, sr->var_idx))
+            knitx_loop_set_assigned(loop, sr->tmp_idx, 0);
+    }
+    if (knitx_loop_expr_is_pure(knit, prs, cond)) {
+        rv = knitx_loop_hoist(knit, prs, loop, cond);
+        if (rv != KNIT_OK)
+            goto cleanup;
+    }
+    for (int i=0; i<loop->nmuls; i++) {
+        int vn_idx = loop->muls[i].var_idx;
+        if (loop->muls[i].count < 2 || knitx_loop_assigned(loop, vn_idx) != KNIT_LOOP_STEPPED)
+            continue;
+        if (!knitx_loop_int_at_entry(prs, stmt, vn_idx))
+            continue;
+        if (knitx_loop_var_is_global(knit, prs, loop, vn_idx) && loop->writes_globals)
+            continue;
+        struct knit_loop_sr *sr = &loop->sr[loop->nsr++];
+        sr->var_idx = vn_idx;
+        sr->k = loop->muls[i].k;
+        rv = knitx_loop_new_tmp(knit, prs, &sr->tmp_idx);
         if (rv != KNIT_OK)
-            return rv;
+            goto cleanup;
     }
-    else if ((a & KSTMT_RETURN) && K_TOKEN_MATCHES(KAT_RETURN)) {
-
-        if ((rv = knitx_lexer_skip(knit, &prs->lex)) != KNIT_OK) return rv; //return
-        rv = knitx_expr(knit, prs); 
+    if (loop->nsr)
+        knitx_loop_walk(knit, prs, loop, stmt, 1);
+cleanup:
+    if (rv != KNIT_OK)
+        knitx_loop_free_hoisted(knit, loop);
+    knitx_tfree(knit, loop->assigned, loop->nvars + 1);
+    loop->assigned = NULL;
+    return rv;
+}
+//t = t + step * k for the products of var reduced by the loops being emitted, after var = var + step
+static int knitx_loop_emit_step(struct knit *knit, struct knit_prs *prs, int var_idx, int step) {
+    for (struct knit_loop_sr *sr = prs->loop_sr; sr; sr = sr->next) {
+        if (sr->var_idx != var_idx)
+            continue;
+        struct knit_expr tmp = {0};
+        struct knit_expr delta = {0};
+        struct knit_expr sum = {0};
+        tmp.exptype = KAX_VAR_REF;
+        tmp.u.varref.varname_idx = sr->tmp_idx;
+        delta.exptype = KAX_LITERAL_INT;
+        delta.u.integer = (int) ((unsigned int) step * (unsigned int) sr->k);
+        sum.exptype = KAX_BIN_OP;
+        sum.u.bin.op = KADD;
+        sum.u.bin.lhs = &tmp;
+        sum.u.bin.rhs = &delta;
+        int rv = knitx_emit_assignment(knit, prs, &tmp, &sum);
         if (rv != KNIT_OK)
             return rv;
-        struct knit_expr *root_expr = NULL;
-        rv = knitx_save_expr(knit, prs, &root_expr);  
-        if (rv != KNIT_OK)
+    }
+    return KNIT_OK;
+}
+//computes the hoisted expressions and the reduced products, the for's init was emitted
+static int knitx_loop_emit_preheader(struct knit *knit, struct knit_prs *prs, struct knit_loop *loop) {
+    struct knit_expr tmp = {0};
+    tmp.exptype = KAX_VAR_REF;
+    for (int i=0; i<loop->nhoisted; i++) {
+        tmp.u.varref.varname_idx = loop->hoisted[i].tmp_idx;
+        int rv = knitx_emit_assignment(knit, prs, &tmp, loop->hoisted[i].expr);
+        if (rv != KNIT_OK) {
+            knitx_loop_free_hoisted(knit, loop);
             return rv;
-        //?knitx_expr_destroy(knit, prs, root_expr);
-        stmt_out->u._expr = root_expr;
-        stmt_out->stmttype = KSTMT_RETURN;
-        if (skip_semicolon && K_TOKEN_MATCHES(KAT_SEMICOLON)) {
-            if ((rv = knitx_lexer_skip(knit, &prs->lex)) != KNIT_OK) return rv; //skip ';'
         }
     }
-    else {
-        return knit_error_expected(knit, prs, "a statement", "");
+    knitx_loop_free_hoisted(knit, loop);
+    for (int i=0; i<loop->nsr; i++) {
+        struct knit_loop_sr *sr = &loop->sr[i];
+        struct knit_expr var = {0};
+        struct knit_expr k = {0};
+        struct knit_expr product = {0};
+        var.exptype = KAX_VAR_REF;
+        var.u.varref.varname_idx = sr->var_idx;
+        k.exptype = KAX_LITERAL_INT;
+        k.u.integer = sr->k;
+        product.exptype = KAX_BIN_OP;
+        product.u.bin.op = KMUL;
+        product.u.bin.lhs = &var;
+        product.u.bin.rhs = &k;
+        tmp.u.varref.varname_idx = sr->tmp_idx;
+        int rv = knitx_emit_assignment(knit, prs, &tmp, &product);
+        if (rv != KNIT_OK)
+            return rv;
+        sr->next = prs->loop_sr;
+        prs->loop_sr = sr;
     }
-    rv = knitx_skip_nl(knit, prs);
-    return rv;
-
+    return KNIT_OK;
+}
+//the loop's reductions stop being updated
+static void knitx_loop_end(struct knit_prs *prs, struct knit_loop *loop) {
+    if (loop->nsr)
+        prs->loop_sr = loop->sr[0].next;
+}
+
+//the KFORPREP/KFORLOOP op1 of a C style for shaped like for (i = a; i < n; i = i + k), -1 for other loops.
+//n must be an int literal or another variable (loading it has no side effects and doesn't depend on i),
+//the comparison can be any of < <= > >= and the step an int literal added or subtracted
+static int knitx_for_counting_op1(struct knit_stmt *stmt) {
+    struct knit_stmt *init = stmt->u._for.init;
+    struct knit_expr *cond = stmt->u._for.cond;
+    struct knit_stmt *mutate = stmt->u._for.mutate;
+    if (!init || !cond || !mutate || init->stmttype != KSTMT_ASSIGN || mutate->stmttype != KSTMT_ASSIGN)
+        return -1;
+    if (init->u._assign.lhs->exptype != KAX_VAR_REF)
+        return -1;
+    int vn_idx = init->u._assign.lhs->u.varref.varname_idx;
+    if (cond->exptype != KAX_BIN_OP || !knitx_expr_is_var(cond->u.bin.lhs, vn_idx))
+        return -1;
+    struct knit_expr *limit = cond->u.bin.rhs;
+    if (limit->exptype != KAX_LITERAL_INT && (limit->exptype != KAX_VAR_REF || knitx_expr_is_var(limit, vn_idx)))
+        return -1;
+    int cmp = -1;
+    for (int i=0; i<4; i++) {
+        if (cond->u.bin.op == knit_for_cmp_ops[i])
+            cmp = i;
+    }
+    struct knit_expr *next = mutate->u._assign.rhs;
+    if (cmp < 0 || !knitx_expr_is_var(mutate->u._assign.lhs, vn_idx) || next->exptype != KAX_BIN_OP)
+        return -1;
+    if (next->u.bin.op != KADD && next->u.bin.op != KSUB)
+        return -1;
+    if (!knitx_expr_is_var(next->u.bin.lhs, vn_idx) || next->u.bin.rhs->exptype != KAX_LITERAL_INT)
+        return -1;
+    int step = next->u.bin.rhs->u.integer;
+    if (step < 0 || step > KNIT_FOR_MAX_STEP)
+        return -1;
+    return KNIT_FOR_OP1(cmp, next->u.bin.op == KSUB, step);
 }
 
-static int knitx_emit_ret(struct knit *knit, struct knit_prs *prs, int count) {
-    if (count > 1 || count < 0)
-        return knit_parse_error(prs, "returning multiple values is not implemented");
-    return knitx_emit_2(knit, prs, KRET, count);
+/*
+ * for (i = a; i < n; i = i + k) body, the condition is tested at the bottom so an iteration
+ * runs one fused instruction instead of the separate add, test and jumps
+ *
+ * i = a
+ * (preheader)
+ * i n KFORPREP op1
+ * KJMPFALSE L2
+ * L1:
+ * body
+ * i n KFORLOOP op1
+ * i = (the pushed value)
+ * (the reduced products of i step)
+ * KJMPTRUE L1
+ * L2:
+ */
+static int knitx_emit_for_counting(struct knit *knit, struct knit_prs *prs, struct knit_stmt *stmt, int op1, struct knit_loop *loop) {
+    struct knit_block *block = &prs->curblk->block;
+    struct knit_expr *cond = stmt->u._for.cond;
+    int rv = knitx_stmt_emit(knit, prs, stmt->u._for.init);
+    if (rv != KNIT_OK)
+        return rv;
+    rv = knitx_loop_emit_preheader(knit, prs, loop);
+    if (rv != KNIT_OK)
+        return rv;
+    rv = knitx_emit_expr_eval(knit, prs, cond->u.bin.lhs, KEVAL_VALUE, 1);
+    if (rv != KNIT_OK)
+        return rv;
+    rv = knitx_emit_expr_eval(knit, prs, cond->u.bin.rhs, KEVAL_VALUE, 1);
+    if (rv != KNIT_OK)
+        return rv;
+    rv = knitx_emit_2(knit, prs, KFORPREP, op1);
+    if (rv != KNIT_OK)
+        return rv;
+    rv = knitx_emit_2(knit, prs, KJMPFALSE, KINSN_ADDR_UNK); //will be backpatched to point to L2
+    if (rv != KNIT_OK)
+        return rv;
+    struct knit_patch_list *L2_pos = NULL;
+    rv = knit_patch_loc_new_or_insert(knit, block->insns.len - 1, &L2_pos);
+    if (rv != KNIT_OK)
+        return rv;
+    int L1_address = block->insns.len;
+    rv = knitx_stmt_array_emit(knit, prs, &stmt->u._for.body);
+    if (rv != KNIT_OK)
+        return rv;
+    rv = knitx_emit_expr_eval(knit, prs, cond->u.bin.lhs, KEVAL_VALUE, 1);
+    if (rv != KNIT_OK)
+        return rv;
+    rv = knitx_emit_expr_eval(knit, prs, cond->u.bin.rhs, KEVAL_VALUE, 1);
+    if (rv != KNIT_OK)
+        return rv;
+    rv = knitx_emit_2(knit, prs, KFORLOOP, op1);
+    if (rv != KNIT_OK)
+        return rv;
+    rv = knitx_emit_assignment(knit, prs, stmt->u._for.init->u._assign.lhs, NULL);
+    if (rv != KNIT_OK)
+        return rv;
+    int step = KNIT_FOR_SUB(op1) ? -KNIT_FOR_STEP(op1) : KNIT_FOR_STEP(op1);
+    rv = knitx_loop_emit_step(knit, prs, stmt->u._for.init->u._assign.lhs->u.varref.varname_idx, step);
+    if (rv != KNIT_OK)
+        return rv;
+    rv = knitx_emit_2(knit, prs, KJMPTRUE, L1_address);
+    if (rv != KNIT_OK)
+        return rv;
+    knitx_loop_end(prs, loop);
+    return knit_patch_loc_list_patch_and_destroy(knit, block, &L2_pos, block->insns.len);
 }
 
 static int knitx_stmt_emit(struct knit *knit, struct knit_prs *prs, struct knit_stmt *stmt) {
     int rv = KNIT_OK;
+    struct knit_loop loop;
+    if ((stmt->stmttype == KSTMT_FOR && !stmt->u._for.iterable) || stmt->stmttype == KSTMT_WHILE) {
+        rv = knitx_loop_optimize(knit, prs, stmt, &loop);
+        if (rv != KNIT_OK)
+            return rv;
+    }
     if (stmt->stmttype == KSTMT_EXPR) {
         rv = knitx_emit_expr_eval(knit, prs,  stmt->u._expr, KEVAL_VALUE, KRES_UNKNOWN_DISCARD_RET); 
         if (rv != KNIT_OK)
@@ -4150,12 +6247,32 @@ static int knitx_stmt_emit(struct knit *knit, struct knit_prs *prs, struct knit_
         rv = knitx_emit_assignment(knit, prs, stmt->u._assign.lhs, stmt->u._assign.rhs); 
         if (rv != KNIT_OK)
             return rv;
+        int var_idx = -1;
+        int step = 0;
+        if (prs->loop_sr && knitx_loop_step(stmt, &var_idx, &step)) {
+            rv = knitx_loop_emit_step(knit, prs, var_idx, step);
+            if (rv != KNIT_OK)
+                return rv;
+        }
+    }
+    else if (stmt->stmttype == KSTMT_FOR && stmt->u._for.iterable) {
+        rv = knitx_emit_for_in(knit, prs, stmt);
+        if (rv != KNIT_OK)
+            return rv;
+    }
+    else if (stmt->stmttype == KSTMT_FOR && knitx_for_counting_op1(stmt) >= 0) {
+        rv = knitx_emit_for_counting(knit, prs, stmt, knitx_for_counting_op1(stmt), &loop);
+        if (rv != KNIT_OK)
+            return rv;
     }
     else if (stmt->stmttype == KSTMT_FOR) {
 
         //for stmt
         //emit init first THEN
         rv = knitx_stmt_emit(knit, prs, stmt->u._for.init); 
+        if (rv != KNIT_OK)
+            return rv;
+        rv = knitx_loop_emit_preheader(knit, prs, &loop);
         if (rv != KNIT_OK)
             return rv;
         
@@ -4186,6 +6303,7 @@ static int knitx_stmt_emit(struct knit *knit, struct knit_prs *prs, struct knit_
         rv = knit_patch_loc_list_patch_and_destroy(knit, &prs->curblk->block, &L4_pos, L4_address);  //Patch L4
         if (rv != KNIT_OK)
             return rv; 
+        knitx_loop_end(prs, &loop);
 
         /*
         *
@@ -4223,6 +6341,9 @@ static int knitx_stmt_emit(struct knit *knit, struct knit_prs *prs, struct knit_
             * L2:
             */
 
+        rv = knitx_loop_emit_preheader(knit, prs, &loop);
+        if (rv != KNIT_OK)
+            return rv;
         int L1_address = prs->curblk->block.insns.len; //next instruction's address
         rv = knitx_emit_expr_eval(knit, prs, stmt->u._while.cond, KEVAL_BOOLEAN, 0);  
         if (rv != KNIT_OK)
@@ -4244,6 +6365,7 @@ static int knitx_stmt_emit(struct knit *knit, struct knit_prs *prs, struct knit_
         rv = knit_patch_loc_list_patch_and_destroy(knit, &prs->curblk->block, &L2_pos, L2_address); 
         if (rv != KNIT_OK)
             return rv; //Patch L2
+        knitx_loop_end(prs, &loop);
     }
     else if (stmt->stmttype == KSTMT_RETURN) {
         rv = knitx_emit_expr_eval(knit, prs,  stmt->u._expr, KEVAL_VALUE, 1); 
@@ -4314,6 +6436,11 @@ static int knitx_stmt_emit(struct knit *knit, struct knit_prs *prs, struct knit_
     else {
         knit_assert_h(0, "unknown stmt type");
     }
+    //a while that follows can strength reduce products of the variable
+    int is_int_assign = stmt->stmttype == KSTMT_ASSIGN && stmt->u._assign.lhs->exptype == KAX_VAR_REF &&
+                        stmt->u._assign.rhs->exptype == KAX_LITERAL_INT;
+    prs->int_var_blk = is_int_assign ? prs->curblk : NULL;
+    prs->int_var = is_int_assign ? stmt->u._assign.lhs->u.varref.varname_idx : -1;
     return rv;
 }
 
@@ -4343,7 +6470,7 @@ static int knitx_stmt_prs_new(struct knit *knit, struct knit_prs *prs, int allow
 
 static int knitx_stmt_destroy(struct knit *knit, struct knit_prs *prs, struct knit_stmt *stmt) {
     knitx_stmt_deinit(knit, prs, stmt);
-    knitx_tfree(knit, stmt);
+    knitx_tfree(knit, stmt, sizeof(struct knit_stmt));
     return KNIT_OK;
 }
 
@@ -4380,7 +6507,12 @@ static int knitx_prog(struct knit *knit, struct knit_prs *prs) {
     if (rv != KNIT_OK)
         return rv;
     rv = knitx_emit_ret(knit, prs, 0); 
-    return rv;
+    if (rv != KNIT_OK)
+        return rv;
+    rv = knit_opt_block(knit, &prs->curblk->block);
+    if (rv != KNIT_OK)
+        return rv;
+    return knitx_block_pack(knit, &prs->curblk->block);
 }
 
 #undef K_LA_TOKEN_MATCHES
@@ -4422,6 +6554,12 @@ static int knitx_stack_rpop(struct knit *knit, struct knit_stack *stack, int cou
 }
 
 static int knitx_stack_rpush(struct knit *knit, struct knit_stack *stack, struct knit_obj *obj) {
+    if (stack->vals.len == stack->vals.cap) {
+        int rv = knitx_stack_reserve_values(knit, stack, 1);
+        if (rv != KNIT_OK)
+            return rv;
+        stack->vals.len--;
+    }
     stack->vals.data[stack->vals.len] = obj;
     stack->vals.len++;
     return KNIT_OK;
@@ -4456,12 +6594,10 @@ static inline int knitx_op_do_binop(struct knit *knit, struct knit_obj *a, struc
         struct knit_str *bs = (struct knit_str *) b;
         if (op == KADD) {
             struct knit_str *rs = NULL;
-            int rv = knitx_str_new_copy_gcobj(knit, &rs, as); 
-            if (rv != KNIT_OK)
-                return rv;
-            rv = knitx_str_strlappend(knit, rs, bs->str, bs->len); 
+            int rv = knitx_str_concat_gcobj(knit, &rs, as, bs); 
             if (rv != KNIT_OK)
                 return rv;
+            rs->flags |= KNIT_STR_FROZEN; //strings are immutable from scripts
             *r = ktobj(rs);
         }
         else {
@@ -4563,11 +6699,11 @@ static int knitx_do_global_assign(struct knit *knit, struct knit_str *name, stru
         iter.pair->value = rhs;
     }
     else if (rv == KNIT_VARS_HASHT_NOT_FOUND) {
-        struct knit_str *new_str;
-        rv = knitx_str_new_strcpy_gcobj(knit, &new_str, name->str); 
+        struct knit_str *interned_name = NULL;
+        rv = knitx_str_intern(knit, name, &interned_name); 
         if (rv != KNIT_OK)
             return rv;
-        rv = knit_vars_hasht_insert(&exs->global_ht, name, &rhs);
+        rv = knit_vars_hasht_insert(&exs->global_ht, interned_name, &rhs);
     }
 
     if (rv != KNIT_VARS_HASHT_OK) {
@@ -4588,6 +6724,168 @@ static int knitx_eval_index_expr(struct knit *knit, struct knit_prs *prs, struct
     return KNIT_OK;
 }
 
+//KITER_PREP, the iterable is on top of the stack, slot is the first of the loop's three locals
+static int knitx_iter_prep(struct knit *knit, int slot) {
+    struct knit_stack *stack = &knit->ex.stack;
+    struct knit_obj *iterable = stack->vals.data[stack->vals.len - 1];
+    int type = iterable->u.ktype;
+    if (type != KNIT_LIST && type != KNIT_DICT && type != KNIT_STR && type != KNIT_RANGE && type != KNIT_BITSET && type != KNIT_ARRAY && type != KNIT_DEQUE && type != KNIT_SET)
+        return knit_error(knit, KNIT_INVALID_TYPE_ERR, "trying to iterate over a type other than lists/dicts/strings/ranges/bitsets/arrays/deques/sets");
+    int rv = KNIT_OK;
+    if (type == KNIT_STR) {
+        rv = knitx_str_flatten(knit, (struct knit_str *) iterable);
+        if (rv != KNIT_OK)
+            return rv;
+    }
+    //the position is only reachable from the loop's local, so it is safe to update it in place
+    struct knit_int *pos = NULL;
+    rv = knitx_int_new_gcobj(knit, &pos, 0);
+    if (rv != KNIT_OK)
+        return rv;
+    stack->vals.data[slot] = iterable;
+    stack->vals.data[slot + 1] = ktobj(pos);
+    if (type == KNIT_DICT) {
+        //the position counts the array part then the entries, both change when a rehash grows the array part
+        struct knit_int *array_cap = NULL;
+        rv = knitx_int_new_gcobj(knit, &array_cap, ((struct knit_dict *) iterable)->array_cap);
+        if (rv != KNIT_OK)
+            return rv;
+        stack->vals.data[slot + 2] = ktobj(array_cap);
+    }
+    return knitx_stack_rpop(knit, stack, 1);
+}
+
+//KITER_NEXT, lists and deques (front to back) yield their items, dicts their keys (the array part then the rest in insertion order, the
+//order they print in), strings one byte strings, ranges and arrays their ints, bitsets the indices of their set bits and sets
+//their elements (in the order they print in).
+//only ints that weren't boxed yet allocate
+//the length is checked on every step, items added to a list while iterating it are visited.
+//adding keys to a dict while iterating it is an error if it moves int keys to the array part
+static int knitx_iter_next(struct knit *knit, int slot) {
+    struct knit_stack *stack = &knit->ex.stack;
+    struct knit_obj *iterable = stack->vals.data[slot];
+    struct knit_int *pos = (struct knit_int *) stack->vals.data[slot + 1];
+    struct knit_obj *item = NULL;
+    int rv = KNIT_OK;
+    if (iterable->u.ktype == KNIT_LIST) {
+        struct knit_list *list = (struct knit_list *) iterable;
+        if (pos->value < list->len)
+            rv = knitx_list_get(knit, list, pos->value++, &item);
+    }
+    else if (iterable->u.ktype == KNIT_DICT) {
+        struct knit_dict *dict = (struct knit_dict *) iterable;
+        if (dict->array_cap != ((struct knit_int *) stack->vals.data[slot + 2])->value)
+            return knit_error(knit, KNIT_RUNTIME_ERR, "a dict was rehashed while iterating over it, the int keys added to it moved its other keys");
+        while (pos->value < dict->array_cap && !dict->array[pos->value])
+            pos->value++;
+        if (pos->value < dict->array_cap) {
+            struct knit_int *key = NULL;
+            rv = knitx_int_new_gcobj(knit, &key, pos->value++);
+            item = ktobj(key);
+        }
+        else if (pos->value - dict->array_cap < dict->len) {
+            item = dict->entries[pos->value++ - dict->array_cap].key;
+        }
+    }
+    else if (iterable->u.ktype == KNIT_RANGE) {
+        struct knit_range *range = (struct knit_range *) iterable;
+        if (pos->value < knitx_range_len(range)) {
+            struct knit_int *value = NULL;
+            rv = knitx_int_new_gcobj(knit, &value, range->begin + pos->value++ * range->step);
+            item = ktobj(value);
+        }
+    }
+    else if (iterable->u.ktype == KNIT_DEQUE) {
+        struct knit_deque *dq = &iterable->u.deque;
+        if (pos->value < dq->len)
+            item = knit_deque_at(dq, pos->value++);
+    }
+    else if (iterable->u.ktype == KNIT_SET) {
+        int v = 0;
+        if (knit_set_next(&iterable->u.set, &pos->value, &item, &v) && !item) {
+            struct knit_int *value = NULL;
+            rv = knitx_int_new_gcobj(knit, &value, v);
+            item = ktobj(value);
+        }
+    }
+    else if (iterable->u.ktype == KNIT_ARRAY) {
+        struct knit_array *arr = &iterable->u.array;
+        if (pos->value < arr->len) {
+            int64_t elem = knit_array_get(arr, pos->value++);
+            if (elem < INT_MIN || elem > INT_MAX)
+                return knit_error(knit, KNIT_OUT_OF_RANGE_ERR, "array element %lld doesn't fit in an int", (long long) elem);
+            struct knit_int *value = NULL;
+            rv = knitx_int_new_gcobj(knit, &value, (int) elem);
+            item = ktobj(value);
+        }
+    }
+    else if (iterable->u.ktype == KNIT_BITSET) {
+        long found = bitset_find_true_bit(&iterable->u.bitset.bits, pos->value);
+        if (found >= 0) {
+            pos->value = (int) found + 1;
+            struct knit_int *value = NULL;
+            rv = knitx_int_new_gcobj(knit, &value, (int) found);
+            item = ktobj(value);
+        }
+    }
+    else if (iterable->u.ktype == KNIT_STR) {
+        struct knit_str *str = (struct knit_str *) iterable;
+        if (pos->value < str->len) {
+            unsigned char c = str->str[pos->value++];
+            struct knit_str **byte_str = &knit->ex.byte_strs[c];
+            if (!*byte_str)
+                rv = knitx_str_intern_strl(knit, (const char *) &c, 1, byte_str);
+            item = ktobj(*byte_str);
+        }
+    }
+    if (rv != KNIT_OK)
+        return rv;
+    knit->ex.last_cond = item != NULL;
+    if (!item) {
+        //the loop is done, it doesn't keep the iterable alive anymore
+        stack->vals.data[slot] = (struct knit_obj *) &knull;
+        stack->vals.data[slot + 1] = (struct knit_obj *) &knull;
+        stack->vals.data[slot + 2] = (struct knit_obj *) &knull;
+        return KNIT_OK;
+    }
+    return knitx_stack_rpush(knit, stack, item);
+}
+
+//KFORPREP (is_loop == 0) and KFORLOOP, the stack holds the loop variable and the limit
+//ints take the fast path, anything else fails the same way KADD/KSUB and the KTEST ops would
+static int knitx_for_step(struct knit *knit, int op1, int is_loop) {
+    struct knit_stack *stack = &knit->ex.stack;
+    int t = stack->vals.len;
+    struct knit_obj *var = stack->vals.data[t - 2];
+    struct knit_obj *limit = stack->vals.data[t - 1];
+    int rv = KNIT_OK;
+    if (is_loop) {
+        int op = KNIT_FOR_SUB(op1) ? KSUB : KADD;
+        struct knit_int *next = NULL;
+        if (var->u.ktype == KNIT_INT) {
+            int step = KNIT_FOR_STEP(op1);
+            rv = knitx_int_new_gcobj(knit, &next, op == KSUB ? var->u.integer.value - step : var->u.integer.value + step);
+            if (rv != KNIT_OK)
+                return rv;
+            var = ktobj(next);
+        }
+        else {
+            struct knit_obj *r = NULL;
+            rv = knitx_int_new_gcobj(knit, &next, KNIT_FOR_STEP(op1));
+            if (rv == KNIT_OK)
+                rv = knitx_op_do_binop(knit, var, ktobj(next), &r, op);
+            if (rv != KNIT_OK)
+                return rv;
+            var = r;
+        }
+        stack->vals.data[t - 2] = var;
+    }
+    rv = knitx_op_do_test_binop(knit, var, limit, knit_for_cmp_ops[KNIT_FOR_CMP(op1)]);
+    if (rv != KNIT_OK)
+        return rv;
+    return knitx_stack_rpop(knit, stack, is_loop ? 1 : 2);
+}
+
 //useless function used as a debugging breakpoint
 static inline void kstepi() { return; }
 
@@ -4597,13 +6895,19 @@ static int knitx_exec(struct knit *knit) {
     struct knit_objp_darray *stack_vals = &knit->ex.stack.vals;
 
     knit_assert_h(frames->len > 0, "");
+    //C functions can call knit functions (knitx_call1()), execution returns to them when the frame it started with returns
+    int frames_base = frames->len - 1;
     struct knit_frame *top_frm = &frames->data[frames->len-1];
     struct knit_block *block = top_frm->u.kf.block;
     knit_assert_h(top_frm->bsp >= 0 && top_frm->bsp <= stack_vals->len, "");
+    struct knit_objp_darray *nursery = &knit->ex.heap.nursery;
+    int nursery_base = nursery->len;
 
     int rv = KNIT_OK;
     while (1) {
         knit_assert_s(top_frm->u.kf.ip < block->insns.len, "executing out of range instruction");
+        //everything the previous instruction allocated is on the stack or reachable from it by now
+        nursery->len = nursery_base;
         struct knit_insn *insn = &block->insns.data[top_frm->u.kf.ip];
         int t = stack_vals->len; //values stack size, top of stack is stack_vals->data[t-1]
         int op = insn->insn_type;
@@ -4666,6 +6970,8 @@ static int knitx_exec(struct knit *knit) {
             struct knit_obj *rhs = stack_vals->data[stack_vals->len - 1];
             //tmp global assumption
             rv = knitx_do_global_assign(knit, knit_as_str(lhs), rhs);
+            if (rv != KNIT_OK)
+                return rv;
             rv = knitx_stack_rpop(knit, stack, 2);
         }
         else if (op == KCALL) {
@@ -4681,8 +6987,12 @@ static int knitx_exec(struct knit *knit) {
             //what happens at a call is, the returned values become at the top of the stack, the function and the passed arguments are popped
             if (func->u.ktype == KNIT_CFUNC) {
                 rv = knitx_stack_push_frame_for_ccall(knit, (struct knit_cfunc *)func, nargs, nexpected_returns);
+                if (rv != KNIT_OK)
+                    return rv;
                 knit->ex.nresults = -1;
                 rv = func->u.cfunc.fptr(knit);
+                if (rv != KNIT_OK)
+                    return rv;
                 if (knit->ex.nresults == -1) {
                     return knit_error(knit, KNIT_RUNTIME_ERR, "called C-function didn't declare returned values using knitx_creturns()");
                 }
@@ -4743,30 +7053,93 @@ static int knitx_exec(struct knit *knit) {
                 if (idx->value < 0 || idx->value >= list->len) {
                     return knit_error(knit, KNIT_OUT_OF_RANGE_ERR, "index is out of range");
                 }
+                //unboxed ints are boxed while the list is still rooted by the stack
+                rv = knitx_list_get(knit, list, idx->value, &value);
+                if (rv != KNIT_OK)
+                    return rv;
                 rv = knitx_stack_rpop(knit, stack, 2); 
                 if (rv != KNIT_OK)
                     return rv;
-                rv = knitx_stack_rpush(knit, stack, list->items[idx->value]); 
+                rv = knitx_stack_rpush(knit, stack, value); 
                 if (rv != KNIT_OK)
                     return rv;
             }
             else if (indexed->u.ktype == KNIT_DICT) {
                 struct knit_dict *dict = (struct knit_dict*) indexed;
                 struct knit_obj *value = NULL;
+                //looking up a string key can flatten it, it stays on the stack until then
+                rv = knitx_dict_lookup(knit, dict, index, &value); 
+                if (rv != KNIT_OK)
+                    return rv;
                 rv = knitx_stack_rpop(knit, stack, 2); 
                 if (rv != KNIT_OK)
                     return rv;
-                rv = knitx_dict_lookup(knit, dict, index, &value); 
+                rv = knitx_stack_rpush(knit, stack, value); 
+                if (rv != KNIT_OK)
+                    return rv;
+            }
+            else if (indexed->u.ktype == KNIT_BITSET) {
+                if (index->u.ktype != KNIT_INT) {
+                    return knit_error(knit, KNIT_INVALID_TYPE_ERR, "trying to index using a type other than an int");
+                }
+                struct knit_bitset *bits = &indexed->u.bitset.bits;
+                int idx = index->u.integer.value;
+                if (idx < 0 || (size_t) idx >= bits->bit_len) {
+                    return knit_error(knit, KNIT_OUT_OF_RANGE_ERR, "index is out of range");
+                }
+                value = (struct knit_obj *) (bitset_get_bit(bits, idx) ? &ktrue : &kfalse);
+                rv = knitx_stack_rpop(knit, stack, 2); 
                 if (rv != KNIT_OK)
                     return rv;
                 rv = knitx_stack_rpush(knit, stack, value); 
                 if (rv != KNIT_OK)
                     return rv;
             }
+            else if (indexed->u.ktype == KNIT_ARRAY) {
+                if (index->u.ktype != KNIT_INT) {
+                    return knit_error(knit, KNIT_INVALID_TYPE_ERR, "trying to index using a type other than an int");
+                }
+                struct knit_array *arr = &indexed->u.array;
+                int idx = index->u.integer.value;
+                if (idx < 0 || idx >= arr->len) {
+                    return knit_error(knit, KNIT_OUT_OF_RANGE_ERR, "index is out of range");
+                }
+                int64_t elem = knit_array_get(arr, idx);
+                if (elem < INT_MIN || elem > INT_MAX) {
+                    return knit_error(knit, KNIT_OUT_OF_RANGE_ERR, "array element %lld doesn't fit in an int", (long long) elem);
+                }
+                struct knit_int *boxed = NULL;
+                rv = knitx_int_new_gcobj(knit, &boxed, (int) elem);
+                if (rv != KNIT_OK)
+                    return rv;
+                rv = knitx_stack_rpop(knit, stack, 2); 
+                if (rv != KNIT_OK)
+                    return rv;
+                rv = knitx_stack_rpush(knit, stack, ktobj(boxed)); 
+                if (rv != KNIT_OK)
+                    return rv;
+            }
             else {
-                return knit_error(knit, KNIT_INVALID_TYPE_ERR, "trying to index a type other than lists/dicts");
+                return knit_error(knit, KNIT_INVALID_TYPE_ERR, "trying to index a type other than lists/dicts/bitsets/arrays");
             }
         }
+        else if (op == KSLICE) {
+            knit_assert_h(knitx_stack_ntemp(knit, &knit->ex.stack) >= 3, "insufficent objects on the stack to do slicing");
+            struct knit_obj *sliced = stack_vals->data[stack_vals->len - 3];
+            struct knit_obj *beg = stack_vals->data[stack_vals->len - 2];
+            struct knit_obj *end = stack_vals->data[stack_vals->len - 1];
+            struct knit_obj *result = NULL;
+            //the operands stay on the stack until the result is created so they're rooted
+            rv = knitx_obj_slice(knit, sliced, beg, end, &result); 
+            if (rv != KNIT_OK)
+                return rv;
+            rv = knitx_stack_rpop(knit, stack, 3); 
+            if (rv != KNIT_OK)
+                return rv;
+            rv = knitx_stack_rpush(knit, stack, result); 
+            if (rv != KNIT_OK)
+                return rv;
+        }
         else if (op == KINDX_SET) {
             knit_assert_h(knitx_stack_ntemp(knit, &knit->ex.stack) >= 3, "insufficent objects on the stack to do array assignment");
             struct knit_obj *indexed = stack_vals->data[stack_vals->len - 3];
@@ -4781,7 +7154,9 @@ static int knitx_exec(struct knit *knit) {
                 if (idx->value < 0 || idx->value >= list->len) {
                     return knit_error(knit, KNIT_OUT_OF_RANGE_ERR, "index is out of range");
                 }
-                list->items[idx->value] = value;
+                rv = knitx_list_set(knit, list, idx->value, value);
+                if (rv != KNIT_OK)
+                    return rv;
                 rv = knitx_stack_rpop(knit, stack, 3); 
                 if (rv != KNIT_OK)
                     return rv;
@@ -4795,6 +7170,43 @@ static int knitx_exec(struct knit *knit) {
                 if (rv != KNIT_OK)
                     return rv;
             }
+            else if (indexed->u.ktype == KNIT_BITSET) {
+                if (index->u.ktype != KNIT_INT) {
+                    return knit_error(knit, KNIT_INVALID_TYPE_ERR, "trying to index using a type other than an int");
+                }
+                if (value->u.ktype != KNIT_TRUE && value->u.ktype != KNIT_FALSE) {
+                    return knit_error(knit, KNIT_INVALID_TYPE_ERR, "bitsets can only store true or false");
+                }
+                struct knit_bitset *bits = &indexed->u.bitset.bits;
+                int idx = index->u.integer.value;
+                if (idx < 0 || (size_t) idx >= bits->bit_len) {
+                    return knit_error(knit, KNIT_OUT_OF_RANGE_ERR, "index is out of range");
+                }
+                bitset_set_bit(bits, idx, value->u.ktype == KNIT_TRUE);
+                rv = knitx_stack_rpop(knit, stack, 3); 
+                if (rv != KNIT_OK)
+                    return rv;
+            }
+            else if (indexed->u.ktype == KNIT_ARRAY) {
+                if (index->u.ktype != KNIT_INT) {
+                    return knit_error(knit, KNIT_INVALID_TYPE_ERR, "trying to index using a type other than an int");
+                }
+                if (value->u.ktype != KNIT_INT) {
+                    return knit_error(knit, KNIT_INVALID_TYPE_ERR, "arrays can only store ints");
+                }
+                struct knit_array *arr = &indexed->u.array;
+                int idx = index->u.integer.value;
+                if (idx < 0 || idx >= arr->len) {
+                    return knit_error(knit, KNIT_OUT_OF_RANGE_ERR, "index is out of range");
+                }
+                if (!knit_array_fits(arr->elem_type, value->u.integer.value)) {
+                    return knit_error(knit, KNIT_OUT_OF_RANGE_ERR, "%d doesn't fit in an %s", value->u.integer.value, knit_array_types[arr->elem_type].name);
+                }
+                knit_array_set(arr, idx, value->u.integer.value);
+                rv = knitx_stack_rpop(knit, stack, 3); 
+                if (rv != KNIT_OK)
+                    return rv;
+            }
             else {
                 return knit_error(knit, KNIT_INVALID_TYPE_ERR, "trying to index a type other than a list");
             }
@@ -4874,7 +7286,7 @@ static int knitx_exec(struct knit *knit) {
             rv = knitx_stack_pop_frame(knit, stack); 
 if (rv != KNIT_OK)
     return rv;
-            if (frames->len == 0) {
+            if (frames->len == frames_base) {
                 goto done; //end of execution
             }
             top_frm = &frames->data[frames->len-1];
@@ -4942,6 +7354,15 @@ if (rv != KNIT_OK)
         else if (op == KNOP) {
             //no operation
         }
+        else if (op == KITER_PREP) {
+            rv = knitx_iter_prep(knit, top_frm->bsp + insn->op1);
+        }
+        else if (op == KITER_NEXT) {
+            rv = knitx_iter_next(knit, top_frm->bsp + insn->op1);
+        }
+        else if (op == KFORPREP || op == KFORLOOP) {
+            rv = knitx_for_step(knit, insn->op1, op == KFORLOOP);
+        }
         else if (op == KADD || op == KSUB || op == KMUL || op == KDIV || op == KMOD) {
             rv = knitx_op_exec_binop(knit, stack, op);
         }
@@ -4971,6 +7392,53 @@ static int knitx_block_exec(struct knit *knit, struct knit_block *block, int nar
     return KNIT_OK;
 }
 
+//calls func(arg) from a C function, the single value it returns is stored in result_out.
+//the result is popped from the stack and pushed on the nursery, which roots it until the caller's instruction ends
+static int knitx_call1(struct knit *knit, struct knit_obj *func, struct knit_obj *arg, struct knit_obj **result_out) {
+    struct knit_stack *stack = &knit->ex.stack;
+    int base = stack->vals.len;
+    int rv = knitx_stack_rpush(knit, stack, arg);
+    if (rv != KNIT_OK)
+        return rv;
+    rv = knitx_stack_rpush(knit, stack, func);
+    if (rv != KNIT_OK)
+        return rv;
+    if (func->u.ktype == KNIT_KFUNC) {
+        rv = knitx_stack_push_frame_for_kcall(knit, &func->u.kfunc.block, 1, 1);
+        if (rv != KNIT_OK)
+            return rv;
+        rv = knitx_exec(knit);
+        if (rv != KNIT_OK)
+            return rv;
+    }
+    else if (func->u.ktype == KNIT_CFUNC) {
+        rv = knitx_stack_push_frame_for_ccall(knit, &func->u.cfunc, 1, 1);
+        if (rv != KNIT_OK)
+            return rv;
+        knit->ex.nresults = -1;
+        rv = func->u.cfunc.fptr(knit);
+        if (rv != KNIT_OK)
+            return rv;
+        if (knit->ex.nresults != 1)
+            return knit_error(knit, KNIT_RUNTIME_ERR, "a called C-function returned %d values, expected 1", knit->ex.nresults);
+        rv = knitx_stack_moveup(knit, stack, base, 1);
+        if (rv != KNIT_OK)
+            return rv;
+        rv = knitx_stack_pop_frame(knit, stack);
+        if (rv != KNIT_OK)
+            return rv;
+    }
+    else {
+        return knit_error(knit, KNIT_RUNTIME_ERR, "tried to call a non-callable type");
+    }
+    knit_assert_h(stack->vals.len == base + 1, "");
+    struct knit_obj *result = stack->vals.data[base];
+    if (knit_objp_darray_push(&knit->ex.heap.nursery, &result) != KNIT_OBJP_DARRAY_OK)
+        return knit_error(knit, KNIT_NOMEM, "knitx_call1(): couldn't root the result");
+    *result_out = result;
+    return knitx_stack_rpop(knit, stack, 1);
+}
+
 static int knitx_exec_str(struct knit *knit, const char *program) {
     struct knit_prs prs;
     int rv = KNIT_OK;
@@ -4985,9 +7453,16 @@ static int knitx_exec_str(struct knit *knit, const char *program) {
     }
 #endif 
 
+    knit_clear_error(knit);
+    //the parser can't collect, so it shouldn't start on a heap filled with the garbage of the last program
+    knitx_mem_collect(knit);
     knitx_prs_init1(knit, &prs);
     knitx_lexer_init_str(knit, &prs.lex, program);
-    knitx_prog(knit, &prs);
+    knit->mem_gc_blocked++;
+    rv = knitx_prog(knit, &prs);
+    knit->mem_gc_blocked--;
+    if (rv != KNIT_OK)
+        goto cleanup;
 
 #ifdef KNIT_DEBUG_PRINT
     if (KNIT_DBG_PRINT) {
@@ -4995,7 +7470,15 @@ static int knitx_exec_str(struct knit *knit, const char *program) {
     }
 #endif
 
-    knitx_block_exec(knit, &prs.curblk->block, 0, 0);
+    rv = knitx_block_exec(knit, &prs.curblk->block, 0, 0);
+    if (rv != KNIT_OK) {
+        //unwind whatever the failed program left on the stack, the state stays usable
+        struct knit_stack *stack = &knit->ex.stack;
+        while (stack->frames.len > 0)
+            knitx_stack_pop_frame(knit, stack);
+        stack->vals.len = 0;
+    }
+    knit->ex.heap.nursery.len = 0;
 
 #ifdef KNIT_DEBUG_PRINT
     if (KNIT_DBG_PRINT) {
@@ -5003,10 +7486,10 @@ static int knitx_exec_str(struct knit *knit, const char *program) {
     }
 #endif
 
+cleanup:
     knitx_lexer_deinit(knit, &prs.lex);
     knitx_prs_deinit(knit, &prs);
-
-    return KNIT_OK; //dummy
+    return rv;
 }
 
 //how many chars to skip an escape seq
@@ -5061,13 +7544,22 @@ static int knitx_init(struct knit *knit, int opts) {
         knit_set_error_policy(knit, KNIT_POLICY_CONTINUE);
     else 
         knit_set_error_policy(knit, KNIT_POLICY_EXIT);
-#ifdef KNIT_MEM_STATS
+#ifdef KNIT_MEM_PROFILE
     knit_mem_stats_init(&knit->mstats);
 #endif
     knit->ex.nresults = 0;
     knit->err_msg = NULL;
+    knit->is_err_msg_owned = 0;
     knit->err = KNIT_OK;
-    return knitx_exec_state_init(knit, &knit->ex);
+    knit->mem_limit = 0;
+    knit->mem_used = 0;
+    knit->mem_gc_blocked = 1; //the state isn't walkable until it's initialized
+    int rv = knitx_exec_state_init(knit, &knit->ex);
+    knit->mem_gc_blocked = 0;
+#ifdef KNIT_MEM_PROFILE
+    knit->mstats.have_stack = rv == KNIT_OK;
+#endif
+    return rv;
 }
 
 static void knit_obj_deinit(struct knit *knit, struct knit_obj *obj) {
@@ -5081,12 +7573,82 @@ static void knit_obj_deinit(struct knit *knit, struct knit_obj *obj) {
         case KNIT_KFUNC: knit_kfunc_deinit(knit, (struct knit_kfunc *)obj); break;
         case KNIT_TRUE: break;
         case KNIT_FALSE: break;
+        case KNIT_STRBUILDER: knitx_strbuilder_deinit(knit, (struct knit_strbuilder *) obj); break;
+        case KNIT_RANGE: break;
+        case KNIT_BITSET: knitx_bitset_deinit(knit, (struct knit_bitset_obj *) obj); break;
+        case KNIT_ARRAY: knitx_array_deinit(knit, (struct knit_array *) obj); break;
+        case KNIT_DEQUE: knit_deque_deinit(knit, (struct knit_deque *) obj); break;
+        case KNIT_PQUEUE: knit_pqueue_deinit(knit, (struct knit_pqueue *) obj); break;
+        case KNIT_SET: knit_set_deinit(knit, (struct knit_set *) obj); break;
         default: knit_assert_h(0, "invalid type");
     }
 }
 
 static int knitx_deinit(struct knit *knit) {
+#ifdef KNIT_MEM_PROFILE
+    knit->mstats.have_stack = 0;
+#endif
+    knit->mem_limit = 0;
+    knit->mem_gc_blocked = 1;
+    knit_clear_error(knit);
+    int rv = knitx_exec_state_deinit(knit, &knit->ex);
+#ifdef KNIT_MEM_PROFILE
+    knit_mem_stats_deinit(&knit->mstats);
+#endif
+    return rv;
+}
+
+//C-API
+//limits the bytes the state may allocate, 0 removes the limit. allocations that would cross it trigger
+//a gc cycle and fail with KNIT_NOMEM if it doesn't free enough, knitx_exec_str() then returns the error
+static void knitx_set_mem_limit(struct knit *knit, size_t limit) {
+    knit->mem_limit = limit;
+}
+static size_t knitx_get_mem_limit(struct knit *knit) {
+    return knit->mem_limit;
+}
+//bytes currently allocated by the state, including the gc heap and the stacks
+static size_t knitx_get_mem_usage(struct knit *knit) {
+    return knit->mem_used;
+}
+
+//the buffer of the array stored in the global varname, it is shared with scripts (not copied), writes from either
+//side are seen by the other. it stays valid as long as the array is reachable from the scripts
+static int knitx_get_array(struct knit *knit, const char *varname, int *elem_type, void **data, int *len) {
+    struct knit_obj *objp;
+    int rv = knitx_getvar_(knit, varname, &objp);
+    if (rv != KNIT_OK)
+        return rv;
+    if (objp->u.ktype != KNIT_ARRAY)
+        return knit_error(knit, KNIT_INVALID_TYPE_ERR, "knitx_get_array(): variable '%s' isn't an array", varname);
+    *elem_type = objp->u.array.elem_type;
+    *data = objp->u.array.data;
+    *len = objp->u.array.len;
+    return KNIT_OK;
+}
+//stores in the global varname an array of len elements (enum KNIT_ARRAY_TYPE) over the host's buffer data,
+//knit neither copies nor frees it so it must outlive the state or the array
+static int knitx_set_array(struct knit *knit, const char *varname, int elem_type, void *data, int len) {
+    knit_assert_h(elem_type >= KNIT_ARRAY_INT32 && elem_type <= KNIT_ARRAY_UINT8 && len >= 0 && (data || !len), "");
+    struct knit_array *arr = NULL;
+    int rv = knitx_array_new_gcobj(knit, &arr, elem_type, len, data);
+    if (rv != KNIT_OK)
+        return rv;
+    struct knit_str name;
+    rv = knitx_str_init_const_str(knit, &name, varname);
+    if (rv != KNIT_OK)
+        return rv;
+    return knitx_do_global_assign(knit, &name, ktobj(arr));
+}
+
+//writes the sampled allocation profile as collapsed stacks, fails when built without KNIT_MEM_PROFILE
+static int knitx_mem_profile_dump(struct knit *knit, FILE *f) {
+#ifdef KNIT_MEM_PROFILE
+    knit_mem_prof_dump(knit, &knit->mstats, f);
     return KNIT_OK;
+#else
+    return KNIT_RUNTIME_ERR;
+#endif
 }
 
 #include "kruntime.h" //runtime functions
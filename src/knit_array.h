@@ -0,0 +1,204 @@
+#ifndef KNIT_ARRAY_H
+#define KNIT_ARRAY_H
+#include <stdint.h>
+#include <string.h>
+
+#include "kdata.h"
+#include "knit_util.h"
+#include "knit_bitset_data.h"
+
+/*
+Kernels behind array(type, n), numbers of one type stored contiguously in a single buffer.
+
+Each kernel is a plain loop over one element type written so the compiler vectorizes it (no early exits, restrict
+pointers, wrapping arithmetic done on the unsigned type). With gcc on x86-64 every kernel is compiled twice, for
+the SSE2 baseline and for AVX2, and the dynamic loader picks one when the program starts from what the cpu supports
+(target_clones, an ifunc resolver). The kernels are optimized that way even in unoptimized builds.
+
+Results are computed on 64 bits (sums, products) and are an error when they don't fit, elementwise arithmetic wraps
+around like C's fixed width types.
+*/
+
+#if defined(__GNUC__) && !defined(__clang__) && defined(__x86_64__) && defined(__linux__)
+    #define KNIT_ARRAY_KERNEL __attribute__((target_clones("avx2", "default"), optimize("O3")))
+#elif defined(__GNUC__) && !defined(__clang__)
+    #define KNIT_ARRAY_KERNEL __attribute__((optimize("O3")))
+#else
+    #define KNIT_ARRAY_KERNEL
+#endif
+
+enum KNIT_ARRAY_CMP {
+    KNIT_ARRAY_LT,
+    KNIT_ARRAY_GT,
+    KNIT_ARRAY_EQ,
+};
+
+static const struct {
+    const char *name;
+    int elem_size;
+} knit_array_types[] = {
+    [KNIT_ARRAY_INT32] = {"int32", 4},
+    [KNIT_ARRAY_INT64] = {"int64", 8},
+    [KNIT_ARRAY_UINT8] = {"uint8", 1},
+};
+
+//-1 if name isn't an element type
+static int knit_array_type_from_name(const char *name, int len) {
+    for (int i=0; i<(int) (sizeof knit_array_types / sizeof knit_array_types[0]); i++) {
+        if ((int) strlen(knit_array_types[i].name) == len && memcmp(knit_array_types[i].name, name, len) == 0)
+            return i;
+    }
+    return -1;
+}
+
+//*r = a + b, returns 1 if the result doesn't fit (*r is then unspecified)
+static inline int knit_array_add_overflows(int64_t a, int64_t b, int64_t *r) {
+#ifdef __GNUC__
+    return __builtin_add_overflow(a, b, r);
+#else
+    if ((b > 0 && a > INT64_MAX - b) || (b < 0 && a < INT64_MIN - b))
+        return 1;
+    *r = a + b;
+    return 0;
+#endif
+}
+//*r = a * b, returns 1 if the result doesn't fit (*r is then unspecified)
+static inline int knit_array_mul_overflows(int64_t a, int64_t b, int64_t *r) {
+#ifdef __GNUC__
+    return __builtin_mul_overflow(a, b, r);
+#else
+    if (a > 0 ? (b > 0 ? a > INT64_MAX / b : b < INT64_MIN / a)
+              : (b > 0 ? a < INT64_MIN / b : a != 0 && b < INT64_MAX / a))
+        return 1;
+    *r = a * b;
+    return 0;
+#endif
+}
+
+/*
+sum and dot store their result in *out and return 0 if it doesn't fit in 64 bits. The checks only run where an
+overflow is possible: n < 2^31, so sums of 32 bit elements and dot products of 8 bit elements always fit and keep
+the plain vectorized loop.
+*/
+#define KNIT_ARRAY_DEFINE_KERNELS(T, UT, tname) \
+    KNIT_ARRAY_KERNEL static int knit_array_sum_##tname(const T *restrict a, int n, int64_t *out) { \
+        int64_t s = 0; \
+        int overflow = 0; \
+        if (sizeof(T) < 8) { \
+            for (int i=0; i<n; i++) \
+                s += (int64_t) a[i]; \
+        } \
+        else { \
+            for (int i=0; i<n; i++) \
+                overflow |= knit_array_add_overflows(s, (int64_t) a[i], &s); \
+        } \
+        *out = s; \
+        return !overflow; \
+    } \
+    /* n must be > 0 */ \
+    KNIT_ARRAY_KERNEL static int64_t knit_array_min_##tname(const T *restrict a, int n) { \
+        T m = a[0]; \
+        for (int i=1; i<n; i++) \
+            m = a[i] < m ? a[i] : m; \
+        return m; \
+    } \
+    KNIT_ARRAY_KERNEL static int64_t knit_array_max_##tname(const T *restrict a, int n) { \
+        T m = a[0]; \
+        for (int i=1; i<n; i++) \
+            m = a[i] > m ? a[i] : m; \
+        return m; \
+    } \
+    /* b is an array of the same type */ \
+    KNIT_ARRAY_KERNEL static int knit_array_dot_##tname(const T *restrict a, int n, const void *bv, int64_t *out) { \
+        const T *restrict b = bv; \
+        int64_t s = 0; \
+        int overflow = 0; \
+        if (sizeof(T) < 4) { \
+            for (int i=0; i<n; i++) \
+                s += (int64_t) a[i] * (int64_t) b[i]; \
+        } \
+        else { \
+            for (int i=0; i<n; i++) { \
+                int64_t p = 0; \
+                overflow |= knit_array_mul_overflows((int64_t) a[i], (int64_t) b[i], &p); \
+                overflow |= knit_array_add_overflows(s, p, &s); \
+            } \
+        } \
+        *out = s; \
+        return !overflow; \
+    } \
+    KNIT_ARRAY_KERNEL static void knit_array_scale_##tname(T *restrict a, int n, int64_t k) { \
+        UT uk = (UT) k; \
+        for (int i=0; i<n; i++) \
+            a[i] = (T) ((UT) a[i] * uk); \
+    } \
+    /* b is an array of the same type, it may be a itself */ \
+    KNIT_ARRAY_KERNEL static void knit_array_add_##tname(T *a, int n, const void *bv) { \
+        const T *b = bv; \
+        for (int i=0; i<n; i++) \
+            a[i] = (T) ((UT) a[i] + (UT) b[i]); \
+    } \
+    /* bit i of out is set if a[i] cmp k, out must have room for n bits */ \
+    KNIT_ARRAY_KERNEL static void knit_array_mask_##tname(const T *restrict a, int n, int cmp, int64_t k, knit_bitset_word *restrict out) { \
+        for (int w=0; w * 64 < n; w++) { \
+            const T *chunk = a + w * 64; \
+            int end = n - w * 64 < 64 ? n - w * 64 : 64; \
+            knit_bitset_word bits = 0; \
+            if (cmp == KNIT_ARRAY_LT) { \
+                for (int j=0; j<end; j++) \
+                    bits |= (knit_bitset_word) ((int64_t) chunk[j] < k) << j; \
+            } \
+            else if (cmp == KNIT_ARRAY_GT) { \
+                for (int j=0; j<end; j++) \
+                    bits |= (knit_bitset_word) ((int64_t) chunk[j] > k) << j; \
+            } \
+            else { \
+                for (int j=0; j<end; j++) \
+                    bits |= (knit_bitset_word) ((int64_t) chunk[j] == k) << j; \
+            } \
+            out[w] = bits; \
+        } \
+    }
+
+KNIT_ARRAY_DEFINE_KERNELS(int32_t, uint32_t, int32)
+KNIT_ARRAY_DEFINE_KERNELS(int64_t, uint64_t, int64)
+KNIT_ARRAY_DEFINE_KERNELS(uint8_t, uint8_t, uint8)
+
+//calls the kernel for the element type of arr, extra arguments are passed after the buffer
+#define KNIT_ARRAY_DISPATCH(result, kernel, arr, ...) do { \
+    switch ((arr)->elem_type) { \
+        case KNIT_ARRAY_INT32: result kernel##_int32((int32_t *) (arr)->data, __VA_ARGS__); break; \
+        case KNIT_ARRAY_INT64: result kernel##_int64((int64_t *) (arr)->data, __VA_ARGS__); break; \
+        case KNIT_ARRAY_UINT8: result kernel##_uint8((uint8_t *) (arr)->data, __VA_ARGS__); break; \
+        default: knit_assert_h(0, "invalid array type"); \
+    } \
+} while (0)
+
+static int64_t knit_array_get(const struct knit_array *arr, int i) {
+    switch (arr->elem_type) {
+        case KNIT_ARRAY_INT32: return ((const int32_t *) arr->data)[i];
+        case KNIT_ARRAY_INT64: return ((const int64_t *) arr->data)[i];
+        case KNIT_ARRAY_UINT8: return ((const uint8_t *) arr->data)[i];
+    }
+    knit_assert_h(0, "invalid array type");
+    return 0;
+}
+//v must be representable by the element type (knit_array_fits())
+static void knit_array_set(struct knit_array *arr, int i, int64_t v) {
+    switch (arr->elem_type) {
+        case KNIT_ARRAY_INT32: ((int32_t *) arr->data)[i] = (int32_t) v; break;
+        case KNIT_ARRAY_INT64: ((int64_t *) arr->data)[i] = v; break;
+        case KNIT_ARRAY_UINT8: ((uint8_t *) arr->data)[i] = (uint8_t) v; break;
+        default: knit_assert_h(0, "invalid array type");
+    }
+}
+static int knit_array_fits(int elem_type, int64_t v) {
+    switch (elem_type) {
+        case KNIT_ARRAY_INT32: return v >= INT32_MIN && v <= INT32_MAX;
+        case KNIT_ARRAY_INT64: return 1;
+        case KNIT_ARRAY_UINT8: return v >= 0 && v <= UINT8_MAX;
+    }
+    return 0;
+}
+
+#endif //KNIT_ARRAY_H
@@ -1,9 +1,13 @@
 #ifndef KNIT_BITSET_H
 #define KNIT_BITSET_H
 #include <limits.h>
+#include <stdint.h>
 #include <stdlib.h>
 #include <stdio.h>
 #include <string.h>
+#ifdef __SSE2__
+    #include <emmintrin.h>
+#endif
 
 #include "kdata.h"
 #include "knit_util.h"
@@ -13,57 +17,133 @@
     #error "only supports 8 bit byte platforms"
 #endif
 
-#define BITS_IN_UNSIGNED (sizeof(unsigned) * 8)
-#define UNSIGNED_ALL_BITS_ON UINT_MAX
+/*
+Bitsets on 64 bit words, used by the gc (alloc and mark bits) and behind the bitset() script type.
+Bits past bit_len in the last word are kept at 0 so whole words can be counted and combined without masking.
+The bulk operations work on two words at a time with SSE2 when it is available.
+*/
+
+#define BITS_IN_WORD (sizeof(knit_bitset_word) * 8)
+#define WORD_ALL_BITS_ON UINT64_MAX
 
+enum KNIT_BITSET_OP {
+    KNIT_BITSET_AND,
+    KNIT_BITSET_OR,
+    KNIT_BITSET_XOR,
+    KNIT_BITSET_ANDN, //a & ~b
+};
 
 struct idx_pair {
-    size_t unsigned_idx;
+    size_t word_idx;
     int bit_idx;
 };
 static struct idx_pair resolve_bit_idx(size_t bit_idx) {
     struct idx_pair idx;
-    idx.unsigned_idx = (bit_idx / BITS_IN_UNSIGNED);
-    idx.bit_idx = (bit_idx % BITS_IN_UNSIGNED);
+    idx.word_idx = (bit_idx / BITS_IN_WORD);
+    idx.bit_idx = (bit_idx % BITS_IN_WORD);
     return idx;
 }
-static size_t recombine_bit_idx(size_t unsigned_idx, int bit_idx)
+static size_t recombine_bit_idx(size_t word_idx, int bit_idx)
 {
-    return (unsigned_idx * BITS_IN_UNSIGNED) + bit_idx;
+    return (word_idx * BITS_IN_WORD) + bit_idx;
 }
-static int bits_excess (size_t bit_len) {
+
+static size_t n_needed_words(size_t bit_len) {
     if (!bit_len)
         return 0;
     struct idx_pair idx = resolve_bit_idx(bit_len - 1);
-    return BITS_IN_UNSIGNED - idx.bit_idx - 1;
+    return idx.word_idx + 1;
+}
+static size_t bitset_nbytes(size_t bit_len) {
+    return n_needed_words(bit_len) * sizeof(knit_bitset_word);
 }
 
-static size_t n_needed_unsigneds(size_t bit_len) {
-    if (!bit_len)
-        return 0;
-    struct idx_pair idx = resolve_bit_idx(bit_len - 1);
-    return idx.unsigned_idx + 1;
+static int word_ctz(knit_bitset_word w) {
+#ifdef __GNUC__
+    return __builtin_ctzll(w);
+#else
+    int i = 0;
+    while (!(w & 1U)) {
+        w >>= 1;
+        i++;
+    }
+    return i;
+#endif
+}
+static int word_popcount(knit_bitset_word w) {
+#ifdef __GNUC__
+    return __builtin_popcountll(w);
+#else
+    w = w - ((w >> 1) & 0x5555555555555555ULL);
+    w = (w & 0x3333333333333333ULL) + ((w >> 2) & 0x3333333333333333ULL);
+    w = (w + (w >> 4)) & 0x0f0f0f0f0f0f0f0fULL;
+    return (int) ((w * 0x0101010101010101ULL) >> 56);
+#endif
+}
+//the bits [from, 64) of a word
+static knit_bitset_word word_mask_from(int bit_idx) {
+    return WORD_ALL_BITS_ON << bit_idx;
+}
+//the bits [0, to) of a word, to can be 64
+static knit_bitset_word word_mask_below(int bit_idx) {
+    return bit_idx >= (int) BITS_IN_WORD ? WORD_ALL_BITS_ON : ((knit_bitset_word) 1 << bit_idx) - 1;
 }
 
-static void unsigned_set_bit(unsigned *u, int bit_idx, bool state)
+static void word_set_bit(knit_bitset_word *w, int bit_idx, bool state)
 {
     if (state)
-        *u = *u | (1U << bit_idx);
+        *w = *w | ((knit_bitset_word) 1 << bit_idx);
     else
-        *u = *u & (~ (1U << bit_idx) );
+        *w = *w & (~ ((knit_bitset_word) 1 << bit_idx) );
 }
-static bool unsigned_get_bit(unsigned *u, int bit_idx)
-{
-    return *u & (1U << bit_idx);
+
+//clears the bits past bit_len in the last word
+static void bitset_clear_excess(struct knit_bitset *bitset) {
+    if (!bitset->bit_len)
+        return;
+    struct idx_pair last_idx = resolve_bit_idx(bitset->bit_len - 1);
+    bitset->data[last_idx.word_idx] &= word_mask_below(last_idx.bit_idx + 1);
 }
 
+#ifdef __SSE2__
+    #define KNIT_BITSET_BULK_LOOP(x, y, n, vexpr, sexpr) do { \
+        size_t i_ = 0; \
+        for (; i_ + 2 <= (n); i_ += 2) { \
+            __m128i vx = _mm_loadu_si128((const __m128i *) ((x) + i_)); \
+            __m128i vy = _mm_loadu_si128((const __m128i *) ((y) + i_)); \
+            _mm_storeu_si128((__m128i *) ((x) + i_), (vexpr)); \
+        } \
+        for (; i_ < (n); i_++) { \
+            knit_bitset_word sx = (x)[i_], sy = (y)[i_]; \
+            (x)[i_] = (sexpr); \
+        } \
+    } while (0)
+#else
+    #define KNIT_BITSET_BULK_LOOP(x, y, n, vexpr, sexpr) do { \
+        for (size_t i_ = 0; i_ < (n); i_++) { \
+            knit_bitset_word sx = (x)[i_], sy = (y)[i_]; \
+            (x)[i_] = (sexpr); \
+        } \
+    } while (0)
+#endif
 
 // a[bit] = b[bit] & (!a[bit])
 static void bitset_andn(struct knit_bitset *a, struct knit_bitset *b) {
     knit_assert_h(a->bit_len == b->bit_len, "");
-    size_t n = n_needed_unsigneds(a->bit_len);
-    for (long i=0; i<n; i++) {
-        a->data[i] = b->data[i] & (~ a->data[i]);
+    size_t n = n_needed_words(a->bit_len);
+    KNIT_BITSET_BULK_LOOP(a->data, b->data, n, _mm_andnot_si128(vx, vy), sy & ~sx);
+}
+
+//a = a op b (enum KNIT_BITSET_OP), both must have the same length
+static void bitset_bulk_op(struct knit_bitset *a, const struct knit_bitset *b, int op) {
+    knit_assert_h(a->bit_len == b->bit_len, "");
+    size_t n = n_needed_words(a->bit_len);
+    switch (op) {
+        case KNIT_BITSET_AND:  KNIT_BITSET_BULK_LOOP(a->data, b->data, n, _mm_and_si128(vx, vy), sx & sy); break;
+        case KNIT_BITSET_OR:   KNIT_BITSET_BULK_LOOP(a->data, b->data, n, _mm_or_si128(vx, vy), sx | sy); break;
+        case KNIT_BITSET_XOR:  KNIT_BITSET_BULK_LOOP(a->data, b->data, n, _mm_xor_si128(vx, vy), sx ^ sy); break;
+        case KNIT_BITSET_ANDN: KNIT_BITSET_BULK_LOOP(a->data, b->data, n, _mm_andnot_si128(vy, vx), sx & ~sy); break;
+        default: knit_assert_h(0, "unknown bitset op");
     }
 }
 
@@ -81,14 +161,46 @@ static void bitset_set_all(struct knit_bitset *bitset, bool state, size_t up_to)
     sb |= sb << 4;
     sb |= sb << 2;
     sb |= sb << 1;
-    memset(bitset->data, sb, sizeof(bitset->data[0]) * n_needed_unsigneds(bitset->bit_len));
+    memset(bitset->data, sb, bitset_nbytes(bitset->bit_len));
+    bitset_clear_excess(bitset);
 }
-static int bitset_init(struct knit_bitset *bitset, size_t bit_len) 
+
+//sets the bits [begin, end) to state
+static void bitset_set_range(struct knit_bitset *bitset, size_t begin, size_t end, bool state) {
+    knit_assert_h(begin <= end && end <= bitset->bit_len, "bitset range out of bounds");
+    if (begin == end)
+        return;
+    struct idx_pair first = resolve_bit_idx(begin);
+    struct idx_pair last = resolve_bit_idx(end - 1);
+    knit_bitset_word first_mask = word_mask_from(first.bit_idx);
+    knit_bitset_word last_mask = word_mask_below(last.bit_idx + 1);
+    knit_bitset_word *data = bitset->data;
+    if (first.word_idx == last.word_idx) {
+        knit_bitset_word mask = first_mask & last_mask;
+        data[first.word_idx] = state ? data[first.word_idx] | mask : data[first.word_idx] & ~mask;
+        return;
+    }
+    data[first.word_idx] = state ? data[first.word_idx] | first_mask : data[first.word_idx] & ~first_mask;
+    if (last.word_idx > first.word_idx + 1)
+        memset(data + first.word_idx + 1, state ? 0xff : 0, (last.word_idx - first.word_idx - 1) * sizeof(knit_bitset_word));
+    data[last.word_idx] = state ? data[last.word_idx] | last_mask : data[last.word_idx] & ~last_mask;
+}
+
+//number of bits set
+static size_t bitset_count(const struct knit_bitset *bitset) {
+    size_t n = n_needed_words(bitset->bit_len);
+    size_t count = 0;
+    for (size_t i=0; i<n; i++)
+        count += word_popcount(bitset->data[i]);
+    return count;
+}
+
+static int bitset_init(struct knit_bitset *bitset, size_t bit_len)
 {
     size_t sz = 0;
-    unsigned *data = NULL;
+    knit_bitset_word *data = NULL;
     if (bit_len) {
-       sz = n_needed_unsigneds(bit_len) * sizeof(unsigned);
+       sz = bitset_nbytes(bit_len);
        data = malloc(sz);
        if (!data) {
            return KNIT_NOMEM;
@@ -109,15 +221,8 @@ static int bitset_realloc(struct knit_bitset *bitset, size_t new_bit_len)
     if (!bitset->bit_len) {
         return bitset_init(bitset, new_bit_len);
     }
-    struct idx_pair last_idx = resolve_bit_idx(bitset->bit_len - 1);
-    last_idx.bit_idx++;
-    unsigned *last_u = bitset->data + last_idx.unsigned_idx;
-    for (int i=last_idx.bit_idx; i < BITS_IN_UNSIGNED; i++) {
-        unsigned_set_bit(last_u, i, false);
-    }
-
-    size_t old_sz = (last_idx.unsigned_idx + 1) * sizeof(unsigned);
-    size_t new_sz = n_needed_unsigneds(new_bit_len) * sizeof(unsigned);
+    size_t old_sz = bitset_nbytes(bitset->bit_len);
+    size_t new_sz = bitset_nbytes(new_bit_len);
     void *p = realloc(bitset->data, new_sz);
     if (!p) {
         return KNIT_NOMEM;
@@ -125,8 +230,9 @@ static int bitset_realloc(struct knit_bitset *bitset, size_t new_bit_len)
     bitset->bit_len = new_bit_len;
     bitset->data = p;
     if (new_sz > old_sz) {
-        memset(bitset->data + last_idx.unsigned_idx + 1, 0, new_sz - old_sz);
+        memset((char *) bitset->data + old_sz, 0, new_sz - old_sz);
     }
+    bitset_clear_excess(bitset);
     return KNIT_OK;
 }
 static void bitset_deinit(struct knit_bitset *bitset) {
@@ -138,97 +244,48 @@ static void bitset_deinit(struct knit_bitset *bitset) {
 static bool bitset_get_bit(struct knit_bitset *bitset, size_t bit_idx)
 {
     struct idx_pair idx = resolve_bit_idx(bit_idx);
-    return bitset->data[idx.unsigned_idx] & (1U << idx.bit_idx);
+    return (bitset->data[idx.word_idx] >> idx.bit_idx) & 1U;
 }
 static void bitset_set_bit(struct knit_bitset *bitset, size_t bit_idx, bool state)
 {
     struct idx_pair idx = resolve_bit_idx(bit_idx);
-    unsigned_set_bit(bitset->data + idx.unsigned_idx, idx.bit_idx, state);
+    word_set_bit(bitset->data + idx.word_idx, idx.bit_idx, state);
 }
 
+//the first bit >= start_at_bit_idx that is 0, or -1
 static long bitset_find_false_bit(struct knit_bitset *bitset,  size_t start_at_bit_idx)
 {
-    struct idx_pair last_idx = resolve_bit_idx(bitset->bit_len - 1);
-    struct idx_pair start_idx = resolve_bit_idx(start_at_bit_idx);
-    long start_at = start_idx.unsigned_idx; 
-    long i;
-    int bit_idx;
-    unsigned inv_v;
-
-    if (start_at_bit_idx != 0 && bitset->data[start_idx.unsigned_idx] != UNSIGNED_ALL_BITS_ON) {
-        //check the first skipped unsigned (slow)
-        for (i=start_idx.bit_idx; i < BITS_IN_UNSIGNED; i++) {
-            if (!unsigned_get_bit(bitset->data + start_idx.unsigned_idx, i))
-                return recombine_bit_idx(start_idx.unsigned_idx, i);
-        }
-        start_at++; //skip first unsigned
-    }
-
-    //find an unsigned that is not 0xFFFFFF...
-    for (i = start_at; i <= last_idx.unsigned_idx; i++) {
-        if (bitset->data[i] != UNSIGNED_ALL_BITS_ON) {
-            goto found;
-        }
-    }
-    return -1; //not found
-found:
-    bit_idx = 0;
-    inv_v = ~ (bitset->data[i]);
-    if (inv_v != 0) {
-#ifdef _GNUC_
-        //Built-in Function: int __builtin_ctz (unsigned int x)
-        //Returns the number of trailing 0-bits in x, starting at the least significant bit position. If x is 0, the result is undefined.
-        bit_idx = __builtin_ctz(inv_v);
-#else
-        for (bit_idx = 0; bit_idx<BITS_IN_UNSIGNED; bit_idx++) {
-            if (inv_v & (1U << bit_idx))
-                break;
-        }
-#endif
+    if (start_at_bit_idx >= bitset->bit_len)
+        return -1;
+    size_t n = n_needed_words(bitset->bit_len);
+    struct idx_pair idx = resolve_bit_idx(start_at_bit_idx);
+    size_t i = idx.word_idx;
+    knit_bitset_word inv_v = ~bitset->data[i] & word_mask_from(idx.bit_idx);
+    while (!inv_v) {
+        if (++i == n)
+            return -1;
+        inv_v = ~bitset->data[i];
     }
-    return recombine_bit_idx(i, bit_idx);
+    size_t found = recombine_bit_idx(i, word_ctz(inv_v));
+    //the excess bits of the last word are 0 but aren't part of the set
+    return found < bitset->bit_len ? (long) found : -1;
 }
 
+//the first bit >= start_at_bit_idx that is 1, or -1
 static long bitset_find_true_bit(struct knit_bitset *bitset,  size_t start_at_bit_idx)
 {
-    struct idx_pair last_idx = resolve_bit_idx(bitset->bit_len - 1);
-    struct idx_pair start_idx = resolve_bit_idx(start_at_bit_idx);
-    long start_at = start_idx.unsigned_idx;
-    long i;
-    int bit_idx;
-    unsigned v;
-
-    if (start_at_bit_idx != 0 && bitset->data[start_idx.unsigned_idx] != 0) {
-        //check the first skipped unsigned, (slow)
-        for (i=start_idx.bit_idx; i < BITS_IN_UNSIGNED; i++) {
-            if (unsigned_get_bit(bitset->data + start_idx.unsigned_idx, i))
-                return recombine_bit_idx(start_idx.unsigned_idx, i);
-        }
-        start_at++; //skip first unsigned
+    if (start_at_bit_idx >= bitset->bit_len)
+        return -1;
+    size_t n = n_needed_words(bitset->bit_len);
+    struct idx_pair idx = resolve_bit_idx(start_at_bit_idx);
+    size_t i = idx.word_idx;
+    knit_bitset_word v = bitset->data[i] & word_mask_from(idx.bit_idx);
+    while (!v) {
+        if (++i == n)
+            return -1;
+        v = bitset->data[i];
     }
-
-    //find an unsigned that is not 0x00000...
-    for (i = start_at; i <= last_idx.unsigned_idx; i++) {
-        if (bitset->data[i]) {
-            goto found;
-        }
-    }
-    return -1; //not found
-
-found:
-    bit_idx = 0;
-    v = bitset->data[i];
-#ifdef _GNUC_
-    //Built-in Function: int __builtin_ctz (unsigned int x)
-    //Returns the number of trailing 0-bits in x, starting at the least significant bit position. If x is 0, the result is undefined.
-    bit_idx = __builtin_ctz(v);
-#else
-    for (bit_idx = 0; bit_idx<BITS_IN_UNSIGNED; bit_idx++) {
-        if (v & (1U << bit_idx))
-            break;
-    }
-#endif
-    return recombine_bit_idx(i, bit_idx);
+    return recombine_bit_idx(i, word_ctz(v));
 }
 
-#endif
\ No newline at end of file
+#endif
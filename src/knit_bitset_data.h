@@ -1,7 +1,13 @@
 #ifndef KNIT_BITSET_DATA_H
 #define KNIT_BITSET_DATA_H
+#include <stddef.h>
+#include <stdint.h>
+
+typedef uint64_t knit_bitset_word;
+
+//bits past bit_len in the last word are always 0
 struct knit_bitset {
-    unsigned *data;
+    knit_bitset_word *data;
     size_t bit_len;
 };
 #endif
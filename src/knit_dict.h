@@ -0,0 +1,301 @@
+#ifndef KNIT_DICT_H
+#define KNIT_DICT_H
+#include <stdint.h>
+#include <string.h>
+#ifdef __SSE2__
+    #include <emmintrin.h>
+#endif
+
+#include "kdata.h"
+#include "knit_util.h"
+
+/*
+The table behind knit dicts. The entries of the hash part are stored densely in insertion order (like CPython's
+compact dicts) so iterating them is a linear scan and prints them in the order they were added. They are found
+through an index, open addressing with a control byte per slot (in the style of abseil's swiss tables).
+
+index[i] is the entry stored in slot i, ctrl[i] is KNIT_DICT_EMPTY or the low 7 bits of the hash of its key (h2),
+the rest of the hash (h1) picks the first group of KNIT_DICT_GROUP_SZ slots to probe. A probe compares h2 against the control bytes of a whole group
+at once (one SSE2 compare when available) so keys are only compared for slots whose h2 matches, and the probe
+stops at the first group that has an empty slot. Groups are probed triangularly which visits all of them since
+their number is a power of 2.
+
+Keys can only be ints and strings, they are hashed and compared inline instead of through callbacks.
+Entries can't be removed so there are no tombstones and entries has no holes. The index costs 5 bytes per slot
+and the entries array grows on its own, so small dicts don't pay for 16 empty key/value pairs.
+
+Like lua tables, dicts also have an array part: the values of the int keys 0..array_cap-1 are stored by index
+in dict->array (no key objects, no hashing). Other int keys go to the hash part, when it has to grow
+knit_dict_rehash() picks the largest power of 2 array size that would be more than half full and moves the
+hash part's int keys below it to the array. Since entries can't be removed the array part never shrinks.
+*/
+
+#define KNIT_DICT_EMPTY ((signed char) -128)
+//max load factor is 7/8
+#define KNIT_DICT_MAX_LEN(cap) ((cap) - (cap) / 8)
+
+static const char *knitx_obj_type_name(struct knit *knit, struct knit_obj *obj); //fwd
+static unsigned int knitx_str_hash(struct knit_str *str); //fwd
+static int knitx_str_streq(struct knit *knit, struct knit_str *str_a, struct knit_str *str_b); //fwd
+static int knitx_str_flatten(struct knit *knit, struct knit_str *str); //fwd
+
+static int knit_dict_ctz(unsigned mask) {
+#ifdef __GNUC__
+    return __builtin_ctz(mask);
+#else
+    int i = 0;
+    while (!(mask & 1U)) {
+        mask >>= 1;
+        i++;
+    }
+    return i;
+#endif
+}
+
+//bit i is set if group[i] == h2
+static unsigned knit_dict_group_match(const signed char *group, signed char h2) {
+#ifdef __SSE2__
+    __m128i ctrl = _mm_loadu_si128((const __m128i *) group);
+    return (unsigned) _mm_movemask_epi8(_mm_cmpeq_epi8(ctrl, _mm_set1_epi8(h2)));
+#else
+    unsigned mask = 0;
+    for (int i=0; i<KNIT_DICT_GROUP_SZ; i++)
+        mask |= (unsigned) (group[i] == h2) << i;
+    return mask;
+#endif
+}
+
+//bit i is set if group[i] is empty, full slots have the sign bit cleared
+static unsigned knit_dict_group_match_empty(const signed char *group) {
+#ifdef __SSE2__
+    return (unsigned) _mm_movemask_epi8(_mm_loadu_si128((const __m128i *) group));
+#else
+    unsigned mask = 0;
+    for (int i=0; i<KNIT_DICT_GROUP_SZ; i++)
+        mask |= (unsigned) (group[i] < 0) << i;
+    return mask;
+#endif
+}
+
+static int knit_dict_hash(struct knit *knit, struct knit_obj *key, uint64_t *hash_out) {
+    uint64_t h;
+    switch (key->u.ktype) {
+        case KNIT_INT:
+            h = (uint64_t) (unsigned) key->u.integer.value;
+            break;
+        case KNIT_STR: {
+            int rv = knitx_str_flatten(knit, &key->u.str);
+            if (rv != KNIT_OK)
+                return rv;
+            h = knitx_str_hash(&key->u.str);
+            break;
+        }
+        default:
+            return knit_error(knit, KNIT_RUNTIME_ERR, "hashing %s types is not implemented", knitx_obj_type_name(knit, key));
+    }
+    //spreads consecutive ints and the 32 bit string hashes over both h1 and h2
+    h *= 0x9E3779B97F4A7C15ULL;
+    *hash_out = h ^ (h >> 32);
+    return KNIT_OK;
+}
+
+static int knit_dict_key_eq(struct knit *knit, struct knit_obj *a, struct knit_obj *b) {
+    if (a == b)
+        return 1;
+    if (a->u.ktype != b->u.ktype)
+        return 0;
+    if (a->u.ktype == KNIT_INT)
+        return a->u.integer.value == b->u.integer.value;
+    return knitx_str_streq(knit, &a->u.str, &b->u.str);
+}
+
+//the entry of key, -1 if it isn't in the table
+static int knit_dict_find(struct knit *knit, struct knit_dict *dict, struct knit_obj *key, uint64_t hash) {
+    if (!dict->cap)
+        return -1;
+    size_t groups_mask = dict->cap / KNIT_DICT_GROUP_SZ - 1;
+    size_t g = (hash >> 7) & groups_mask;
+    signed char h2 = hash & 0x7f;
+    for (size_t stride = 1; ; stride++) {
+        const signed char *group = dict->ctrl + g * KNIT_DICT_GROUP_SZ;
+        unsigned match = knit_dict_group_match(group, h2);
+        while (match) {
+            int e = dict->index[g * KNIT_DICT_GROUP_SZ + knit_dict_ctz(match)];
+            if (knit_dict_key_eq(knit, dict->entries[e].key, key))
+                return e;
+            match &= match - 1;
+        }
+        if (knit_dict_group_match_empty(group))
+            return -1;
+        g = (g + stride) & groups_mask;
+    }
+}
+
+//the first empty slot in the probe sequence of hash, the table must not be full
+static int knit_dict_find_empty(struct knit_dict *dict, uint64_t hash) {
+    size_t groups_mask = dict->cap / KNIT_DICT_GROUP_SZ - 1;
+    size_t g = (hash >> 7) & groups_mask;
+    for (size_t stride = 1; ; stride++) {
+        unsigned empty = knit_dict_group_match_empty(dict->ctrl + g * KNIT_DICT_GROUP_SZ);
+        if (empty)
+            return g * KNIT_DICT_GROUP_SZ + knit_dict_ctz(empty);
+        g = (g + stride) & groups_mask;
+    }
+}
+
+//the index and the control bytes share one allocation
+static size_t knit_dict_alloc_size(int cap) {
+    return (size_t) cap * (sizeof(int) + 1);
+}
+
+static size_t knit_dict_entries_size(int entries_cap) {
+    return (size_t) entries_cap * sizeof(struct knit_dict_entry);
+}
+
+//makes room for one more entry
+static int knit_dict_grow_entries(struct knit *knit, struct knit_dict *dict) {
+    if (dict->len < dict->entries_cap)
+        return KNIT_OK;
+    int new_cap = dict->entries_cap ? dict->entries_cap * 2 : 4;
+    void *p = NULL;
+    int rv = knitx_slab_realloc(knit, dict->entries, knit_dict_entries_size(dict->entries_cap), knit_dict_entries_size(new_cap), &p);
+    if (rv != KNIT_OK)
+        return rv;
+    dict->entries = p;
+    dict->entries_cap = new_cap;
+    return KNIT_OK;
+}
+
+static inline int knit_dict_in_array(struct knit_dict *dict, struct knit_obj *key) {
+    return key->u.ktype == KNIT_INT && (unsigned) key->u.integer.value < (unsigned) dict->array_cap;
+}
+
+//reallocates the index and grows the array part to array_cap, the entries whose keys fall in the
+//array part are moved there and the rest are compacted. the dict is left untouched if an allocation fails
+static int knit_dict_resize(struct knit *knit, struct knit_dict *dict, int new_cap, int array_cap) {
+    knit_assert_h(new_cap % KNIT_DICT_GROUP_SZ == 0 && array_cap >= dict->array_cap, "");
+    void *p = NULL;
+    int rv = knitx_rmalloc(knit, knit_dict_alloc_size(new_cap), &p);
+    if (rv != KNIT_OK)
+        return rv;
+    if (array_cap > dict->array_cap) {
+        void *ap = NULL;
+        size_t old_sz = dict->array_cap * sizeof(struct knit_obj *);
+        rv = knitx_rrealloc(knit, dict->array, old_sz, array_cap * sizeof(struct knit_obj *), &ap);
+        if (rv != KNIT_OK) {
+            knitx_rfree(knit, p, knit_dict_alloc_size(new_cap));
+            return rv;
+        }
+        dict->array = ap;
+        memset(dict->array + dict->array_cap, 0, array_cap * sizeof(struct knit_obj *) - old_sz);
+        dict->array_cap = array_cap;
+    }
+    int *old_index = dict->index;
+    int old_cap = dict->cap;
+    dict->index = p;
+    dict->ctrl = (signed char *) (dict->index + new_cap);
+    dict->cap = new_cap;
+    memset(dict->ctrl, KNIT_DICT_EMPTY, new_cap);
+    int len = 0;
+    for (int i=0; i<dict->len; i++) {
+        struct knit_dict_entry e = dict->entries[i];
+        if (knit_dict_in_array(dict, e.key)) {
+            dict->array[e.key->u.integer.value] = e.value;
+            continue;
+        }
+        uint64_t hash = 0;
+        //keys were hashed when inserted, this can't fail
+        knit_dict_hash(knit, e.key, &hash);
+        int idx = knit_dict_find_empty(dict, hash);
+        dict->ctrl[idx] = hash & 0x7f;
+        dict->index[idx] = len;
+        dict->entries[len++] = e;
+    }
+    dict->len = len;
+    knit_assert_h(KNIT_DICT_MAX_LEN(new_cap) >= dict->len, "");
+    if (old_cap)
+        knitx_rfree(knit, old_index, knit_dict_alloc_size(old_cap));
+    return KNIT_OK;
+}
+
+//the smallest capacity that holds len entries
+static int knit_dict_cap_for(int len) {
+    int cap = KNIT_DICT_GROUP_SZ;
+    while (KNIT_DICT_MAX_LEN(cap) < len)
+        cap *= 2;
+    return cap;
+}
+
+//the number of bits needed to write k, int keys are counted by it to size the array part
+static int knit_dict_bit_len(unsigned k) {
+    int n = 0;
+    while (k) {
+        k >>= 1;
+        n++;
+    }
+    return n;
+}
+
+static int knit_dict_hash_full(struct knit_dict *dict) {
+    return dict->len + 1 > KNIT_DICT_MAX_LEN(dict->cap);
+}
+
+//called when the hash part is full, makes room for new_key: first the array part is resized to the
+//largest power of 2 that would be more than half full (counting new_key), then the hash part is resized
+//for the entries that are left in it
+static int knit_dict_rehash(struct knit *knit, struct knit_dict *dict, struct knit_obj *new_key) {
+    int nums[33] = {0}; //nums[b]: number of int keys of bit length b
+    int nints = 0;
+    for (int i=0; i<dict->array_cap; i++) {
+        if (dict->array[i]) {
+            nums[knit_dict_bit_len(i)]++;
+            nints++;
+        }
+    }
+    for (int i=0; i<dict->len; i++) {
+        struct knit_obj *key = dict->entries[i].key;
+        if (key->u.ktype == KNIT_INT && key->u.integer.value >= 0) {
+            nums[knit_dict_bit_len(key->u.integer.value)]++;
+            nints++;
+        }
+    }
+    if (new_key->u.ktype == KNIT_INT && new_key->u.integer.value >= 0) {
+        nums[knit_dict_bit_len(new_key->u.integer.value)]++;
+        nints++;
+    }
+    //keys below 1 << b are the ones of bit length <= b
+    int array_cap = 0;
+    int nbelow = 0;
+    for (int b=0; b < 31 && nints > (1 << b) / 2; b++) {
+        nbelow += nums[b];
+        if (nbelow > (1 << b) / 2)
+            array_cap = 1 << b;
+    }
+    //keys can't be removed, so the current array part is still more than half full
+    knit_assert_h(array_cap >= dict->array_cap, "");
+    //the hash part keeps the keys that don't move to the array part
+    int nleft = 0;
+    for (int i=0; i<dict->len; i++) {
+        struct knit_obj *key = dict->entries[i].key;
+        if (key->u.ktype != KNIT_INT || (unsigned) key->u.integer.value >= (unsigned) array_cap)
+            nleft++;
+    }
+    return knit_dict_resize(knit, dict, knit_dict_cap_for(nleft + 1), array_cap);
+}
+
+//adds a key that isn't in the table yet, hash must be its knit_dict_hash() and the hash part must have room
+static int knit_dict_insert_new(struct knit *knit, struct knit_dict *dict, struct knit_obj *key, uint64_t hash, struct knit_obj *value) {
+    knit_assert_h(!knit_dict_hash_full(dict), "");
+    int rv = knit_dict_grow_entries(knit, dict);
+    if (rv != KNIT_OK)
+        return rv;
+    int idx = knit_dict_find_empty(dict, hash);
+    dict->ctrl[idx] = hash & 0x7f;
+    dict->index[idx] = dict->len;
+    dict->entries[dict->len].key = key;
+    dict->entries[dict->len].value = value;
+    dict->len++;
+    return KNIT_OK;
+}
+
+#endif //KNIT_DICT_H
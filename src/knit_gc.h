@@ -3,13 +3,16 @@
 
 #include "kdata.h" //data structures
 #include "knit_bitset.h"
+#include "knit_dict.h"
 
 static void knit_obj_deinit(struct knit *knit, struct knit_obj *obj); //fwd
+static int knit_error(struct knit *knit, int err_type, const char *fmt, ...); //fwd
 
 //size: number of objects
 int knit_heap_init(struct knit *knit, struct knit_heap *heap, int heap_sz) {
     heap->capacity = heap_sz;
     heap->count = 0;
+    heap->next_free = 0;
     int rv;
     if ((rv = bitset_init(&heap->alloc_bitset, heap_sz)) != 0) {
         return rv;
@@ -18,10 +21,16 @@ int knit_heap_init(struct knit *knit, struct knit_heap *heap, int heap_sz) {
         bitset_deinit(&heap->alloc_bitset);
         return rv;
     }
+    if (knit_objp_darray_init(&heap->nursery, 64) != KNIT_OBJP_DARRAY_OK) {
+        bitset_deinit(&heap->alloc_bitset);
+        bitset_deinit(&heap->mark_bitset);
+        return KNIT_NOMEM;
+    }
     void *p;
     if ((rv = knitx_rmalloc(knit, heap_sz * sizeof(heap->objects[0]), &p)) != KNIT_OK) {
         bitset_deinit(&heap->alloc_bitset);
         bitset_deinit(&heap->mark_bitset);
+        knit_objp_darray_deinit(&heap->nursery);
         return rv;
     }
     heap->objects = p;
@@ -30,18 +39,41 @@ int knit_heap_init(struct knit *knit, struct knit_heap *heap, int heap_sz) {
 void knit_heap_deinit(struct knit *knit, struct knit_heap *heap) {
     bitset_deinit(&heap->alloc_bitset);
     bitset_deinit(&heap->mark_bitset);
-    knitx_rfree(knit, heap->objects);
+    knit_objp_darray_deinit(&heap->nursery);
+    knitx_rfree(knit, heap->objects, heap->capacity * sizeof(heap->objects[0]));
 }
+/*
+The heap has a fixed number of objects. A full heap is collected before giving up, with or without a
+memory limit, and a heap that is still full afterwards is a KNIT_GC_NOMEM error. New objects go in the
+nursery so a collection that runs before the caller stores them somewhere reachable doesn't free them,
+knitx_exec() empties the nursery between instructions.
+*/
 struct knit_obj *knit_gc_new_object(struct knit *knit) {
-    if (knit->ex.heap.count >= knit->ex.heap.capacity) {
-        return NULL;
+    struct knit_heap *heap = &knit->ex.heap;
+    if (heap->count >= heap->capacity) {
+        knitx_mem_collect(knit);
+        if (heap->count >= heap->capacity) {
+            knit_error(knit, KNIT_GC_NOMEM, "the gc heap is full, all of its %d objects are in use", heap->capacity);
+            return NULL;
+        }
     }
-    struct knit_bitset *b = &knit->ex.heap.alloc_bitset;
-    long idx = bitset_find_false_bit(b, 0);
+    struct knit_bitset *b = &heap->alloc_bitset;
+    long idx = bitset_find_false_bit(b, heap->next_free);
+    if (idx < 0)
+        idx = bitset_find_false_bit(b, 0);
     knit_assert_h(idx >= 0, "");
+    heap->next_free = idx + 1;
     bitset_set_bit(b, idx, 1);
-    knit->ex.heap.count++;
-    return knit->ex.heap.objects + idx;
+    heap->count++;
+    struct knit_obj *obj = heap->objects + idx;
+    //a collection may run before the caller initializes the object
+    obj->u.ktype = KNIT_NULL;
+    if (knit_objp_darray_push(&heap->nursery, &obj) != KNIT_OBJP_DARRAY_OK) {
+        bitset_set_bit(b, idx, 0);
+        heap->count--;
+        return NULL;
+    }
+    return obj;
 }
 
 static long knit_gc_object_index(struct knit *knit, struct knit_obj *obj) {
@@ -61,6 +93,7 @@ static int knit_gc_is_gc_object(struct knit *knit, struct knit_obj *obj) {
 
 
 static void knit_gc_walk_object(struct knit *knit, struct knit_obj *obj) {
+walk_again:
     if (!obj)
         return;
     long obj_idx = knit_gc_object_index(knit, obj);
@@ -81,24 +114,46 @@ static void knit_gc_walk_object(struct knit *knit, struct knit_obj *obj) {
     #endif
     if (obj->u.ktype == KNIT_DICT) {
         struct knit_dict *dict = (struct knit_dict*) obj;
-        struct kobj_hasht *ht = &dict->ht;
-        struct kobj_hasht_iter iter;
-        kobj_hasht_begin_iterator(ht, &iter);
-        for (int i=0; kobj_hasht_iter_check(&iter); i++, kobj_hasht_iter_next(ht, &iter)) 
-        {
-            struct knit_obj *key = iter.pair->key;
-            struct knit_obj *value = iter.pair->value;
-            knit_gc_walk_object(knit, key);
-            knit_gc_walk_object(knit, value);
+        for (int i=0; i<dict->len; i++) {
+            knit_gc_walk_object(knit, dict->entries[i].key);
+            knit_gc_walk_object(knit, dict->entries[i].value);
+        }
+        for (int i=0; i<dict->array_cap; i++) {
+            knit_gc_walk_object(knit, dict->array[i]);
         }
     }
     else if (obj->u.ktype == KNIT_LIST) {
         struct knit_list *list = (struct knit_list*) obj;
-        for (int i=0; i<list->len; i++) {
+        //views keep the list owning their buffer alive, unboxed elements aren't objects
+        knit_gc_walk_object(knit, (struct knit_obj *) list->view_base);
+        for (int i=0; list->mode == KNIT_LIST_BOXED && i<list->len; i++) {
             struct knit_obj *elem = list->items[i];
             knit_gc_walk_object(knit, elem);
         }
     }
+    else if (obj->u.ktype == KNIT_DEQUE) {
+        struct knit_deque *dq = (struct knit_deque *) obj;
+        for (int i=0; i<dq->len; i++)
+            knit_gc_walk_object(knit, dq->items[(dq->head + i) & (dq->cap - 1)]);
+    }
+    else if (obj->u.ktype == KNIT_PQUEUE) {
+        //keys are the items themselves unless there is a key function
+        struct knit_pqueue *pq = (struct knit_pqueue *) obj;
+        knit_gc_walk_object(knit, pq->key_func);
+        for (int i=0; i<pq->len; i++) {
+            knit_gc_walk_object(knit, pq->entries[i].item);
+            if (pq->key_func)
+                knit_gc_walk_object(knit, pq->entries[i].key);
+        }
+    }
+    else if (obj->u.ktype == KNIT_SET && obj->u.set.mode == KNIT_SET_HASH) {
+        //bitmap elements aren't objects
+        struct knit_set *set = (struct knit_set *) obj;
+        for (int i=0; i<set->cap; i++) {
+            if (set->ctrl[i] >= 0)
+                knit_gc_walk_object(knit, set->slots[i]);
+        }
+    }
     else if (obj->u.ktype == KNIT_KFUNC) {
         struct knit_kfunc *kfunc = (struct knit_kfunc*) obj;
         for (int i=0; i<kfunc->block.constants.len; i++) {
@@ -106,6 +161,17 @@ static void knit_gc_walk_object(struct knit *knit, struct knit_obj *obj) {
             knit_gc_walk_object(knit, elem);
         }
     }
+    else if (obj->u.ktype == KNIT_STR && (obj->u.str.flags & KNIT_STR_ROPE)) {
+        //ropes built by s = s + x are left deep, so the left side is walked iteratively
+        knit_gc_walk_object(knit, (struct knit_obj *) obj->u.str.rope_right);
+        obj = (struct knit_obj *) obj->u.str.rope_left;
+        goto walk_again;
+    }
+    else if (obj->u.ktype == KNIT_STR && (obj->u.str.flags & KNIT_STR_VIEW)) {
+        //the view points into its base's buffer
+        obj = (struct knit_obj *) obj->u.str.view_base;
+        goto walk_again;
+    }
     
 }
 
@@ -117,6 +183,19 @@ static int knit_gc_walk_workingset(struct knit *knit) {
     for (int i=0; i<stack_vals->len; i++) {
         knit_gc_walk_object(knit, stack_vals->data[i]);
     }
+    //constants of the blocks being executed, the outermost block isn't owned by any kfunc object
+    struct knit_frame_darray *frames = &stack->frames;
+    for (int i=0; i<frames->len; i++) {
+        if (frames->data[i].frame_type != KNIT_FRAME_KBLOCK)
+            continue;
+        struct knit_block *block = frames->data[i].u.kf.block;
+        for (int j=0; j<block->constants.len; j++)
+            knit_gc_walk_object(knit, block->constants.data[j]);
+    }
+    struct knit_objp_darray *nursery = &knit->ex.heap.nursery;
+    for (int i=0; i<nursery->len; i++) {
+        knit_gc_walk_object(knit, nursery->data[i]);
+    }
 
     struct knit_vars_hasht_iter iter;
     knit_vars_hasht_begin_iterator(vars_ht, &iter);
@@ -3,28 +3,115 @@
 #include <stdio.h>
 #include "kdata.h"
 
+/*
+Sampling allocation profiler, enabled by defining KNIT_MEM_PROFILE (see kconfig.h)
 
-static void knit_mem_stats_alloc(struct knit_mem_stats *mm, size_t size) {
+Every sample_interval bytes requested from knitx_rmalloc()/knitx_rrealloc() the knit call stack
+and the ip of each knit frame are recorded, the sample is weighted by the number of intervals
+the allocation crossed, so heavy allocation sites show up proportionally to the bytes they request.
+The samples are written as collapsed stacks (one "frame;frame;frame bytes" line per sample)
+which flamegraph.pl and pprof understand.
+
+The profiler itself allocates through plain malloc() (darrays) so it never samples itself.
+*/
+
+#ifndef KNIT_MEM_PROFILE_INTERVAL
+#define KNIT_MEM_PROFILE_INTERVAL (32 * 1024)
+#endif
+
+static void knit_mem_stats_init(struct knit_mem_stats *mm) {
+    memset(mm, 0, sizeof *mm);
+    mm->sample_interval = KNIT_MEM_PROFILE_INTERVAL;
+    mm->until_sample = mm->sample_interval;
+    knit_memprof_frame_darray_init(&mm->frames, 64);
+    knit_memprof_sample_darray_init(&mm->samples, 16);
+}
+static void knit_mem_stats_deinit(struct knit_mem_stats *mm) {
+    knit_memprof_frame_darray_deinit(&mm->frames);
+    knit_memprof_sample_darray_deinit(&mm->samples);
+}
+
+static void knit_mem_prof_record(struct knit *knit, struct knit_mem_stats *mm) {
+    long long nintervals = 1 + (-mm->until_sample) / mm->sample_interval;
+    mm->until_sample += nintervals * mm->sample_interval;
+
+    struct knit_mem_prof_sample sample;
+    sample.bytes = nintervals * mm->sample_interval;
+    sample.frames_begin = mm->frames.len;
+    sample.nframes = 0;
+    struct knit_frame_darray *frames = &knit->ex.stack.frames;
+    for (int i=0; mm->have_stack && i < frames->len; i++) {
+        struct knit_frame *frm = &frames->data[i];
+        struct knit_mem_prof_frame pf;
+        if (frm->frame_type == KNIT_FRAME_KBLOCK) {
+            pf.fn = frm->u.kf.block;
+            pf.ip = frm->u.kf.ip;
+        }
+        else {
+            pf.fn = frm->u.cf.cfunc;
+            pf.ip = -1;
+        }
+        if (knit_memprof_frame_darray_push(&mm->frames, &pf) != KNIT_MEMPROF_FRAME_DARRAY_OK)
+            return; //samples are dropped rather than failing the allocation
+        sample.nframes++;
+    }
+    if (knit_memprof_sample_darray_push(&mm->samples, &sample) != KNIT_MEMPROF_SAMPLE_DARRAY_OK)
+        mm->frames.len = sample.frames_begin;
+}
+
+static void knit_mem_stats_alloc(struct knit *knit, struct knit_mem_stats *mm, size_t size) {
     mm->allocations++;
-    mm->total_now += size;
+    mm->total_allocated += size;
+    if ((mm->until_sample -= size) <= 0)
+        knit_mem_prof_record(knit, mm);
 }
-static void knit_mem_stats_free(struct knit_mem_stats *mm, size_t size) {
+static void knit_mem_stats_free(struct knit *knit, struct knit_mem_stats *mm) {
     mm->frees++;
-    mm->total_now -= size;
 }
-static void knit_mem_stats_realloc(struct knit_mem_stats *mm, size_t prev_size, size_t new_size) {
-    if (!prev_size && new_size) {
-        knit_mem_stats_alloc(mm, new_size);
-    }
-    else if (prev_size && !new_size) {
-        knit_mem_stats_free(mm, prev_size);
+//sizes of blocks aren't tracked, so the full new size is counted as requested
+static void knit_mem_stats_realloc(struct knit *knit, struct knit_mem_stats *mm, size_t new_size) {
+    mm->reallocations++;
+    mm->total_allocated += new_size;
+    if ((mm->until_sample -= new_size) <= 0)
+        knit_mem_prof_record(knit, mm);
+}
+
+//names are resolved against the globals at dump time, functions that aren't reachable from a global
+//are reported as anonymous
+static const char *knit_mem_prof_frame_name(struct knit *knit, const struct knit_mem_prof_frame *pf, int outermost) {
+    struct knit_vars_hasht *ht = &knit->ex.global_ht;
+    struct knit_vars_hasht_iter iter;
+    knit_vars_hasht_begin_iterator(ht, &iter);
+    for (; knit_vars_hasht_iter_check(&iter); knit_vars_hasht_iter_next(ht, &iter)) {
+        struct knit_obj *val = iter.pair->value;
+        if (!val || !iter.pair->key.str)
+            continue;
+        if (val->u.ktype == KNIT_KFUNC && (const void *) &val->u.kfunc.block == pf->fn)
+            return iter.pair->key.str;
+        if (val->u.ktype == KNIT_CFUNC && (const void *) val == pf->fn)
+            return iter.pair->key.str;
     }
-    else {
-        mm->total_now -= prev_size;
-        mm->total_now += new_size;
-        mm->reallocations++;
+    if (pf->ip < 0)
+        return "<builtin>";
+    return outermost ? "<main>" : "<anonymous>";
+}
+
+//writes the samples as collapsed stacks, knit frames are written as name:ip
+static void knit_mem_prof_dump(struct knit *knit, struct knit_mem_stats *mm, FILE *f) {
+    for (int i=0; i<mm->samples.len; i++) {
+        struct knit_mem_prof_sample *sample = &mm->samples.data[i];
+        if (!sample->nframes)
+            fprintf(f, "<runtime>");
+        for (int j=0; j<sample->nframes; j++) {
+            struct knit_mem_prof_frame *pf = &mm->frames.data[sample->frames_begin + j];
+            fprintf(f, "%s%s", j ? ";" : "", knit_mem_prof_frame_name(knit, pf, j == 0));
+            if (pf->ip >= 0)
+                fprintf(f, ":%d", pf->ip);
+        }
+        fprintf(f, " %llu\n", (unsigned long long) sample->bytes);
     }
 }
+
 static char *humanbytes(char *buff, int buffsz, size_t bytes) {
     char *m[] = {"B", "KB", "MB", "GB", NULL};
     int i = 0;
@@ -37,35 +124,35 @@ static char *humanbytes(char *buff, int buffsz, size_t bytes) {
         buff[0] = 0;
     return buff;
 }
-static void knit_mem_stats_init(struct knit_mem_stats *mm) {
-    memset(mm, 0, sizeof *mm);
-}
 static void knit_mem_stats_dump(struct knit *knit, struct knit_mem_stats *mm) {
     char tmpbuff[64];
-    humanbytes(tmpbuff, sizeof tmpbuff, mm->total_now);
+    humanbytes(tmpbuff, sizeof tmpbuff, mm->total_allocated);
     fprintf(stderr, "[Memory usage report]\n"
                     "Allocations:         %llu\n"
                     "Frees:               %llu\n"
                     "Reallocations:       %llu\n"
-                    "Total in use:        %s\n"
+                    "Total allocated:     %s\n"
+                    "Samples:             %llu (every %lld bytes)\n"
                     "\n"
-                    "Heap allocated objects: %llu\n", 
+                    "Heap allocated objects: %llu\n",
                      (unsigned long long)mm->allocations,
                      (unsigned long long)mm->frees,
                      (unsigned long long)mm->reallocations,
                      tmpbuff,
+                     (unsigned long long)mm->samples.len,
+                     mm->sample_interval,
                      (unsigned long long)knit->ex.heap.count);
 }
 
 
-#ifdef KNIT_MEM_STATS
-    #define KMEMSTAT_ALLOC(knit, sz)                 knit_mem_stats_alloc(&knit->mstats, sz)
-    #define KMEMSTAT_FREE(knit, sz)                  knit_mem_stats_free(&knit->mstats, sz)
-    #define KMEMSTAT_REALLOC(knit, prev_sz, new_sz)  knit_mem_stats_realloc(&knit->mstats, prev_sz, new_sz)
+#ifdef KNIT_MEM_PROFILE
+    #define KMEMSTAT_ALLOC(knit, sz)        knit_mem_stats_alloc(knit, &knit->mstats, sz)
+    #define KMEMSTAT_FREE(knit)             knit_mem_stats_free(knit, &knit->mstats)
+    #define KMEMSTAT_REALLOC(knit, new_sz)  knit_mem_stats_realloc(knit, &knit->mstats, new_sz)
 #else
-    #define KMEMSTAT_ALLOC(knit, sz) 
-    #define KMEMSTAT_FREE(knit, sz)  
-    #define KMEMSTAT_REALLOC(knit, prev_sz, new_sz)  
+    #define KMEMSTAT_ALLOC(knit, sz)
+    #define KMEMSTAT_FREE(knit)
+    #define KMEMSTAT_REALLOC(knit, new_sz)
 #endif
 
 #endif
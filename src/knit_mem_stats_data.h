@@ -1,7 +1,27 @@
 
+//one frame of a sampled call stack
+struct knit_mem_prof_frame {
+    const void *fn; //struct knit_block * for knit functions, struct knit_cfunc * for c functions
+    int ip;         //-1 for c functions
+};
+#include "knit_memprof_frame_darray.h"
+
+struct knit_mem_prof_sample {
+    size_t bytes;     //the number of bytes this sample stands for (a multiple of the sampling interval)
+    int frames_begin; //index of the outermost frame in knit_mem_stats.frames
+    int nframes;
+};
+#include "knit_memprof_sample_darray.h"
+
 struct knit_mem_stats {
     size_t allocations;
     size_t frees;
     size_t reallocations;
-    size_t total_now;
-};
\ No newline at end of file
+    size_t total_allocated; //cumulative, sizes of freed blocks aren't known
+
+    int have_stack; //set once the exec state is initialized, allocations made before that have no stack
+    long long sample_interval;
+    long long until_sample; //bytes left before the next sample is taken
+    struct knit_memprof_frame_darray frames;
+    struct knit_memprof_sample_darray samples;
+};
@@ -0,0 +1,319 @@
+#ifndef KNIT_OPT_H
+#define KNIT_OPT_H
+#include <string.h>
+#include <limits.h>
+
+#include "kdata.h"
+#include "knit_util.h"
+
+/*
+Optimization passes over the instructions of a compiled block, they run once the block is complete (every jump
+is patched) and before it is packed.
+
+The peephole pass rewrites short windows of instructions and repeats until nothing changes:
+    KNOT KTEST                      -> KTESTNOT
+    KTESTNOT KJMPTRUE/KJMPFALSE L   -> KTEST KJMPFALSE/KJMPTRUE L   (last_cond isn't read after the jump)
+    (KPUSH|KLLOAD|KCLOAD|KEMIT) KPOP n   -> KPOP n-1 (nothing when n is 1)
+    (KPUSH|KLLOAD|KCLOAD|KEMIT) KTEST    -> nothing                  (last_cond isn't read after it)
+    KPOP a KPOP b                   -> KPOP a+b
+    KLLOAD i KLSTORE i              -> nothing
+    jumps to jumps                  -> jumps to the final target, a KJMP to a KRET becomes the KRET
+    jumps to the next instruction   -> nothing
+    the KRET ending every block     -> nothing when it can't be reached
+    (KEMIT|KCLOAD) KTEST KJMPTRUE/KJMPFALSE L -> KJMP L or nothing, the condition is known
+Only the first instruction of a window may be a jump target. Deleted instructions are then dropped and the jump
+targets relocated, a jump to a deleted instruction lands on the one that followed it.
+
+The dead code pass splits the block into basic blocks (a jump target, or the instruction after a jump or a KRET
+starts one), walks them from the entry following jumps and fall throughs, and drops the ones it doesn't reach:
+code after a return, branches of an if on a constant condition. Constants no KCLOAD refers to anymore are then
+dropped from block->constants, function literals among them are destroyed (they aren't gc objects, the block that
+loads them owns them).
+
+knit_opt_block() runs both until nothing changes.
+
+The last condition (knit->ex.last_cond) is set by the test instructions and read by the conditional jumps and
+KSAVETEST, it stays set across jumps so the conditions of `and`/`or` are tested once by the statement using them.
+*/
+
+#define KNIT_OPT_DELETED 0 //not an instruction, marks the ones to drop
+
+static void knit_kfunc_destroy(struct knit *knit, struct knit_kfunc *kfunc); //fwd
+#define KNIT_OPT_MAX_HOPS 16
+
+static int knit_opt_is_jump(int op) {
+    return op == KJMP || op == KJMPTRUE || op == KJMPFALSE;
+}
+//pushes a value without side effects
+static int knit_opt_is_pure_push(int op) {
+    return op == KPUSH || op == KLLOAD || op == KCLOAD || op == KEMIT;
+}
+//1 if last_cond is overwritten before it can be read when execution continues at addr
+static int knit_opt_cond_dead(const struct knit_insn *insns, int len, int addr) {
+    for (int hops=0; hops < KNIT_OPT_MAX_HOPS * 4; hops++) {
+        if (addr >= len)
+            return 1;
+        switch (insns[addr].insn_type) {
+            case KTESTEQ: case KTESTNEQ: case KTESTGT: case KTESTLT: case KTESTGTEQ: case KTESTLTEQ:
+            case KTEST: case KTESTNOT: case KNOT:
+            case KITER_NEXT: case KFORPREP: case KFORLOOP:
+            case KRET:
+                return 1;
+            case KJMPTRUE: case KJMPFALSE: case KSAVETEST:
+            case KCALL: //C functions leave it alone, be conservative
+                return 0;
+            case KJMP:
+                addr = insns[addr].op1;
+                break;
+            default:
+                addr++;
+                break;
+        }
+    }
+    return 0;
+}
+//final destination of the jump at addr, conditional jumps also pass through conditional ones testing the same value
+static int knit_opt_jump_dest(const struct knit_insn *insns, int len, int addr) {
+    int op = insns[addr].insn_type;
+    int dest = insns[addr].op1;
+    for (int hops=0; hops < KNIT_OPT_MAX_HOPS && dest < len && dest != addr; hops++) {
+        int dop = insns[dest].insn_type;
+        if (dop == KJMP || (dop == op && op != KJMP))
+            dest = insns[dest].op1;
+        else if (op != KJMP && knit_opt_is_jump(dop)) //the opposite conditional jump, which isn't taken
+            dest = dest + 1;
+        else
+            break;
+    }
+    return dest;
+}
+
+//rewrites the windows starting in one pass over the block, *changed is set if any was
+static void knit_opt_peephole_round(struct knit_block *block, char *is_target, int *changed) {
+    struct knit_insn *insns = block->insns.data;
+    int len = block->insns.len;
+    memset(is_target, 0, len + 1);
+    for (int i=0; i<len; i++) {
+        if (knit_opt_is_jump(insns[i].insn_type)) {
+            knit_assert_h(insns[i].op1 >= 0 && insns[i].op1 <= len, "unpatched jump");
+            is_target[insns[i].op1] = 1;
+        }
+    }
+    for (int i=0; i<len; i++) {
+        struct knit_insn *a = &insns[i];
+        struct knit_insn *b = i + 1 < len && !is_target[i + 1] ? &insns[i + 1] : NULL;
+        int op = a->insn_type;
+        if (knit_opt_is_jump(op)) {
+            int dest = knit_opt_jump_dest(insns, len, i);
+            if (dest == i + 1) {
+                a->insn_type = KNIT_OPT_DELETED;
+                *changed = 1;
+            }
+            else if (op == KJMP && dest < len && insns[dest].insn_type == KRET) {
+                *a = insns[dest];
+                *changed = 1;
+            }
+            else if (dest != a->op1) {
+                a->op1 = dest;
+                is_target[dest] = 1;
+                *changed = 1;
+            }
+        }
+        else if ((op == KEMIT || op == KCLOAD) && b && b->insn_type == KTEST && i + 2 < len && !is_target[i + 2] &&
+                 (insns[i + 2].insn_type == KJMPTRUE || insns[i + 2].insn_type == KJMPFALSE))
+        {
+            struct knit_insn *c = &insns[i + 2];
+            int truth = op == KEMIT ? a->op1 == KEMTRUE : (block->constants.data[a->op1]->u.ktype != KNIT_NULL &&
+                                                           block->constants.data[a->op1]->u.ktype != KNIT_FALSE);
+            int taken = (c->insn_type == KJMPTRUE) == truth;
+            if (knit_opt_cond_dead(insns, len, taken ? c->op1 : i + 3)) {
+                a->insn_type = KNIT_OPT_DELETED;
+                b->insn_type = KNIT_OPT_DELETED;
+                if (taken)
+                    c->insn_type = KJMP;
+                else
+                    c->insn_type = KNIT_OPT_DELETED;
+                *changed = 1;
+                i += 2;
+            }
+        }
+        else if (op == KNOT && b && b->insn_type == KTEST) {
+            a->insn_type = KTESTNOT;
+            b->insn_type = KNIT_OPT_DELETED;
+            *changed = 1;
+            i++;
+        }
+        else if (op == KTESTNOT && b && (b->insn_type == KJMPTRUE || b->insn_type == KJMPFALSE) &&
+                 knit_opt_cond_dead(insns, len, b->op1) && knit_opt_cond_dead(insns, len, i + 2))
+        {
+            a->insn_type = KTEST;
+            b->insn_type = b->insn_type == KJMPTRUE ? KJMPFALSE : KJMPTRUE;
+            *changed = 1;
+            i++;
+        }
+        else if (knit_opt_is_pure_push(op) && b && b->insn_type == KPOP) {
+            a->insn_type = KNIT_OPT_DELETED;
+            if (b->op1 == 1)
+                b->insn_type = KNIT_OPT_DELETED;
+            else
+                b->op1--;
+            *changed = 1;
+            i++;
+        }
+        else if (knit_opt_is_pure_push(op) && b && b->insn_type == KTEST && knit_opt_cond_dead(insns, len, i + 2)) {
+            a->insn_type = KNIT_OPT_DELETED;
+            b->insn_type = KNIT_OPT_DELETED;
+            *changed = 1;
+            i++;
+        }
+        else if (op == KPOP && b && b->insn_type == KPOP && a->op1 + b->op1 <= SHRT_MAX) {
+            a->op1 += b->op1;
+            b->insn_type = KNIT_OPT_DELETED;
+            *changed = 1;
+            i++;
+        }
+        else if (op == KLLOAD && b && b->insn_type == KLSTORE && a->op1 == b->op1) {
+            a->insn_type = KNIT_OPT_DELETED;
+            b->insn_type = KNIT_OPT_DELETED;
+            *changed = 1;
+            i++;
+        }
+        else if (op == KRET && i == len - 1 && i > 0 && !is_target[i] &&
+                 (insns[i - 1].insn_type == KRET || insns[i - 1].insn_type == KJMP))
+        {
+            a->insn_type = KNIT_OPT_DELETED;
+            *changed = 1;
+        }
+    }
+}
+//drops the deleted instructions and relocates the jumps, addrs has room for len + 1 ints
+static int knit_opt_compact(struct knit_insn *insns, int len, int *addrs) {
+    int n = 0;
+    for (int i=0; i<len; i++) {
+        addrs[i] = n;
+        if (insns[i].insn_type != KNIT_OPT_DELETED)
+            n++;
+    }
+    addrs[len] = n;
+    n = 0;
+    for (int i=0; i<len; i++) {
+        if (insns[i].insn_type == KNIT_OPT_DELETED)
+            continue;
+        insns[n] = insns[i];
+        if (knit_opt_is_jump(insns[n].insn_type))
+            insns[n].op1 = addrs[insns[n].op1];
+        n++;
+    }
+    return n;
+}
+//marks the instructions no path from the entry reaches as deleted, *changed is set if there were any
+//reached and stack have room for len + 1 elements
+static void knit_opt_dead_code_round(struct knit_block *block, char *reached, int *stack, int *changed) {
+    struct knit_insn *insns = block->insns.data;
+    int len = block->insns.len;
+    memset(reached, 0, len + 1);
+    int n = 0;
+    stack[n++] = 0;
+    reached[0] = 1;
+    while (n) {
+        //walk a basic block, its successors are pushed once
+        for (int i = stack[--n]; i < len; i++) {
+            int op = insns[i].insn_type;
+            if (knit_opt_is_jump(op) && !reached[insns[i].op1]) {
+                reached[insns[i].op1] = 1;
+                stack[n++] = insns[i].op1;
+            }
+            if (op == KJMP || op == KRET)
+                break;
+            if (reached[i + 1]) //falls through into a block already walked
+                break;
+            reached[i + 1] = 1;
+        }
+    }
+    for (int i=0; i<len; i++) {
+        if (!reached[i]) {
+            insns[i].insn_type = KNIT_OPT_DELETED;
+            *changed = 1;
+        }
+    }
+}
+//1 if constants[i] is a function literal that none of constants[0..i-1] already refers to
+static int knit_opt_is_first_kfunc(struct knit_obj **constants, int i) {
+    if (constants[i]->u.ktype != KNIT_KFUNC)
+        return 0;
+    for (int j=0; j<i; j++) {
+        if (constants[j] == constants[i])
+            return 0;
+    }
+    return 1;
+}
+//destroys a function literal no instruction can load anymore and the ones nested in it
+static void knit_opt_destroy_kfunc(struct knit *knit, struct knit_kfunc *kfunc) {
+    struct knit_obj **constants = kfunc->block.constants.data;
+    for (int i=0; i<kfunc->block.constants.len; i++) {
+        if (knit_opt_is_first_kfunc(constants, i))
+            knit_opt_destroy_kfunc(knit, &constants[i]->u.kfunc);
+    }
+    knit_kfunc_destroy(knit, kfunc);
+}
+//drops the constants no KCLOAD loads, addrs has room for block->constants.len ints
+static void knit_opt_drop_constants(struct knit *knit, struct knit_block *block, int *addrs) {
+    int nconstants = block->constants.len;
+    for (int i=0; i<nconstants; i++)
+        addrs[i] = -1;
+    for (int i=0; i<block->insns.len; i++) {
+        if (block->insns.data[i].insn_type == KCLOAD)
+            addrs[block->insns.data[i].op1] = 0;
+    }
+    //a function literal is destroyed once, and only when no kept constant refers to it
+    struct knit_obj **constants = block->constants.data;
+    for (int i=0; i<nconstants; i++) {
+        if (addrs[i] >= 0 || !knit_opt_is_first_kfunc(constants, i))
+            continue;
+        int kept = 0;
+        for (int j=i+1; j<nconstants && !kept; j++)
+            kept = addrs[j] >= 0 && constants[j] == constants[i];
+        if (!kept)
+            knit_opt_destroy_kfunc(knit, &constants[i]->u.kfunc);
+    }
+    int n = 0;
+    for (int i=0; i<nconstants; i++) {
+        if (addrs[i] < 0)
+            continue;
+        addrs[i] = n;
+        block->constants.data[n++] = block->constants.data[i];
+    }
+    block->constants.len = n;
+    for (int i=0; i<block->insns.len; i++) {
+        if (block->insns.data[i].insn_type == KCLOAD)
+            block->insns.data[i].op1 = addrs[block->insns.data[i].op1];
+    }
+}
+static int knit_opt_block(struct knit *knit, struct knit_block *block) {
+    knit_assert_h(!block->packed, "");
+    int len = block->insns.len;
+    if (!len)
+        return KNIT_OK;
+    int scratch_len = len > block->constants.len ? len : block->constants.len;
+    size_t scratch_sz = (scratch_len + 1) * (2 * sizeof(int) + 1);
+    void *p = NULL;
+    int rv = knitx_tmalloc(knit, scratch_sz, &p);
+    if (rv != KNIT_OK)
+        return rv;
+    int *addrs = p;
+    int *stack = addrs + scratch_len + 1;
+    char *marks = (char *) (stack + scratch_len + 1);
+    int changed = 1;
+    while (changed) {
+        changed = 0;
+        knit_opt_peephole_round(block, marks, &changed);
+        block->insns.len = knit_opt_compact(block->insns.data, block->insns.len, addrs);
+        knit_opt_dead_code_round(block, marks, stack, &changed);
+        block->insns.len = knit_opt_compact(block->insns.data, block->insns.len, addrs);
+    }
+    knit_opt_drop_constants(knit, block, addrs);
+    knitx_tfree(knit, p, scratch_sz);
+    return KNIT_OK;
+}
+
+#endif //KNIT_OPT_H
@@ -0,0 +1,174 @@
+#ifndef KNIT_QUEUE_H
+#define KNIT_QUEUE_H
+#include <string.h>
+
+#include "kdata.h"
+#include "knit_util.h"
+#include "knit_sort.h"
+
+/*
+The containers behind deque() and heap()
+
+deques are ring buffers, the i-th item is items[(head + i) & (cap - 1)], cap is 0 or a power of 2 and doubles when
+the deque is full, so pushing and popping at both ends is O(1) amortized.
+
+heaps are binary min-heaps stored in an array, entries[0] has the smallest key. The key of an item is the item
+itself, or what the key function given to heap(key) returned for it (it is called once, when the item is pushed).
+Keys are compared natively, they must be all ints or all strings (compared bytewise like sort() does), the first
+key pushed into an empty heap decides which.
+*/
+
+static int knit_error(struct knit *knit, int err_type, const char *fmt, ...); //fwd
+static int knitx_str_flatten(struct knit *knit, struct knit_str *str); //fwd
+
+static void knit_deque_init(struct knit_deque *dq) {
+    dq->ktype = KNIT_DEQUE;
+    dq->items = NULL;
+    dq->head = 0;
+    dq->len = 0;
+    dq->cap = 0;
+}
+static void knit_deque_deinit(struct knit *knit, struct knit_deque *dq) {
+    if (dq->items)
+        knitx_slab_free(knit, dq->items, sizeof(struct knit_obj *) * dq->cap);
+    dq->items = NULL;
+    dq->len = dq->cap = dq->head = 0;
+}
+static struct knit_obj *knit_deque_at(struct knit_deque *dq, int i) {
+    knit_assert_h(i >= 0 && i < dq->len, "");
+    return dq->items[(dq->head + i) & (dq->cap - 1)];
+}
+//doubles the capacity, the items are unwrapped so head becomes 0
+static int knit_deque_grow(struct knit *knit, struct knit_deque *dq) {
+    int new_cap = dq->cap ? dq->cap * 2 : 8;
+    void *p = NULL;
+    int rv = knitx_slab_alloc(knit, sizeof(struct knit_obj *) * new_cap, &p);
+    if (rv != KNIT_OK)
+        return rv;
+    struct knit_obj **items = p;
+    if (dq->len) {
+        int first = dq->cap - dq->head < dq->len ? dq->cap - dq->head : dq->len;
+        memcpy(items, dq->items + dq->head, sizeof(struct knit_obj *) * first);
+        memcpy(items + first, dq->items, sizeof(struct knit_obj *) * (dq->len - first));
+    }
+    if (dq->items)
+        knitx_slab_free(knit, dq->items, sizeof(struct knit_obj *) * dq->cap);
+    dq->items = items;
+    dq->cap = new_cap;
+    dq->head = 0;
+    return KNIT_OK;
+}
+static int knit_deque_push(struct knit *knit, struct knit_deque *dq, struct knit_obj *obj, int front) {
+    if (dq->len == dq->cap) {
+        int rv = knit_deque_grow(knit, dq);
+        if (rv != KNIT_OK)
+            return rv;
+    }
+    if (front) {
+        dq->head = (dq->head - 1) & (dq->cap - 1);
+        dq->items[dq->head] = obj;
+    }
+    else {
+        dq->items[(dq->head + dq->len) & (dq->cap - 1)] = obj;
+    }
+    dq->len++;
+    return KNIT_OK;
+}
+//the deque must not be empty
+static struct knit_obj *knit_deque_pop(struct knit_deque *dq, int front) {
+    knit_assert_h(dq->len > 0, "");
+    struct knit_obj *obj;
+    if (front) {
+        obj = dq->items[dq->head];
+        dq->head = (dq->head + 1) & (dq->cap - 1);
+    }
+    else {
+        obj = dq->items[(dq->head + dq->len - 1) & (dq->cap - 1)];
+    }
+    dq->len--;
+    return obj;
+}
+
+static void knit_pqueue_init(struct knit_pqueue *pq, struct knit_obj *key_func) {
+    pq->ktype = KNIT_PQUEUE;
+    pq->entries = NULL;
+    pq->len = 0;
+    pq->cap = 0;
+    pq->key_type = 0;
+    pq->key_func = key_func;
+}
+static void knit_pqueue_deinit(struct knit *knit, struct knit_pqueue *pq) {
+    if (pq->entries)
+        knitx_slab_free(knit, pq->entries, sizeof(struct knit_pqueue_entry) * pq->cap);
+    pq->entries = NULL;
+    pq->len = pq->cap = 0;
+}
+static int knit_pqueue_less(const struct knit_pqueue *pq, const struct knit_pqueue_entry *a, const struct knit_pqueue_entry *b) {
+    if (pq->key_type == KNIT_INT)
+        return a->key->u.integer.value < b->key->u.integer.value;
+    return knit_sort_strcmp(&a->key->u.str, &b->key->u.str) < 0;
+}
+static void knit_pqueue_sift_up(struct knit_pqueue *pq, int i) {
+    struct knit_pqueue_entry e = pq->entries[i];
+    while (i > 0) {
+        int parent = (i - 1) / 2;
+        if (!knit_pqueue_less(pq, &e, &pq->entries[parent]))
+            break;
+        pq->entries[i] = pq->entries[parent];
+        i = parent;
+    }
+    pq->entries[i] = e;
+}
+static void knit_pqueue_sift_down(struct knit_pqueue *pq, int i) {
+    struct knit_pqueue_entry e = pq->entries[i];
+    for (;;) {
+        int child = 2 * i + 1;
+        if (child >= pq->len)
+            break;
+        if (child + 1 < pq->len && knit_pqueue_less(pq, &pq->entries[child + 1], &pq->entries[child]))
+            child++;
+        if (!knit_pqueue_less(pq, &pq->entries[child], &e))
+            break;
+        pq->entries[i] = pq->entries[child];
+        i = child;
+    }
+    pq->entries[i] = e;
+}
+//key is item when the heap has no key function
+static int knit_pqueue_push(struct knit *knit, struct knit_pqueue *pq, struct knit_obj *item, struct knit_obj *key) {
+    int type = key->u.ktype;
+    if (type != KNIT_INT && type != KNIT_STR)
+        return knit_error(knit, KNIT_INVALID_TYPE_ERR, "heap keys must be ints or strings");
+    if (pq->len && type != pq->key_type)
+        return knit_error(knit, KNIT_INVALID_TYPE_ERR, "heap keys must be all ints or all strings");
+    if (type == KNIT_STR) {
+        int rv = knitx_str_flatten(knit, &key->u.str);
+        if (rv != KNIT_OK)
+            return rv;
+    }
+    if (pq->len == pq->cap) {
+        int new_cap = pq->cap ? pq->cap * 2 : 8;
+        void *p = NULL;
+        int rv = knitx_slab_realloc(knit, pq->entries, sizeof(struct knit_pqueue_entry) * pq->cap, sizeof(struct knit_pqueue_entry) * new_cap, &p);
+        if (rv != KNIT_OK)
+            return rv;
+        pq->entries = p;
+        pq->cap = new_cap;
+    }
+    pq->key_type = type;
+    pq->entries[pq->len].item = item;
+    pq->entries[pq->len].key = key;
+    knit_pqueue_sift_up(pq, pq->len++);
+    return KNIT_OK;
+}
+//removes and returns the item with the smallest key, the heap must not be empty
+static struct knit_obj *knit_pqueue_pop(struct knit_pqueue *pq) {
+    knit_assert_h(pq->len > 0, "");
+    struct knit_obj *item = pq->entries[0].item;
+    pq->entries[0] = pq->entries[--pq->len];
+    if (pq->len)
+        knit_pqueue_sift_down(pq, 0);
+    return item;
+}
+
+#endif //KNIT_QUEUE_H
@@ -0,0 +1,498 @@
+#ifndef KNIT_SET_H
+#define KNIT_SET_H
+#include <limits.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "kdata.h"
+#include "knit_util.h"
+#include "knit_dict.h"
+#include "knit_bitset.h"
+
+/*
+The table behind set(). Elements can be ints and strings like dict keys, they are hashed, compared and copied the
+same way, but a set has two representations:
+
+KNIT_SET_HASH is the dict's probing scheme (see knit_dict.h) without the entries array: slots[i] is the element of
+slot i and ctrl[i] its h2. Elements can be removed, the slot then becomes KNIT_SET_DELETED: a probe for an element
+goes on past it (it only stops at groups with an empty slot) and an insert can reuse it. Deleted slots count against
+the load factor until the table is resized.
+
+KNIT_SET_BITMAP holds ints only, bit i is the int base + i. A set starts as an empty bitmap and stays one while its
+ints are dense enough: while the bitmap spans at most KNIT_SET_BITMAP_MIN_SPAN ints or 32 ints per element (a hash
+slot costs 9 bytes and ints are boxed). Adding a string or an int that would make it too sparse moves the elements
+to a hash table, and a table of ints only goes back to a bitmap when it has to grow and its ints are dense again.
+Bitmap elements aren't objects, they are boxed when they are handed out.
+
+union(), intersection() and difference() build a new set in one pass over their operands, with word operations
+on the bitmaps when both are bitmaps.
+*/
+
+#define KNIT_SET_DELETED ((signed char) -2)
+#define KNIT_SET_BITMAP_MIN_SPAN 1024
+
+static int knitx_dict_key_for_insert(struct knit *knit, struct knit_obj *key, struct knit_obj **key_out); //fwd
+static int knit_error(struct knit *knit, int err_type, const char *fmt, ...); //fwd
+static int knitx_int_init(struct knit *knit, struct knit_int *integer, int value); //fwd
+static int knitx_int_new_gcobj(struct knit *knit, struct knit_int **integerp_out, int value); //fwd
+
+static int knit_set_dense(long long len, long long span) {
+    return span <= KNIT_SET_BITMAP_MIN_SPAN || span <= 32 * len;
+}
+//rounds down to a multiple of 64
+static long long knit_set_floor64(long long v) {
+    return v & ~63LL;
+}
+static long long knit_set_bitmap_end(const struct knit_set *set) {
+    return set->base + (long long) set->bits.bit_len;
+}
+
+static void knit_set_init(struct knit_set *set) {
+    set->ktype = KNIT_SET;
+    set->mode = KNIT_SET_BITMAP;
+    set->len = 0;
+    set->cap = 0;
+    set->used = 0;
+    set->slots = NULL;
+    set->ctrl = NULL;
+    set->base = 0;
+    set->bits.data = NULL;
+    set->bits.bit_len = 0;
+}
+//the slots and the control bytes share one allocation
+static size_t knit_set_alloc_size(int cap) {
+    return (size_t) cap * (sizeof(struct knit_obj *) + 1);
+}
+static void knit_set_free_table(struct knit *knit, struct knit_set *set) {
+    if (set->cap)
+        knitx_rfree(knit, set->slots, knit_set_alloc_size(set->cap));
+    set->slots = NULL;
+    set->ctrl = NULL;
+    set->cap = set->used = 0;
+}
+static void knit_set_free_bitmap(struct knit *knit, struct knit_set *set) {
+    if (set->bits.data)
+        knitx_rfree(knit, set->bits.data, bitset_nbytes(set->bits.bit_len));
+    set->bits.data = NULL;
+    set->bits.bit_len = 0;
+    set->base = 0;
+}
+static void knit_set_deinit(struct knit *knit, struct knit_set *set) {
+    knit_set_free_table(knit, set);
+    knit_set_free_bitmap(knit, set);
+    set->len = 0;
+    set->mode = KNIT_SET_BITMAP;
+}
+
+static int knit_set_check_elem(struct knit *knit, struct knit_obj *obj) {
+    if (obj->u.ktype != KNIT_INT && obj->u.ktype != KNIT_STR)
+        return knit_error(knit, KNIT_INVALID_TYPE_ERR, "set elements must be ints or strings, not %s", knitx_obj_type_name(knit, obj));
+    return KNIT_OK;
+}
+
+static int knit_set_bitmap_has(const struct knit_set *set, int v) {
+    if (v < set->base || v >= knit_set_bitmap_end(set))
+        return 0;
+    return bitset_get_bit((struct knit_bitset *) &set->bits, (size_t) ((long long) v - set->base));
+}
+
+//moves the bitmap to the range [lo, hi) which must contain the current one, both are multiples of 64
+static int knit_set_bitmap_cover(struct knit *knit, struct knit_set *set, long long lo, long long hi) {
+    size_t bit_len = (size_t) (hi - lo);
+    void *p = NULL;
+    int rv = knitx_rmalloc(knit, bitset_nbytes(bit_len), &p);
+    if (rv != KNIT_OK)
+        return rv;
+    memset(p, 0, bitset_nbytes(bit_len));
+    if (set->bits.bit_len)
+        memcpy((knit_bitset_word *) p + (set->base - lo) / 64, set->bits.data, bitset_nbytes(set->bits.bit_len));
+    knit_set_free_bitmap(knit, set);
+    set->bits.data = p;
+    set->bits.bit_len = bit_len;
+    set->base = (int) lo;
+    return KNIT_OK;
+}
+
+//adds v to a bitmap set, *fits is set to 0 (and the set is left untouched) if the bitmap would get too sparse.
+//the range grows geometrically when that stays dense, so adding consecutive ints doesn't copy the bitmap every 64
+static int knit_set_bitmap_add(struct knit *knit, struct knit_set *set, int v, int *fits) {
+    long long lo = set->base, hi = knit_set_bitmap_end(set);
+    if (!set->bits.bit_len || v < lo || v >= hi) {
+        long long vlo = knit_set_floor64(v);
+        if (!set->bits.bit_len) {
+            lo = vlo;
+            hi = vlo + 64;
+        }
+        else if (vlo < lo) {
+            lo = vlo;
+        }
+        else {
+            hi = vlo + 64;
+        }
+        if (!knit_set_dense(set->len + 1, hi - lo)) {
+            *fits = 0;
+            return KNIT_OK;
+        }
+        long long span = set->bits.bit_len;
+        if (span && v < set->base && set->base - span < lo && knit_set_dense(set->len + 1, hi - (set->base - span)))
+            lo = set->base - span < INT_MIN ? INT_MIN : set->base - span;
+        else if (span && v >= set->base && knit_set_bitmap_end(set) + span > hi && knit_set_dense(set->len + 1, knit_set_bitmap_end(set) + span - lo))
+            hi = knit_set_bitmap_end(set) + span > (long long) INT_MAX + 1 ? (long long) INT_MAX + 1 : knit_set_bitmap_end(set) + span;
+        int rv = knit_set_bitmap_cover(knit, set, lo, hi);
+        if (rv != KNIT_OK)
+            return rv;
+    }
+    *fits = 1;
+    size_t bit = (size_t) ((long long) v - set->base);
+    if (!bitset_get_bit(&set->bits, bit)) {
+        bitset_set_bit(&set->bits, bit, 1);
+        set->len++;
+    }
+    return KNIT_OK;
+}
+
+//the slot of key, -1 if it isn't in the table
+static int knit_set_hash_find(struct knit *knit, struct knit_set *set, struct knit_obj *key, uint64_t hash) {
+    if (!set->cap)
+        return -1;
+    size_t groups_mask = set->cap / KNIT_DICT_GROUP_SZ - 1;
+    size_t g = (hash >> 7) & groups_mask;
+    signed char h2 = hash & 0x7f;
+    for (size_t stride = 1; ; stride++) {
+        const signed char *group = set->ctrl + g * KNIT_DICT_GROUP_SZ;
+        unsigned match = knit_dict_group_match(group, h2);
+        while (match) {
+            int idx = g * KNIT_DICT_GROUP_SZ + knit_dict_ctz(match);
+            if (knit_dict_key_eq(knit, set->slots[idx], key))
+                return idx;
+            match &= match - 1;
+        }
+        //deleted slots don't end the probe
+        if (knit_dict_group_match(group, KNIT_DICT_EMPTY))
+            return -1;
+        g = (g + stride) & groups_mask;
+    }
+}
+
+//stores key in the first empty or deleted slot of its probe sequence, the table must have room for it
+static void knit_set_hash_put(struct knit_set *set, struct knit_obj *key, uint64_t hash) {
+    size_t groups_mask = set->cap / KNIT_DICT_GROUP_SZ - 1;
+    size_t g = (hash >> 7) & groups_mask;
+    for (size_t stride = 1; ; stride++) {
+        unsigned free_slots = knit_dict_group_match_empty(set->ctrl + g * KNIT_DICT_GROUP_SZ);
+        if (free_slots) {
+            int idx = g * KNIT_DICT_GROUP_SZ + knit_dict_ctz(free_slots);
+            if (set->ctrl[idx] == KNIT_DICT_EMPTY)
+                set->used++;
+            set->ctrl[idx] = hash & 0x7f;
+            set->slots[idx] = key;
+            set->len++;
+            return;
+        }
+        g = (g + stride) & groups_mask;
+    }
+}
+
+//reallocates the table with new_cap slots and drops the deleted ones, the set is left untouched if the allocation fails
+static int knit_set_hash_resize(struct knit *knit, struct knit_set *set, int new_cap) {
+    void *p = NULL;
+    int rv = knitx_rmalloc(knit, knit_set_alloc_size(new_cap), &p);
+    if (rv != KNIT_OK)
+        return rv;
+    struct knit_obj **old_slots = set->slots;
+    signed char *old_ctrl = set->ctrl;
+    int old_cap = set->cap;
+    set->slots = p;
+    set->ctrl = (signed char *) (set->slots + new_cap);
+    set->cap = new_cap;
+    set->len = set->used = 0;
+    memset(set->ctrl, KNIT_DICT_EMPTY, new_cap);
+    for (int i=0; i<old_cap; i++) {
+        if (old_ctrl[i] < 0)
+            continue;
+        uint64_t hash = 0;
+        //elements were hashed when they were added, this can't fail
+        knit_dict_hash(knit, old_slots[i], &hash);
+        knit_set_hash_put(set, old_slots[i], hash);
+    }
+    if (old_cap)
+        knitx_rfree(knit, old_slots, knit_set_alloc_size(old_cap));
+    return KNIT_OK;
+}
+
+//moves the elements of a bitmap set to a table with room for at least min_len of them. the ints get boxed, the boxes
+//are rooted by the gc nursery until the table is attached to the set (the set is walked as a bitmap until then)
+static int knit_set_to_hash(struct knit *knit, struct knit_set *set, int min_len) {
+    struct knit_set table;
+    knit_set_init(&table);
+    table.mode = KNIT_SET_HASH;
+    int rv = knit_set_hash_resize(knit, &table, knit_dict_cap_for(min_len > set->len ? min_len : set->len));
+    if (rv != KNIT_OK)
+        return rv;
+    for (long bit = bitset_find_true_bit(&set->bits, 0); bit >= 0; bit = bitset_find_true_bit(&set->bits, bit + 1)) {
+        struct knit_int *boxed = NULL;
+        rv = knitx_int_new_gcobj(knit, &boxed, (int) (set->base + bit));
+        if (rv != KNIT_OK) {
+            knit_set_free_table(knit, &table);
+            return rv;
+        }
+        uint64_t hash = 0;
+        knit_dict_hash(knit, (struct knit_obj *) boxed, &hash);
+        knit_set_hash_put(&table, (struct knit_obj *) boxed, hash);
+    }
+    knit_set_free_bitmap(knit, set);
+    set->mode = KNIT_SET_HASH;
+    set->cap = table.cap;
+    set->used = table.used;
+    set->slots = table.slots;
+    set->ctrl = table.ctrl;
+    return KNIT_OK;
+}
+
+//moves the elements of a table of ints to a bitmap spanning [lo, hi)
+static int knit_set_to_bitmap(struct knit *knit, struct knit_set *set, long long lo, long long hi) {
+    size_t bit_len = (size_t) (hi - lo);
+    void *p = NULL;
+    int rv = knitx_rmalloc(knit, bitset_nbytes(bit_len), &p);
+    if (rv != KNIT_OK)
+        return rv;
+    memset(p, 0, bitset_nbytes(bit_len));
+    struct knit_bitset bits = {p, bit_len};
+    for (int i=0; i<set->cap; i++) {
+        if (set->ctrl[i] >= 0)
+            bitset_set_bit(&bits, (size_t) (set->slots[i]->u.integer.value - lo), 1);
+    }
+    knit_set_free_table(knit, set);
+    set->mode = KNIT_SET_BITMAP;
+    set->base = (int) lo;
+    set->bits = bits;
+    return KNIT_OK;
+}
+
+//called when the table is full, makes room for key. the table goes back to a bitmap when it only
+//holds ints (counting key) that are dense enough
+static int knit_set_hash_grow(struct knit *knit, struct knit_set *set, struct knit_obj *key) {
+    int ints_only = key->u.ktype == KNIT_INT;
+    long long lo = ints_only ? key->u.integer.value : 0, hi = lo;
+    for (int i=0; ints_only && i<set->cap; i++) {
+        if (set->ctrl[i] < 0)
+            continue;
+        if (set->slots[i]->u.ktype != KNIT_INT) {
+            ints_only = 0;
+            break;
+        }
+        int v = set->slots[i]->u.integer.value;
+        lo = v < lo ? v : lo;
+        hi = v > hi ? v : hi;
+    }
+    lo = knit_set_floor64(lo);
+    hi = knit_set_floor64(hi) + 64;
+    if (ints_only && knit_set_dense(set->len + 1, hi - lo))
+        return knit_set_to_bitmap(knit, set, lo, hi);
+    return knit_set_hash_resize(knit, set, knit_dict_cap_for(set->len + 1));
+}
+
+static int knit_set_hash_add(struct knit *knit, struct knit_set *set, struct knit_obj *key) {
+    uint64_t hash = 0;
+    int rv = knit_dict_hash(knit, key, &hash);
+    if (rv != KNIT_OK)
+        return rv;
+    if (knit_set_hash_find(knit, set, key, hash) >= 0)
+        return KNIT_OK;
+    if (set->used + 1 > KNIT_DICT_MAX_LEN(set->cap)) {
+        rv = knit_set_hash_grow(knit, set, key);
+        if (rv != KNIT_OK)
+            return rv;
+        if (set->mode == KNIT_SET_BITMAP) {
+            int fits = 0;
+            //the bitmap was sized for key
+            rv = knit_set_bitmap_add(knit, set, key->u.integer.value, &fits);
+            knit_assert_h(rv != KNIT_OK || fits, "");
+            return rv;
+        }
+    }
+    //ints that aren't gc objects are temporaries (e.g. elements of a bitmap being copied), they get boxed
+    struct knit_obj *stored = NULL;
+    if (key->u.ktype == KNIT_INT && !knit_gc_is_gc_object(knit, key)) {
+        struct knit_int *boxed = NULL;
+        rv = knitx_int_new_gcobj(knit, &boxed, key->u.integer.value);
+        stored = (struct knit_obj *) boxed;
+    }
+    else {
+        rv = knitx_dict_key_for_insert(knit, key, &stored);
+    }
+    if (rv != KNIT_OK)
+        return rv;
+    //the copy hashes the same as key
+    knit_set_hash_put(set, stored, hash);
+    return KNIT_OK;
+}
+
+static int knit_set_add(struct knit *knit, struct knit_set *set, struct knit_obj *key) {
+    int rv = knit_set_check_elem(knit, key);
+    if (rv != KNIT_OK)
+        return rv;
+    if (set->mode == KNIT_SET_BITMAP) {
+        if (key->u.ktype == KNIT_INT) {
+            int fits = 0;
+            rv = knit_set_bitmap_add(knit, set, key->u.integer.value, &fits);
+            if (rv != KNIT_OK || fits)
+                return rv;
+        }
+        rv = knit_set_to_hash(knit, set, set->len + 1);
+        if (rv != KNIT_OK)
+            return rv;
+    }
+    return knit_set_hash_add(knit, set, key);
+}
+
+static int knit_set_contains(struct knit *knit, struct knit_set *set, struct knit_obj *key, int *found) {
+    *found = 0;
+    int rv = knit_set_check_elem(knit, key);
+    if (rv != KNIT_OK)
+        return rv;
+    if (set->mode == KNIT_SET_BITMAP) {
+        *found = key->u.ktype == KNIT_INT && knit_set_bitmap_has(set, key->u.integer.value);
+        return KNIT_OK;
+    }
+    uint64_t hash = 0;
+    rv = knit_dict_hash(knit, key, &hash);
+    if (rv != KNIT_OK)
+        return rv;
+    *found = knit_set_hash_find(knit, set, key, hash) >= 0;
+    return KNIT_OK;
+}
+
+//*removed is 0 if key wasn't in the set
+static int knit_set_remove(struct knit *knit, struct knit_set *set, struct knit_obj *key, int *removed) {
+    *removed = 0;
+    int rv = knit_set_check_elem(knit, key);
+    if (rv != KNIT_OK)
+        return rv;
+    if (set->mode == KNIT_SET_BITMAP) {
+        if (key->u.ktype == KNIT_INT && knit_set_bitmap_has(set, key->u.integer.value)) {
+            bitset_set_bit(&set->bits, (size_t) ((long long) key->u.integer.value - set->base), 0);
+            set->len--;
+            *removed = 1;
+        }
+        return KNIT_OK;
+    }
+    uint64_t hash = 0;
+    rv = knit_dict_hash(knit, key, &hash);
+    if (rv != KNIT_OK)
+        return rv;
+    int idx = knit_set_hash_find(knit, set, key, hash);
+    if (idx < 0)
+        return KNIT_OK;
+    set->ctrl[idx] = KNIT_SET_DELETED;
+    set->slots[idx] = NULL;
+    set->len--;
+    *removed = 1;
+    //an emptied set starts over as a bitmap
+    if (!set->len)
+        knit_set_deinit(knit, set);
+    return KNIT_OK;
+}
+
+//the element at or after *pos, 0 when there are no more. tables set *key, bitmaps *int_value (and *key to NULL)
+static int knit_set_next(struct knit_set *set, int *pos, struct knit_obj **key, int *int_value) {
+    *key = NULL;
+    if (set->mode == KNIT_SET_BITMAP) {
+        long bit = bitset_find_true_bit(&set->bits, (size_t) *pos);
+        if (bit < 0)
+            return 0;
+        *pos = (int) bit + 1;
+        *int_value = (int) (set->base + bit);
+        return 1;
+    }
+    while (*pos < set->cap && set->ctrl[*pos] < 0)
+        (*pos)++;
+    if (*pos >= set->cap)
+        return 0;
+    *key = set->slots[(*pos)++];
+    return 1;
+}
+
+//out = a op b on bitmaps (KNIT_BITSET_OR, AND or ANDN) for the range [lo, hi) of out, which must hold the result
+static int knit_set_bitmap_combine(struct knit *knit, struct knit_set *out, struct knit_set *a, struct knit_set *b, int op, long long lo, long long hi) {
+    if (lo >= hi)
+        return KNIT_OK;
+    int rv = knit_set_bitmap_cover(knit, out, lo, hi);
+    if (rv != KNIT_OK)
+        return rv;
+    //the bitmaps are word aligned, ranges are combined as views of whole words
+    long long a_lo = a->base > lo ? a->base : lo;
+    long long a_hi = knit_set_bitmap_end(a) < hi ? knit_set_bitmap_end(a) : hi;
+    if (a_lo < a_hi)
+        memcpy(out->bits.data + (a_lo - lo) / 64, a->bits.data + (a_lo - a->base) / 64, (size_t) (a_hi - a_lo) / 8);
+    long long b_lo = b->base > lo ? b->base : lo;
+    long long b_hi = knit_set_bitmap_end(b) < hi ? knit_set_bitmap_end(b) : hi;
+    if (b_lo < b_hi) {
+        struct knit_bitset out_view = {out->bits.data + (b_lo - lo) / 64, (size_t) (b_hi - b_lo)};
+        struct knit_bitset b_view = {b->bits.data + (b_lo - b->base) / 64, (size_t) (b_hi - b_lo)};
+        bitset_bulk_op(&out_view, &b_view, op);
+    }
+    out->len = (int) bitset_count(&out->bits);
+    return KNIT_OK;
+}
+
+//adds the elements of src to out, only those that are (want_in) or aren't in filter when filter isn't NULL
+static int knit_set_add_all(struct knit *knit, struct knit_set *out, struct knit_set *src, struct knit_set *filter, int want_in) {
+    int pos = 0, v = 0;
+    struct knit_obj *key = NULL;
+    struct knit_int tmp_int;
+    while (knit_set_next(src, &pos, &key, &v)) {
+        if (!key) {
+            knitx_int_init(knit, &tmp_int, v);
+            key = (struct knit_obj *) &tmp_int;
+        }
+        if (filter) {
+            int found = 0;
+            int rv = knit_set_contains(knit, filter, key, &found);
+            if (rv != KNIT_OK)
+                return rv;
+            if (found != want_in)
+                continue;
+        }
+        int rv = knit_set_add(knit, out, key);
+        if (rv != KNIT_OK)
+            return rv;
+    }
+    return KNIT_OK;
+}
+
+//out = a | b, out must be empty
+static int knit_set_union(struct knit *knit, struct knit_set *out, struct knit_set *a, struct knit_set *b) {
+    if (a->mode == KNIT_SET_BITMAP && b->mode == KNIT_SET_BITMAP && a->len && b->len) {
+        long long lo = a->base < b->base ? a->base : b->base;
+        long long hi = knit_set_bitmap_end(a) > knit_set_bitmap_end(b) ? knit_set_bitmap_end(a) : knit_set_bitmap_end(b);
+        if (knit_set_dense(a->len > b->len ? a->len : b->len, hi - lo))
+            return knit_set_bitmap_combine(knit, out, a, b, KNIT_BITSET_OR, lo, hi);
+    }
+    int rv = knit_set_add_all(knit, out, a, NULL, 0);
+    if (rv != KNIT_OK)
+        return rv;
+    return knit_set_add_all(knit, out, b, NULL, 0);
+}
+
+//out = a & b, out must be empty
+static int knit_set_intersection(struct knit *knit, struct knit_set *out, struct knit_set *a, struct knit_set *b) {
+    if (a->mode == KNIT_SET_BITMAP && b->mode == KNIT_SET_BITMAP) {
+        long long lo = a->base > b->base ? a->base : b->base;
+        long long hi = knit_set_bitmap_end(a) < knit_set_bitmap_end(b) ? knit_set_bitmap_end(a) : knit_set_bitmap_end(b);
+        return knit_set_bitmap_combine(knit, out, a, b, KNIT_BITSET_AND, lo, hi);
+    }
+    //the smaller set is iterated
+    if (a->len > b->len)
+        return knit_set_add_all(knit, out, b, a, 1);
+    return knit_set_add_all(knit, out, a, b, 1);
+}
+
+//out = a - b, out must be empty
+static int knit_set_difference(struct knit *knit, struct knit_set *out, struct knit_set *a, struct knit_set *b) {
+    if (a->mode == KNIT_SET_BITMAP && b->mode == KNIT_SET_BITMAP)
+        return knit_set_bitmap_combine(knit, out, a, b, KNIT_BITSET_ANDN, a->base, knit_set_bitmap_end(a));
+    return knit_set_add_all(knit, out, a, b, 0);
+}
+
+#endif //KNIT_SET_H
@@ -0,0 +1,108 @@
+#ifndef KNIT_SORT_H
+#define KNIT_SORT_H
+#include <stdint.h>
+#include <string.h>
+
+#include "kdata.h"
+
+/*
+Sorting routines behind list.sort() and sorted(), both are stable
+
+ints are sorted with an LSD radix sort on 64 bit words whose upper 32 bits are the biased value and whose
+lower 32 bits carry a payload (the original index when a permutation is needed), one pass per byte of
+the value, passes where every element has the same byte are skipped.
+
+strings are sorted with a merge sort of a permutation: runs of KNIT_SORT_RUN elements are sorted by binary
+insertion (cheap compares, few moves) then merged bottom-up, a merge is skipped when its two halves are
+already in order so presorted input is linear.
+*/
+
+#define KNIT_SORT_RUN 32
+
+//maps ints to unsigned values that sort in the same order
+static inline uint32_t knit_sort_int_bias(int v) {
+    return (uint32_t) v ^ 0x80000000u;
+}
+static inline int knit_sort_int_unbias(uint32_t u) {
+    return (int) (u ^ 0x80000000u);
+}
+
+//sorts a[0..n) by their upper 32 bits, tmp must have room for n elements
+static void knit_sort_radix(uint64_t *a, uint64_t *tmp, int n) {
+    uint64_t *src = a, *dst = tmp;
+    for (int shift = 32; shift < 64; shift += 8) {
+        int counts[256] = {0};
+        for (int i=0; i<n; i++)
+            counts[(src[i] >> shift) & 0xff]++;
+        if (n == 0 || counts[(src[0] >> shift) & 0xff] == n)
+            continue;
+        int pos = 0;
+        for (int b=0; b<256; b++) {
+            int c = counts[b];
+            counts[b] = pos;
+            pos += c;
+        }
+        for (int i=0; i<n; i++)
+            dst[counts[(src[i] >> shift) & 0xff]++] = src[i];
+        uint64_t *t = src;
+        src = dst;
+        dst = t;
+    }
+    if (src != a)
+        memcpy(a, src, sizeof(uint64_t) * (size_t) n);
+}
+
+//strings must be flat
+static inline int knit_sort_strcmp(const struct knit_str *a, const struct knit_str *b) {
+    int n = a->len < b->len ? a->len : b->len;
+    int c = memcmp(a->str, b->str, n);
+    if (c)
+        return c;
+    return (a->len > b->len) - (a->len < b->len);
+}
+
+static void knit_sort_strs_insertion(struct knit_str **keys, int *perm, int begin, int end) {
+    for (int i = begin + 1; i < end; i++) {
+        int p = perm[i];
+        struct knit_str *k = keys[p];
+        //the first position whose key is greater than k, so equal keys keep their order
+        int lo = begin, hi = i;
+        while (lo < hi) {
+            int mid = lo + (hi - lo) / 2;
+            if (knit_sort_strcmp(keys[perm[mid]], k) <= 0)
+                lo = mid + 1;
+            else
+                hi = mid;
+        }
+        memmove(perm + lo + 1, perm + lo, sizeof(int) * (size_t) (i - lo));
+        perm[lo] = p;
+    }
+}
+
+//sorts perm[0..n) by keys[perm[i]], tmp must have room for n ints
+static void knit_sort_strs(struct knit_str **keys, int *perm, int *tmp, int n) {
+    for (int begin = 0; begin < n; begin += KNIT_SORT_RUN) {
+        int end = begin + KNIT_SORT_RUN < n ? begin + KNIT_SORT_RUN : n;
+        knit_sort_strs_insertion(keys, perm, begin, end);
+    }
+    for (int width = KNIT_SORT_RUN; width < n; width *= 2) {
+        for (int begin = 0; begin + width < n; begin += 2 * width) {
+            int mid = begin + width;
+            int end = mid + width < n ? mid + width : n;
+            if (knit_sort_strcmp(keys[perm[mid - 1]], keys[perm[mid]]) <= 0)
+                continue;
+            memcpy(tmp + begin, perm + begin, sizeof(int) * (size_t) (mid - begin));
+            int i = begin, j = mid, o = begin;
+            while (i < mid && j < end) {
+                if (knit_sort_strcmp(keys[perm[j]], keys[tmp[i]]) < 0)
+                    perm[o++] = perm[j++];
+                else
+                    perm[o++] = tmp[i++];
+            }
+            while (i < mid)
+                perm[o++] = tmp[i++];
+        }
+    }
+}
+
+#endif //KNIT_SORT_H
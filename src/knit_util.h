@@ -6,100 +6,204 @@ static void knit_assert_h(int condition, const char *fmt, ...);
 static int knitx_obj_dump(struct knit *knit, struct knit_obj *obj); //fwd
 static int knit_error(struct knit *knit, int err_type, const char *fmt, ...);
 
-#ifdef KNIT_MEM_STATS
-#define KNIT_MAX_ALIGNMENT_REQ 8
-#define KNIT_WRAPPED_DATA_SZ  sizeof(size_t)
-#define KNIT_WRAPPED_SZ (KNIT_WRAPPED_DATA_SZ + (KNIT_WRAPPED_DATA_SZ % KNIT_MAX_ALIGNMENT_REQ))
+static void knit_gc_cycle(struct knit *knit); //fwd
 
-static size_t ptr_wrap_needed_sz(size_t sz) {
-    return sz + KNIT_WRAPPED_SZ;
-}
-static void ptr_wrap_szt_store(void *up, size_t n) {
-    unsigned char *c = up;
-    for (unsigned i=0; i<sizeof(size_t); i++) {
-        c[i] = n & 0xFF;
-        n >>= 8;
-    } 
-}
-static size_t ptr_wrap_szt_get(void *up) {
-    unsigned char *c = up;
-    size_t n = 0;
-    for (int i=sizeof(size_t) - 1; i >= 0; i--) {
-        n <<= 8;
-        n |= c[i];
-    } 
-    return n;
-}
-static void *ptr_wrap(void *p, size_t sz) {
-    ptr_wrap_szt_store(p, sz);   
-    return ((char *) p) + KNIT_WRAPPED_SZ;
-}
-static void *ptr_unwrap(void *p) {
-    if (!p)
-        return NULL;
-    return ((char *) p) - KNIT_WRAPPED_SZ;
-}
-static size_t ptr_wrap_get_sz(void *p) {
-    if (!p) {
-        return 0;
-    }
-    return ptr_wrap_szt_get(ptr_unwrap(p));
-}
-#else
-static size_t ptr_wrap_needed_sz(size_t sz) {
-    return sz;
-}
-static void *ptr_wrap(void *p, size_t sz) {
-    return p;
+/*
+Every byte requested through knitx_rmalloc()/knitx_rrealloc() (and so the slab chunks, the gc heap and
+the stack darrays, which charge their growth explicitly) is counted in knit->mem_used. When mem_limit is
+set and a request would cross it, a gc cycle is run first and the request fails with KNIT_NOMEM
+only if the collection didn't free enough. Frees have to pass the size of the block they release.
+*/
+static int knitx_mem_over_limit(struct knit *knit, size_t sz) {
+    return knit->mem_limit && knit->mem_used + sz > knit->mem_limit;
 }
-static void *ptr_unwrap(void *p) {
-    return p;
-}
-static size_t ptr_wrap_get_sz(void *p) {
-    return 0;
+
+//the gc is blocked while parsing (constants of unfinished blocks aren't reachable) and while collecting
+static void knitx_mem_collect(struct knit *knit) {
+    if (knit->mem_gc_blocked)
+        return;
+    knit->mem_gc_blocked++;
+    knit_gc_cycle(knit);
+    knit->mem_gc_blocked--;
 }
-#endif
 
+static int knitx_mem_charge(struct knit *knit, size_t sz) {
+    if (knitx_mem_over_limit(knit, sz)) {
+        knitx_mem_collect(knit);
+        if (knitx_mem_over_limit(knit, sz)) {
+            size_t limit = knit->mem_limit;
+            knit->mem_limit = 0; //the error message itself has to be allocated
+            int rv = knit_error(knit, KNIT_NOMEM, "memory limit of %zu bytes exceeded (%zu in use, %zu requested)",
+                                limit, knit->mem_used, sz);
+            knit->mem_limit = limit;
+            return rv;
+        }
+    }
+    knit->mem_used += sz;
+    return KNIT_OK;
+}
 
+static void knitx_mem_uncharge(struct knit *knit, size_t sz) {
+    knit_assert_h(knit->mem_used >= sz, "knitx_mem_uncharge(): releasing more than was charged");
+    knit->mem_used -= sz;
+}
 
-static int knitx_rfree(struct knit *knit, void *p) {
-    (void) knit;
-    KMEMSTAT_FREE(knit, ptr_wrap_get_sz(p));
-    free(ptr_unwrap(p));
+//sz must be the size p was allocated (or last reallocated) with
+static int knitx_rfree(struct knit *knit, void *p, size_t sz) {
+    if (!p)
+        return KNIT_OK;
+    KMEMSTAT_FREE(knit);
+    knitx_mem_uncharge(knit, sz);
+    free(p);
     return KNIT_OK;
 }
 static int knitx_rmalloc(struct knit *knit, size_t sz, void **m) {
     KMEMSTAT_ALLOC(knit, sz);
     knit_assert_h(sz, "knit_malloc(): 0 size passed");
-    void *p = malloc(ptr_wrap_needed_sz(sz));
     *m = NULL;
-    if (!p)
+    int rv = knitx_mem_charge(knit, sz);
+    if (rv != KNIT_OK)
+        return rv;
+    void *p = malloc(sz);
+    if (!p) {
+        knitx_mem_uncharge(knit, sz);
         return knit_error(knit, KNIT_NOMEM, "knitx_malloc(): malloc() returned NULL");
-    *m = ptr_wrap(p, sz);
+    }
+    *m = p;
     return KNIT_OK;
 }
-static int knitx_rrealloc(struct knit *knit, void *p, size_t sz, void **m) {
-    KMEMSTAT_REALLOC(knit, ptr_wrap_get_sz(p), sz);
+static int knitx_rrealloc(struct knit *knit, void *p, size_t old_sz, size_t sz, void **m) {
     if (!sz) {
-        int rv = knitx_rfree(knit, p);
+        int rv = knitx_rfree(knit, p, old_sz);
         *m = NULL;
         return rv;
     }
-    void *np = realloc(ptr_unwrap(p), ptr_wrap_needed_sz(sz));
+    KMEMSTAT_REALLOC(knit, sz);
+    if (sz > old_sz) {
+        int rv = knitx_mem_charge(knit, sz - old_sz);
+        if (rv != KNIT_OK)
+            return rv;
+    }
+    void *np = realloc(p, sz);
     if (!np) {
+        if (sz > old_sz)
+            knitx_mem_uncharge(knit, sz - old_sz);
         return knit_error(knit, KNIT_NOMEM, "knitx_realloc(): realloc() returned NULL");
     }
-    *m = ptr_wrap(np, sz);
+    if (sz < old_sz)
+        knitx_mem_uncharge(knit, old_sz - sz);
+    *m = np;
+    return KNIT_OK;
+}
+static void knit_slab_init(struct knit_slab *slab) {
+    memset(slab, 0, sizeof *slab);
+}
+
+static void knit_slab_deinit(struct knit *knit, struct knit_slab *slab) {
+    struct knit_slab_chunk *chunk = slab->chunks;
+    while (chunk) {
+        struct knit_slab_chunk *next = chunk->next;
+        knitx_rfree(knit, chunk, KNIT_SLAB_CHUNK_SZ);
+        chunk = next;
+    }
+    knit_slab_init(slab);
+}
+
+//the size class of sz, -1 if it's too big to be served by the slab
+static int knit_slab_class(size_t sz) {
+    int cls = 0;
+    size_t cls_sz = 1 << KNIT_SLAB_MIN_SHIFT;
+    while (cls_sz < sz) {
+        cls_sz <<= 1;
+        cls++;
+    }
+    return cls < KNIT_SLAB_NCLASSES ? cls : -1;
+}
+
+//the size of the block that actually backs an allocation of sz, callers that track a capacity can use all of it
+static size_t knit_slab_usable_size(size_t sz) {
+    int cls = knit_slab_class(sz);
+    if (cls < 0)
+        return sz;
+    return (size_t) 1 << (cls + KNIT_SLAB_MIN_SHIFT);
+}
+
+static int knitx_slab_alloc(struct knit *knit, size_t sz, void **m) {
+    int cls = knit_slab_class(sz);
+    if (cls < 0)
+        return knitx_rmalloc(knit, sz, m);
+    struct knit_slab *slab = &knit->ex.slab;
+    if (slab->free_lists[cls]) {
+        *m = slab->free_lists[cls];
+        slab->free_lists[cls] = *(void **) *m;
+        return KNIT_OK;
+    }
+    size_t cls_sz = (size_t) 1 << (cls + KNIT_SLAB_MIN_SHIFT);
+    if ((size_t) (slab->bump_end - slab->bump) < cls_sz) {
+        //collecting may refill the free list and spare a new chunk
+        if (knitx_mem_over_limit(knit, KNIT_SLAB_CHUNK_SZ)) {
+            knitx_mem_collect(knit);
+            if (slab->free_lists[cls])
+                return knitx_slab_alloc(knit, sz, m);
+        }
+        //the tail of the previous chunk is wasted, it's smaller than the largest class
+        void *p = NULL;
+        int rv = knitx_rmalloc(knit, KNIT_SLAB_CHUNK_SZ, &p);
+        if (rv != KNIT_OK)
+            return rv;
+        struct knit_slab_chunk *chunk = p;
+        chunk->next = slab->chunks;
+        slab->chunks = chunk;
+        slab->bump = (char *) p + (1 << KNIT_SLAB_MIN_SHIFT); //keeps blocks 16 byte aligned
+        slab->bump_end = (char *) p + KNIT_SLAB_CHUNK_SZ;
+    }
+    *m = slab->bump;
+    slab->bump += cls_sz;
     return KNIT_OK;
 }
+
+//sz must be the size p was allocated (or last reallocated) with
+static int knitx_slab_free(struct knit *knit, void *p, size_t sz) {
+    if (!p)
+        return KNIT_OK;
+    int cls = knit_slab_class(sz);
+    if (cls < 0)
+        return knitx_rfree(knit, p, sz);
+    struct knit_slab *slab = &knit->ex.slab;
+    *(void **) p = slab->free_lists[cls];
+    slab->free_lists[cls] = p;
+    return KNIT_OK;
+}
+
+static int knitx_slab_realloc(struct knit *knit, void *p, size_t old_sz, size_t sz, void **m) {
+    if (!p)
+        return knitx_slab_alloc(knit, sz, m);
+    int old_cls = knit_slab_class(old_sz);
+    int cls = knit_slab_class(sz);
+    if (old_cls < 0 && cls < 0)
+        return knitx_rrealloc(knit, p, old_sz, sz, m);
+    if (old_cls == cls) {
+        *m = p;
+        return KNIT_OK;
+    }
+    void *np = NULL;
+    int rv = knitx_slab_alloc(knit, sz, &np);
+    if (rv != KNIT_OK)
+        return rv;
+    memcpy(np, p, old_sz < sz ? old_sz : sz);
+    knitx_slab_free(knit, p, old_sz);
+    *m = np;
+    return KNIT_OK;
+}
+
 static int knitx_tmalloc(struct knit *knit, size_t sz, void **m) {
     return knitx_rmalloc(knit, sz, m);
 }
-static int knitx_tfree(struct knit *knit, void *p) {
-    return knitx_rfree(knit, p);
+static int knitx_tfree(struct knit *knit, void *p, size_t sz) {
+    return knitx_rfree(knit, p, sz);
 }
-static int knitx_trealloc(struct knit *knit, void *p, size_t sz, void **m) {
-    return knitx_rrealloc(knit, p, sz, m);
+static int knitx_trealloc(struct knit *knit, void *p, size_t old_sz, size_t sz, void **m) {
+    return knitx_rrealloc(knit, p, old_sz, sz, m);
 }
 
 #endif
@@ -12,14 +12,19 @@ int knitx_str_strip(struct knit *kstate) {
         return knit_error(kstate, KNIT_INVALID_TYPE_ERR, "knitx_str_strip(self, ...) was called with an unexpected type, expecting str");
     }
 
-    struct knit_str *dupped = NULL;
-    rv = knitx_str_new_copy_gcobj(kstate, &dupped, (struct knit_str *) self); 
+    struct knit_str *self_s = (struct knit_str *) self;
+    int begin, end;
+    rv = knitx_str_strip_bounds(kstate, self_s, " \n\t\f", KNITX_STRIP_LEFT | KNITX_STRIP_RIGHT, &begin, &end); 
     if (rv != KNIT_OK)
         return rv;
-    rv = knitx_str_mutstrip(kstate, dupped, " \n\t\f", KNITX_STRIP_LEFT | KNITX_STRIP_RIGHT); 
-    if (rv != KNIT_OK)
-        return rv;
-    knitx_stack_rpush(kstate, &kstate->ex.stack, ktobj(dupped));
+    struct knit_str *stripped = self_s; //strings are immutable from scripts, so an unchanged one is returned as is
+    if (begin != 0 || end != self_s->len) {
+        rv = knitx_str_new_view_gcobj(kstate, &stripped, self_s, begin, end); 
+        if (rv != KNIT_OK)
+            return rv;
+        stripped->flags |= KNIT_STR_FROZEN;
+    }
+    knitx_stack_rpush(kstate, &kstate->ex.stack, ktobj(stripped));
 
     knitx_creturns(kstate, 1);
     return KNIT_OK;
@@ -37,13 +42,620 @@ int knitx_list_append(struct knit *kstate) {
     rv = knitx_get_arg(kstate, 1, &pushed); 
     if (rv != KNIT_OK)
         return rv;
-    if (self->u.ktype != KNIT_LIST) {
-        return knit_error(kstate, KNIT_INVALID_TYPE_ERR, "knitx_str_strip(self, ...) was called with an unexpected type, expecting str");
-    }
-    struct knit_list *self_l = (struct knit_list *) self;
-    rv = knitx_list_push(kstate, self_l, pushed);
+    if (self->u.ktype != KNIT_LIST) {
+        return knit_error(kstate, KNIT_INVALID_TYPE_ERR, "knitx_str_strip(self, ...) was called with an unexpected type, expecting str");
+    }
+    struct knit_list *self_l = (struct knit_list *) self;
+    rv = knitx_list_push(kstate, self_l, pushed);
+    if (rv != KNIT_OK)
+        return rv;
+
+    knitx_creturns(kstate, 0);
+    return KNIT_OK;
+}
+int knitx_list_sort_method(struct knit *kstate) {
+    int nargs = knitx_nargs(kstate);
+    if (nargs != 1) { //1 for 'self'
+        return knit_error(kstate, KNIT_NARGS, "knitx_list_sort(self) was called with a wrong number of arguments, expecting 0 arguments");
+    }
+    struct knit_obj *self = NULL;
+    int rv = knitx_get_arg(kstate, 0, &self); 
+    if (rv != KNIT_OK)
+        return rv;
+    if (self->u.ktype != KNIT_LIST) {
+        return knit_error(kstate, KNIT_INVALID_TYPE_ERR, "knitx_list_sort(self) was called with an unexpected type, expecting list");
+    }
+    rv = knitx_list_sort(kstate, &self->u.list, NULL);
+    if (rv != KNIT_OK)
+        return rv;
+
+    knitx_creturns(kstate, 0);
+    return KNIT_OK;
+}
+
+int knitx_strbuilder_append(struct knit *kstate) {
+    int nargs = knitx_nargs(kstate);
+    if (nargs != 2) { //1 for 'self'
+        return knit_error(kstate, KNIT_NARGS, "knitx_strbuilder_append(self, ...) was called with a wrong number of arguments, expecting 1 argument");
+    }
+    struct knit_obj *self = NULL;
+    int rv = knitx_get_arg(kstate, 0, &self); 
+    if (rv != KNIT_OK)
+        return rv;
+    struct knit_obj *appended = NULL;
+    rv = knitx_get_arg(kstate, 1, &appended); 
+    if (rv != KNIT_OK)
+        return rv;
+    if (self->u.ktype != KNIT_STRBUILDER) {
+        return knit_error(kstate, KNIT_INVALID_TYPE_ERR, "knitx_strbuilder_append(self, ...) was called with an unexpected type, expecting a string builder");
+    }
+    struct knit_str *buf = &self->u.strbuilder.buf;
+    if (appended->u.ktype == KNIT_STR) {
+        rv = knitx_str_flatten(kstate, &appended->u.str);
+        if (rv != KNIT_OK)
+            return rv;
+        rv = knitx_str_strlappend(kstate, buf, appended->u.str.str, appended->u.str.len);
+    }
+    else {
+        //other types are appended the same way print() shows them
+        struct knit_str tmp;
+        rv = knitx_str_init(kstate, &tmp); 
+        if (rv != KNIT_OK)
+            return rv;
+        rv = knitx_obj_rep(kstate, appended, &tmp, 1); 
+        if (rv == KNIT_OK)
+            rv = knitx_str_strlappend(kstate, buf, tmp.str, tmp.len);
+        knitx_str_deinit(kstate, &tmp);
+    }
+    if (rv != KNIT_OK)
+        return rv;
+
+    knitx_creturns(kstate, 0);
+    return KNIT_OK;
+}
+
+//checks the arguments of a bitset method, self followed by nints ints that are stored in ints
+static int knitx_bitset_method_args(struct knit *kstate, const char *sig, int nints, struct knit_bitset **self_out, int *ints) {
+    int nargs = knitx_nargs(kstate);
+    if (nargs != nints + 1) { //1 for 'self'
+        return knit_error(kstate, KNIT_NARGS, "%s was called with a wrong number of arguments, expecting %d arguments", sig, nints);
+    }
+    struct knit_obj *self = NULL;
+    int rv = knitx_get_arg(kstate, 0, &self); 
+    if (rv != KNIT_OK)
+        return rv;
+    if (self->u.ktype != KNIT_BITSET) {
+        return knit_error(kstate, KNIT_INVALID_TYPE_ERR, "%s was called with an unexpected type, expecting a bitset", sig);
+    }
+    for (int i=0; i<nints; i++) {
+        struct knit_obj *arg = NULL;
+        rv = knitx_get_arg(kstate, i + 1, &arg); 
+        if (rv != KNIT_OK)
+            return rv;
+        if (arg->u.ktype != KNIT_INT) {
+            return knit_error(kstate, KNIT_INVALID_TYPE_ERR, "%s was called with an unexpected type, expecting ints", sig);
+        }
+        ints[i] = arg->u.integer.value;
+    }
+    *self_out = &self->u.bitset.bits;
+    return KNIT_OK;
+}
+
+static int knitx_bitset_range_method(struct knit *kstate, const char *sig, bool state) {
+    struct knit_bitset *bits = NULL;
+    int bounds[2];
+    int rv = knitx_bitset_method_args(kstate, sig, 2, &bits, bounds);
+    if (rv != KNIT_OK)
+        return rv;
+    if (bounds[0] < 0 || bounds[0] > bounds[1] || (size_t) bounds[1] > bits->bit_len) {
+        return knit_error(kstate, KNIT_OUT_OF_RANGE_ERR, "%s was called with a range that is out of the bitset", sig);
+    }
+    bitset_set_range(bits, bounds[0], bounds[1], state);
+    knitx_creturns(kstate, 0);
+    return KNIT_OK;
+}
+//b.set_range(begin, end) and b.clear_range(begin, end) set/clear the bits [begin, end) a word at a time
+int knitx_bitset_set_range(struct knit *kstate) {
+    return knitx_bitset_range_method(kstate, "bitset.set_range(begin, end)", 1);
+}
+int knitx_bitset_clear_range(struct knit *kstate) {
+    return knitx_bitset_range_method(kstate, "bitset.clear_range(begin, end)", 0);
+}
+
+int knitx_bitset_count(struct knit *kstate) {
+    struct knit_bitset *bits = NULL;
+    int rv = knitx_bitset_method_args(kstate, "bitset.count()", 0, &bits, NULL);
+    if (rv != KNIT_OK)
+        return rv;
+    struct knit_int *num = NULL;
+    rv = knitx_int_new_gcobj(kstate, &num, (int) bitset_count(bits)); 
+    if (rv != KNIT_OK)
+        return rv;
+    knitx_stack_rpush(kstate, &kstate->ex.stack, ktobj(num));
+    knitx_creturns(kstate, 1);
+    return KNIT_OK;
+}
+
+static int knitx_bitset_find_method(struct knit *kstate, const char *sig, bool state) {
+    struct knit_bitset *bits = NULL;
+    int from = 0;
+    int rv = knitx_bitset_method_args(kstate, sig, 1, &bits, &from);
+    if (rv != KNIT_OK)
+        return rv;
+    if (from < 0) {
+        return knit_error(kstate, KNIT_OUT_OF_RANGE_ERR, "%s was called with a negative index", sig);
+    }
+    long found = state ? bitset_find_true_bit(bits, from) : bitset_find_false_bit(bits, from);
+    struct knit_int *num = NULL;
+    rv = knitx_int_new_gcobj(kstate, &num, (int) found); 
+    if (rv != KNIT_OK)
+        return rv;
+    knitx_stack_rpush(kstate, &kstate->ex.stack, ktobj(num));
+    knitx_creturns(kstate, 1);
+    return KNIT_OK;
+}
+//b.next_set(i) and b.next_unset(i) return the index of the first bit >= i that is set/unset, or -1
+int knitx_bitset_next_set(struct knit *kstate) {
+    return knitx_bitset_find_method(kstate, "bitset.next_set(index)", 1);
+}
+int knitx_bitset_next_unset(struct knit *kstate) {
+    return knitx_bitset_find_method(kstate, "bitset.next_unset(index)", 0);
+}
+
+static int knitx_bitset_bulk_method(struct knit *kstate, const char *sig, int op) {
+    int nargs = knitx_nargs(kstate);
+    if (nargs != 2) { //1 for 'self'
+        return knit_error(kstate, KNIT_NARGS, "%s was called with a wrong number of arguments, expecting 1 argument", sig);
+    }
+    struct knit_obj *self = NULL;
+    int rv = knitx_get_arg(kstate, 0, &self); 
+    if (rv != KNIT_OK)
+        return rv;
+    struct knit_obj *other = NULL;
+    rv = knitx_get_arg(kstate, 1, &other); 
+    if (rv != KNIT_OK)
+        return rv;
+    if (self->u.ktype != KNIT_BITSET || other->u.ktype != KNIT_BITSET) {
+        return knit_error(kstate, KNIT_INVALID_TYPE_ERR, "%s was called with an unexpected type, expecting bitsets", sig);
+    }
+    if (self->u.bitset.bits.bit_len != other->u.bitset.bits.bit_len) {
+        return knit_error(kstate, KNIT_RUNTIME_ERR, "%s was called with bitsets of different lengths", sig);
+    }
+    bitset_bulk_op(&self->u.bitset.bits, &other->u.bitset.bits, op);
+    knitx_creturns(kstate, 0);
+    return KNIT_OK;
+}
+//a.bit_and(b), a.bit_or(b), a.bit_xor(b) and a.bit_andn(b) (a & ~b) update a in place
+int knitx_bitset_bit_and(struct knit *kstate) {
+    return knitx_bitset_bulk_method(kstate, "bitset.bit_and(other)", KNIT_BITSET_AND);
+}
+int knitx_bitset_bit_or(struct knit *kstate) {
+    return knitx_bitset_bulk_method(kstate, "bitset.bit_or(other)", KNIT_BITSET_OR);
+}
+int knitx_bitset_bit_xor(struct knit *kstate) {
+    return knitx_bitset_bulk_method(kstate, "bitset.bit_xor(other)", KNIT_BITSET_XOR);
+}
+int knitx_bitset_bit_andn(struct knit *kstate) {
+    return knitx_bitset_bulk_method(kstate, "bitset.bit_andn(other)", KNIT_BITSET_ANDN);
+}
+
+//checks the arguments of an array method, self followed by nargs_after arguments, other must have room for them
+static int knitx_array_method_args(struct knit *kstate, const char *sig, int nargs_after, struct knit_array **self_out, struct knit_obj **other) {
+    int nargs = knitx_nargs(kstate);
+    if (nargs != nargs_after + 1) { //1 for 'self'
+        return knit_error(kstate, KNIT_NARGS, "%s was called with a wrong number of arguments, expecting %d arguments", sig, nargs_after);
+    }
+    struct knit_obj *self = NULL;
+    int rv = knitx_get_arg(kstate, 0, &self); 
+    if (rv != KNIT_OK)
+        return rv;
+    if (self->u.ktype != KNIT_ARRAY) {
+        return knit_error(kstate, KNIT_INVALID_TYPE_ERR, "%s was called with an unexpected type, expecting an array", sig);
+    }
+    for (int i=0; i<nargs_after; i++) {
+        rv = knitx_get_arg(kstate, i + 1, &other[i]); 
+        if (rv != KNIT_OK)
+            return rv;
+    }
+    *self_out = &self->u.array;
+    return KNIT_OK;
+}
+//other must be an array of the same type and length as arr
+static int knitx_array_check_same_shape(struct knit *kstate, const char *sig, struct knit_array *arr, struct knit_obj *other) {
+    if (other->u.ktype != KNIT_ARRAY) {
+        return knit_error(kstate, KNIT_INVALID_TYPE_ERR, "%s was called with an unexpected type, expecting an array", sig);
+    }
+    if (other->u.array.elem_type != arr->elem_type || other->u.array.len != arr->len) {
+        return knit_error(kstate, KNIT_RUNTIME_ERR, "%s was called with arrays of different types or lengths", sig);
+    }
+    return KNIT_OK;
+}
+static int knitx_array_return_int64(struct knit *kstate, const char *sig, int64_t result) {
+    if (result < INT_MIN || result > INT_MAX) {
+        return knit_error(kstate, KNIT_OUT_OF_RANGE_ERR, "%s result %lld doesn't fit in an int", sig, (long long) result);
+    }
+    struct knit_int *num = NULL;
+    int rv = knitx_int_new_gcobj(kstate, &num, (int) result); 
+    if (rv != KNIT_OK)
+        return rv;
+    knitx_stack_rpush(kstate, &kstate->ex.stack, ktobj(num));
+    knitx_creturns(kstate, 1);
+    return KNIT_OK;
+}
+
+int knitx_array_sum(struct knit *kstate) {
+    struct knit_array *arr = NULL;
+    int rv = knitx_array_method_args(kstate, "array.sum()", 0, &arr, NULL);
+    if (rv != KNIT_OK)
+        return rv;
+    int64_t result = 0;
+    int fits = 0;
+    KNIT_ARRAY_DISPATCH(fits =, knit_array_sum, arr, arr->len, &result);
+    if (!fits) {
+        return knit_error(kstate, KNIT_OUT_OF_RANGE_ERR, "array.sum() result doesn't fit in 64 bits");
+    }
+    return knitx_array_return_int64(kstate, "array.sum()", result);
+}
+static int knitx_array_min_max(struct knit *kstate, const char *sig, int is_max) {
+    struct knit_array *arr = NULL;
+    int rv = knitx_array_method_args(kstate, sig, 0, &arr, NULL);
+    if (rv != KNIT_OK)
+        return rv;
+    if (!arr->len) {
+        return knit_error(kstate, KNIT_RUNTIME_ERR, "%s was called on an empty array", sig);
+    }
+    int64_t result = 0;
+    if (is_max)
+        KNIT_ARRAY_DISPATCH(result =, knit_array_max, arr, arr->len);
+    else
+        KNIT_ARRAY_DISPATCH(result =, knit_array_min, arr, arr->len);
+    return knitx_array_return_int64(kstate, sig, result);
+}
+int knitx_array_min(struct knit *kstate) {
+    return knitx_array_min_max(kstate, "array.min()", 0);
+}
+int knitx_array_max(struct knit *kstate) {
+    return knitx_array_min_max(kstate, "array.max()", 1);
+}
+int knitx_array_dot(struct knit *kstate) {
+    struct knit_array *arr = NULL;
+    struct knit_obj *other = NULL;
+    int rv = knitx_array_method_args(kstate, "array.dot(other)", 1, &arr, &other);
+    if (rv != KNIT_OK)
+        return rv;
+    rv = knitx_array_check_same_shape(kstate, "array.dot(other)", arr, other);
+    if (rv != KNIT_OK)
+        return rv;
+    int64_t result = 0;
+    int fits = 0;
+    KNIT_ARRAY_DISPATCH(fits =, knit_array_dot, arr, arr->len, other->u.array.data, &result);
+    if (!fits) {
+        return knit_error(kstate, KNIT_OUT_OF_RANGE_ERR, "array.dot(other) result doesn't fit in 64 bits");
+    }
+    return knitx_array_return_int64(kstate, "array.dot(other)", result);
+}
+//a.scale(k) multiplies every element by k in place
+int knitx_array_scale(struct knit *kstate) {
+    struct knit_array *arr = NULL;
+    struct knit_obj *k = NULL;
+    int rv = knitx_array_method_args(kstate, "array.scale(k)", 1, &arr, &k);
+    if (rv != KNIT_OK)
+        return rv;
+    if (k->u.ktype != KNIT_INT) {
+        return knit_error(kstate, KNIT_INVALID_TYPE_ERR, "array.scale(k) was called with an unexpected type, expecting int");
+    }
+    KNIT_ARRAY_DISPATCH(, knit_array_scale, arr, arr->len, k->u.integer.value);
+    knitx_creturns(kstate, 0);
+    return KNIT_OK;
+}
+//a.add(b) adds b to a elementwise in place
+int knitx_array_add(struct knit *kstate) {
+    struct knit_array *arr = NULL;
+    struct knit_obj *other = NULL;
+    int rv = knitx_array_method_args(kstate, "array.add(other)", 1, &arr, &other);
+    if (rv != KNIT_OK)
+        return rv;
+    rv = knitx_array_check_same_shape(kstate, "array.add(other)", arr, other);
+    if (rv != KNIT_OK)
+        return rv;
+    KNIT_ARRAY_DISPATCH(, knit_array_add, arr, arr->len, other->u.array.data);
+    knitx_creturns(kstate, 0);
+    return KNIT_OK;
+}
+static int knitx_array_mask(struct knit *kstate, const char *sig, int cmp) {
+    struct knit_array *arr = NULL;
+    struct knit_obj *k = NULL;
+    int rv = knitx_array_method_args(kstate, sig, 1, &arr, &k);
+    if (rv != KNIT_OK)
+        return rv;
+    if (k->u.ktype != KNIT_INT) {
+        return knit_error(kstate, KNIT_INVALID_TYPE_ERR, "%s was called with an unexpected type, expecting int", sig);
+    }
+    struct knit_bitset_obj *mask = NULL;
+    rv = knitx_bitset_new_gcobj(kstate, &mask, arr->len);
+    if (rv != KNIT_OK)
+        return rv;
+    KNIT_ARRAY_DISPATCH(, knit_array_mask, arr, arr->len, cmp, k->u.integer.value, mask->bits.data);
+    rv = knitx_stack_rpush(kstate, &kstate->ex.stack, ktobj(mask));
+    if (rv != KNIT_OK)
+        return rv;
+    knitx_creturns(kstate, 1);
+    return KNIT_OK;
+}
+//a.mask_lt(k), a.mask_gt(k) and a.mask_eq(k) return a bitset of the indices whose element is <, > or == k
+int knitx_array_mask_lt(struct knit *kstate) {
+    return knitx_array_mask(kstate, "array.mask_lt(k)", KNIT_ARRAY_LT);
+}
+int knitx_array_mask_gt(struct knit *kstate) {
+    return knitx_array_mask(kstate, "array.mask_gt(k)", KNIT_ARRAY_GT);
+}
+int knitx_array_mask_eq(struct knit *kstate) {
+    return knitx_array_mask(kstate, "array.mask_eq(k)", KNIT_ARRAY_EQ);
+}
+
+//checks the arguments of a deque method, self followed by nargs_after (0 or 1) arguments stored in arg
+static int knitx_deque_method_args(struct knit *kstate, const char *sig, int nargs_after, struct knit_deque **self_out, struct knit_obj **arg) {
+    int nargs = knitx_nargs(kstate);
+    if (nargs != nargs_after + 1) { //1 for 'self'
+        return knit_error(kstate, KNIT_NARGS, "%s was called with a wrong number of arguments, expecting %d arguments", sig, nargs_after);
+    }
+    struct knit_obj *self = NULL;
+    int rv = knitx_get_arg(kstate, 0, &self); 
+    if (rv != KNIT_OK)
+        return rv;
+    if (self->u.ktype != KNIT_DEQUE) {
+        return knit_error(kstate, KNIT_INVALID_TYPE_ERR, "%s was called with an unexpected type, expecting a deque", sig);
+    }
+    if (nargs_after) {
+        rv = knitx_get_arg(kstate, 1, arg); 
+        if (rv != KNIT_OK)
+            return rv;
+    }
+    *self_out = &self->u.deque;
+    return KNIT_OK;
+}
+static int knitx_deque_push_method(struct knit *kstate, const char *sig, int front) {
+    struct knit_deque *dq = NULL;
+    struct knit_obj *pushed = NULL;
+    int rv = knitx_deque_method_args(kstate, sig, 1, &dq, &pushed);
+    if (rv != KNIT_OK)
+        return rv;
+    rv = knit_deque_push(kstate, dq, pushed, front);
+    if (rv != KNIT_OK)
+        return rv;
+    knitx_creturns(kstate, 0);
+    return KNIT_OK;
+}
+//pops (remove) or peeks at one end of the deque
+static int knitx_deque_end_method(struct knit *kstate, const char *sig, int front, int remove) {
+    struct knit_deque *dq = NULL;
+    int rv = knitx_deque_method_args(kstate, sig, 0, &dq, NULL);
+    if (rv != KNIT_OK)
+        return rv;
+    if (!dq->len) {
+        return knit_error(kstate, KNIT_OUT_OF_RANGE_ERR, "%s was called on an empty deque", sig);
+    }
+    struct knit_obj *obj = remove ? knit_deque_pop(dq, front) : knit_deque_at(dq, front ? 0 : dq->len - 1);
+    rv = knitx_stack_rpush(kstate, &kstate->ex.stack, obj);
+    if (rv != KNIT_OK)
+        return rv;
+    knitx_creturns(kstate, 1);
+    return KNIT_OK;
+}
+int knitx_deque_push_back(struct knit *kstate) {
+    return knitx_deque_push_method(kstate, "deque.push_back(item)", 0);
+}
+int knitx_deque_push_front(struct knit *kstate) {
+    return knitx_deque_push_method(kstate, "deque.push_front(item)", 1);
+}
+int knitx_deque_pop_back(struct knit *kstate) {
+    return knitx_deque_end_method(kstate, "deque.pop_back()", 0, 1);
+}
+int knitx_deque_pop_front(struct knit *kstate) {
+    return knitx_deque_end_method(kstate, "deque.pop_front()", 1, 1);
+}
+int knitx_deque_back(struct knit *kstate) {
+    return knitx_deque_end_method(kstate, "deque.back()", 0, 0);
+}
+int knitx_deque_front(struct knit *kstate) {
+    return knitx_deque_end_method(kstate, "deque.front()", 1, 0);
+}
+
+//h.push(item), the key function of the heap (if any) is called here, once per item
+int knitx_pqueue_push(struct knit *kstate) {
+    int nargs = knitx_nargs(kstate);
+    if (nargs != 2) { //1 for 'self'
+        return knit_error(kstate, KNIT_NARGS, "heap.push(item) was called with a wrong number of arguments, expecting 1 argument");
+    }
+    struct knit_obj *self = NULL;
+    int rv = knitx_get_arg(kstate, 0, &self); 
+    if (rv != KNIT_OK)
+        return rv;
+    struct knit_obj *item = NULL;
+    rv = knitx_get_arg(kstate, 1, &item); 
+    if (rv != KNIT_OK)
+        return rv;
+    if (self->u.ktype != KNIT_PQUEUE) {
+        return knit_error(kstate, KNIT_INVALID_TYPE_ERR, "heap.push(item) was called with an unexpected type, expecting a heap");
+    }
+    struct knit_pqueue *pq = &self->u.pqueue;
+    struct knit_obj *key = item;
+    if (pq->key_func) {
+        //knitx_call1() pushed the key on the nursery, a collection while the heap grows can't free it
+        rv = knitx_call1(kstate, pq->key_func, item, &key);
+        if (rv != KNIT_OK)
+            return rv;
+    }
+    rv = knit_pqueue_push(kstate, pq, item, key);
+    if (rv != KNIT_OK)
+        return rv;
+    knitx_creturns(kstate, 0);
+    return KNIT_OK;
+}
+//h.pop() removes the item with the smallest key and h.peek() returns it
+static int knitx_pqueue_top_method(struct knit *kstate, const char *sig, int remove) {
+    int nargs = knitx_nargs(kstate);
+    if (nargs != 1) { //1 for 'self'
+        return knit_error(kstate, KNIT_NARGS, "%s was called with a wrong number of arguments, expecting 0 arguments", sig);
+    }
+    struct knit_obj *self = NULL;
+    int rv = knitx_get_arg(kstate, 0, &self); 
+    if (rv != KNIT_OK)
+        return rv;
+    if (self->u.ktype != KNIT_PQUEUE) {
+        return knit_error(kstate, KNIT_INVALID_TYPE_ERR, "%s was called with an unexpected type, expecting a heap", sig);
+    }
+    struct knit_pqueue *pq = &self->u.pqueue;
+    if (!pq->len) {
+        return knit_error(kstate, KNIT_OUT_OF_RANGE_ERR, "%s was called on an empty heap", sig);
+    }
+    struct knit_obj *item = remove ? knit_pqueue_pop(pq) : pq->entries[0].item;
+    rv = knitx_stack_rpush(kstate, &kstate->ex.stack, item);
+    if (rv != KNIT_OK)
+        return rv;
+    knitx_creturns(kstate, 1);
+    return KNIT_OK;
+}
+int knitx_pqueue_pop(struct knit *kstate) {
+    return knitx_pqueue_top_method(kstate, "heap.pop()", 1);
+}
+int knitx_pqueue_peek(struct knit *kstate) {
+    return knitx_pqueue_top_method(kstate, "heap.peek()", 0);
+}
+
+//checks the arguments of a set method, self followed by one argument stored in arg
+static int knitx_set_method_args(struct knit *kstate, const char *sig, struct knit_set **self_out, struct knit_obj **arg) {
+    int nargs = knitx_nargs(kstate);
+    if (nargs != 2) { //1 for 'self'
+        return knit_error(kstate, KNIT_NARGS, "%s was called with a wrong number of arguments, expecting 1 argument", sig);
+    }
+    struct knit_obj *self = NULL;
+    int rv = knitx_get_arg(kstate, 0, &self); 
+    if (rv != KNIT_OK)
+        return rv;
+    if (self->u.ktype != KNIT_SET) {
+        return knit_error(kstate, KNIT_INVALID_TYPE_ERR, "%s was called with an unexpected type, expecting a set", sig);
+    }
+    rv = knitx_get_arg(kstate, 1, arg); 
+    if (rv != KNIT_OK)
+        return rv;
+    *self_out = &self->u.set;
+    return KNIT_OK;
+}
+int knitx_set_add(struct knit *kstate) {
+    struct knit_set *set = NULL;
+    struct knit_obj *elem = NULL;
+    int rv = knitx_set_method_args(kstate, "set.add(elem)", &set, &elem);
+    if (rv != KNIT_OK)
+        return rv;
+    rv = knit_set_add(kstate, set, elem);
+    if (rv != KNIT_OK)
+        return rv;
+    knitx_creturns(kstate, 0);
+    return KNIT_OK;
+}
+//s.remove(elem) returns false if elem wasn't in s
+int knitx_set_remove(struct knit *kstate) {
+    struct knit_set *set = NULL;
+    struct knit_obj *elem = NULL;
+    int rv = knitx_set_method_args(kstate, "set.remove(elem)", &set, &elem);
+    if (rv != KNIT_OK)
+        return rv;
+    int removed = 0;
+    rv = knit_set_remove(kstate, set, elem, &removed);
+    if (rv != KNIT_OK)
+        return rv;
+    rv = knitx_stack_rpush(kstate, &kstate->ex.stack, (struct knit_obj *) (removed ? &ktrue : &kfalse));
+    if (rv != KNIT_OK)
+        return rv;
+    knitx_creturns(kstate, 1);
+    return KNIT_OK;
+}
+int knitx_set_contains(struct knit *kstate) {
+    struct knit_set *set = NULL;
+    struct knit_obj *elem = NULL;
+    int rv = knitx_set_method_args(kstate, "set.contains(elem)", &set, &elem);
+    if (rv != KNIT_OK)
+        return rv;
+    int found = 0;
+    rv = knit_set_contains(kstate, set, elem, &found);
+    if (rv != KNIT_OK)
+        return rv;
+    rv = knitx_stack_rpush(kstate, &kstate->ex.stack, (struct knit_obj *) (found ? &ktrue : &kfalse));
+    if (rv != KNIT_OK)
+        return rv;
+    knitx_creturns(kstate, 1);
+    return KNIT_OK;
+}
+//union, intersection and difference return a new set
+static int knitx_set_bulk_method(struct knit *kstate, const char *sig, int (*op)(struct knit *, struct knit_set *, struct knit_set *, struct knit_set *)) {
+    struct knit_set *set = NULL;
+    struct knit_obj *other = NULL;
+    int rv = knitx_set_method_args(kstate, sig, &set, &other);
+    if (rv != KNIT_OK)
+        return rv;
+    if (other->u.ktype != KNIT_SET) {
+        return knit_error(kstate, KNIT_INVALID_TYPE_ERR, "%s was called with an unexpected type, expecting a set", sig);
+    }
+    struct knit_set *result = NULL;
+    rv = knitx_set_new_gcobj(kstate, &result);
+    if (rv != KNIT_OK)
+        return rv;
+    rv = op(kstate, result, set, &other->u.set);
+    if (rv != KNIT_OK)
+        return rv;
+    rv = knitx_stack_rpush(kstate, &kstate->ex.stack, ktobj(result));
+    if (rv != KNIT_OK)
+        return rv;
+    knitx_creturns(kstate, 1);
+    return KNIT_OK;
+}
+int knitx_set_union(struct knit *kstate) {
+    return knitx_set_bulk_method(kstate, "set.union(other)", knit_set_union);
+}
+int knitx_set_intersection(struct knit *kstate) {
+    return knitx_set_bulk_method(kstate, "set.intersection(other)", knit_set_intersection);
+}
+int knitx_set_difference(struct knit *kstate) {
+    return knitx_set_bulk_method(kstate, "set.difference(other)", knit_set_difference);
+}
+
+int knitx_strbuilder_build(struct knit *kstate) {
+    int nargs = knitx_nargs(kstate);
+    if (nargs != 1) { //1 for 'self'
+        return knit_error(kstate, KNIT_NARGS, "knitx_strbuilder_build(self) was called with a wrong number of arguments, expecting 0 arguments");
+    }
+    struct knit_obj *self = NULL;
+    int rv = knitx_get_arg(kstate, 0, &self); 
+    if (rv != KNIT_OK)
+        return rv;
+    if (self->u.ktype != KNIT_STRBUILDER) {
+        return knit_error(kstate, KNIT_INVALID_TYPE_ERR, "knitx_strbuilder_build(self) was called with an unexpected type, expecting a string builder");
+    }
+    struct knit_str *buf = &self->u.strbuilder.buf;
+    struct knit_str *s = NULL;
+    rv = knitx_str_new_strlcpy_gcobj(kstate, &s, buf->str, buf->len);
+    if (rv != KNIT_OK)
+        return rv;
+    s->flags |= KNIT_STR_FROZEN;
+    knitx_stack_rpush(kstate, &kstate->ex.stack, ktobj(s));
+
+    knitx_creturns(kstate, 1);
+    return KNIT_OK;
+}
+
+int knitxr_string_builder(struct knit *kstate) {
+    int nargs = knitx_nargs(kstate);
+    if (nargs != 0) { 
+        return knit_error(kstate, KNIT_NARGS, "string_builder() was called with a wrong number of arguments, expecting 0 arguments");
+    }
+    struct knit_strbuilder *sb = NULL;
+    int rv = knitx_strbuilder_new_gcobj(kstate, &sb); 
+    if (rv != KNIT_OK)
+        return rv;
+    knitx_stack_rpush(kstate, &kstate->ex.stack, ktobj(sb));
 
-    knitx_creturns(kstate, 0);
+    knitx_creturns(kstate, 1);
     return KNIT_OK;
 }
 
@@ -64,8 +676,10 @@ int knitxr_substr(struct knit *kstate) {
     if (str_obj->u.ktype != KNIT_STR || begin_index_obj->u.ktype != KNIT_INT || end_index_obj->u.ktype != KNIT_INT) {
         return knit_error(kstate, KNIT_INVALID_TYPE_ERR, "substr(str, begin, end) was called with unexpected types, expecting <str, int, int>");
     }
+    rv = knitx_str_flatten(kstate, &str_obj->u.str);
+    if (rv != KNIT_OK)
+        return rv;
 
-    char *str = str_obj->u.str.str;
     int string_length = str_obj->u.str.len;
     int begin = begin_index_obj->u.integer.value;
     int end   = end_index_obj->u.integer.value;
@@ -74,9 +688,10 @@ int knitxr_substr(struct knit *kstate) {
         return knit_error(kstate, KNIT_RUNTIME_ERR, "substr(str, begin, end) was called with out of range indices");
 
     struct knit_str *s = NULL;
-    rv = knitx_str_new_strlcpy_gcobj(kstate, &s, str + begin, end - begin);
+    rv = knitx_str_new_view_gcobj(kstate, &s, &str_obj->u.str, begin, end);
     if (rv != KNIT_OK)
         return knit_error(kstate, KNIT_RUNTIME_ERR, "substr(str, begin, end) failed");
+    s->flags |= KNIT_STR_FROZEN;
 
     knitx_stack_rpush(kstate, &kstate->ex.stack, ktobj(s));
 
@@ -96,6 +711,7 @@ int knitxr_input(struct knit *kstate) {
         s->str[s->len-1] = 0;
         s->len--;
     }
+    s->flags |= KNIT_STR_FROZEN;
     knitx_stack_rpush(kstate, &kstate->ex.stack, ktobj(s));
 
     knitx_creturns(kstate, 1);
@@ -110,7 +726,13 @@ int knitxr_str_to_int(struct knit *kstate) {
     int rv = knitx_get_arg(kstate, 0, &stro); 
     if (rv != KNIT_OK)
         return rv;
+    if (stro->u.ktype != KNIT_STR) {
+        return knit_error(kstate, KNIT_INVALID_TYPE_ERR, "knitx_str_to_int(str) was called with an unexpected type, expecting str");
+    }
     struct knit_str *str = (struct knit_str *)stro;
+    rv = knitx_str_materialize(kstate, str);
+    if (rv != KNIT_OK)
+        return rv;
     
     int n = atoi(str->str);
     struct knit_int *num = NULL;
@@ -164,6 +786,27 @@ static int knitxr_len(struct knit *kstate) {
     else if (obj->u.ktype == KNIT_STR) {
         num->value = obj->u.str.len;
     }
+    else if (obj->u.ktype == KNIT_STRBUILDER) {
+        num->value = obj->u.strbuilder.buf.len;
+    }
+    else if (obj->u.ktype == KNIT_RANGE) {
+        num->value = knitx_range_len(&obj->u.range);
+    }
+    else if (obj->u.ktype == KNIT_BITSET) {
+        num->value = (int) obj->u.bitset.bits.bit_len;
+    }
+    else if (obj->u.ktype == KNIT_ARRAY) {
+        num->value = obj->u.array.len;
+    }
+    else if (obj->u.ktype == KNIT_DEQUE) {
+        num->value = obj->u.deque.len;
+    }
+    else if (obj->u.ktype == KNIT_PQUEUE) {
+        num->value = obj->u.pqueue.len;
+    }
+    else if (obj->u.ktype == KNIT_SET) {
+        num->value = obj->u.set.len;
+    }
     else {
         return knit_error(kstate, KNIT_INVALID_TYPE_ERR, "knitx_len(obj) was called with an unexpected type, expecting str or list");
     }
@@ -172,6 +815,248 @@ static int knitxr_len(struct knit *kstate) {
     knitx_creturns(kstate, 1);
     return KNIT_OK;
 }
+//sorted(list) and sorted(list, key) return a sorted copy of list, key is called once per element
+static int knitxr_sorted(struct knit *kstate) {
+    int nargs = knitx_nargs(kstate);
+    if (nargs != 1 && nargs != 2) { 
+        return knit_error(kstate, KNIT_NARGS, "sorted(list, key) was called with a wrong number of arguments, expecting 1 or 2 arguments");
+    }
+    struct knit_obj *list_obj = NULL;
+    int rv = knitx_get_arg(kstate, 0, &list_obj); 
+    if (rv != KNIT_OK)
+        return rv;
+    struct knit_obj *key_func = NULL;
+    if (nargs == 2) {
+        rv = knitx_get_arg(kstate, 1, &key_func); 
+        if (rv != KNIT_OK)
+            return rv;
+    }
+    if (list_obj->u.ktype != KNIT_LIST) {
+        return knit_error(kstate, KNIT_INVALID_TYPE_ERR, "sorted(list, key) was called with an unexpected type, expecting list");
+    }
+    struct knit_list *list = &list_obj->u.list;
+    //the new lists stay rooted by the nursery while the key function runs
+    struct knit_list *copy = NULL;
+    rv = knitx_list_new_copy_gcobj(kstate, &copy, list); 
+    if (rv != KNIT_OK)
+        return rv;
+    struct knit_list *keys = NULL;
+    if (key_func) {
+        rv = knitx_list_new_gcobj(kstate, &keys, 0); 
+        if (rv != KNIT_OK)
+            return rv;
+        //the boxed elements and the keys of previous calls are reachable from the lists, so they
+        //are dropped from the nursery or it would keep every one of them alive until sorted() returns
+        struct knit_objp_darray *nursery = &kstate->ex.heap.nursery;
+        int nursery_base = nursery->len;
+        for (int i=0; i<copy->len; i++) {
+            nursery->len = nursery_base;
+            struct knit_obj *elem = NULL;
+            struct knit_obj *key = NULL;
+            rv = knitx_list_get(kstate, copy, i, &elem);
+            if (rv != KNIT_OK)
+                return rv;
+            rv = knitx_call1(kstate, key_func, elem, &key);
+            if (rv != KNIT_OK)
+                return rv;
+            rv = knitx_list_push(kstate, keys, key);
+            if (rv != KNIT_OK)
+                return rv;
+        }
+    }
+    rv = knitx_list_sort(kstate, copy, keys);
+    if (rv != KNIT_OK)
+        return rv;
+    rv = knitx_stack_rpush(kstate, &kstate->ex.stack, ktobj(copy));
+    if (rv != KNIT_OK)
+        return rv;
+    knitx_creturns(kstate, 1);
+    return KNIT_OK;
+}
+//range(end), range(begin, end) and range(begin, end, step), the ints aren't stored, for-in loops produce them one at a time
+static int knitxr_range(struct knit *kstate) {
+    int nargs = knitx_nargs(kstate);
+    if (nargs < 1 || nargs > 3) { 
+        return knit_error(kstate, KNIT_NARGS, "range(begin, end, step) was called with a wrong number of arguments, expecting 1 to 3 arguments");
+    }
+    int bounds[3] = {0, 0, 1};
+    for (int i=0; i<nargs; i++) {
+        struct knit_obj *arg = NULL;
+        int rv = knitx_get_arg(kstate, i, &arg); 
+        if (rv != KNIT_OK)
+            return rv;
+        if (arg->u.ktype != KNIT_INT) {
+            return knit_error(kstate, KNIT_INVALID_TYPE_ERR, "range(begin, end, step) was called with an unexpected type, expecting ints");
+        }
+        bounds[nargs == 1 ? 1 : i] = arg->u.integer.value;
+    }
+    if (bounds[2] == 0) {
+        return knit_error(kstate, KNIT_RUNTIME_ERR, "range(begin, end, step) was called with a step of 0");
+    }
+    struct knit_range *range = NULL;
+    int rv = knitx_range_new_gcobj(kstate, &range, bounds[0], bounds[1], bounds[2]);
+    if (rv != KNIT_OK)
+        return rv;
+    rv = knitx_stack_rpush(kstate, &kstate->ex.stack, ktobj(range));
+    if (rv != KNIT_OK)
+        return rv;
+    knitx_creturns(kstate, 1);
+    return KNIT_OK;
+}
+//bitset(n) returns n bits all cleared, they take a bit each instead of a list slot
+static int knitxr_bitset(struct knit *kstate) {
+    int nargs = knitx_nargs(kstate);
+    if (nargs != 1) { 
+        return knit_error(kstate, KNIT_NARGS, "bitset(n) was called with a wrong number of arguments, expecting 1 argument");
+    }
+    struct knit_obj *n = NULL;
+    int rv = knitx_get_arg(kstate, 0, &n); 
+    if (rv != KNIT_OK)
+        return rv;
+    if (n->u.ktype != KNIT_INT) {
+        return knit_error(kstate, KNIT_INVALID_TYPE_ERR, "bitset(n) was called with an unexpected type, expecting int");
+    }
+    if (n->u.integer.value < 0) {
+        return knit_error(kstate, KNIT_OUT_OF_RANGE_ERR, "bitset(n) was called with a negative size");
+    }
+    struct knit_bitset_obj *bs = NULL;
+    rv = knitx_bitset_new_gcobj(kstate, &bs, n->u.integer.value);
+    if (rv != KNIT_OK)
+        return rv;
+    rv = knitx_stack_rpush(kstate, &kstate->ex.stack, ktobj(bs));
+    if (rv != KNIT_OK)
+        return rv;
+    knitx_creturns(kstate, 1);
+    return KNIT_OK;
+}
+//array(type, n) returns n zeros of type "int32", "int64" or "uint8" stored contiguously
+static int knitxr_array(struct knit *kstate) {
+    int nargs = knitx_nargs(kstate);
+    if (nargs != 2) { 
+        return knit_error(kstate, KNIT_NARGS, "array(type, n) was called with a wrong number of arguments, expecting 2 arguments");
+    }
+    struct knit_obj *type = NULL;
+    int rv = knitx_get_arg(kstate, 0, &type); 
+    if (rv != KNIT_OK)
+        return rv;
+    struct knit_obj *n = NULL;
+    rv = knitx_get_arg(kstate, 1, &n); 
+    if (rv != KNIT_OK)
+        return rv;
+    if (type->u.ktype != KNIT_STR || n->u.ktype != KNIT_INT) {
+        return knit_error(kstate, KNIT_INVALID_TYPE_ERR, "array(type, n) was called with unexpected types, expecting <str, int>");
+    }
+    rv = knitx_str_flatten(kstate, &type->u.str);
+    if (rv != KNIT_OK)
+        return rv;
+    int elem_type = knit_array_type_from_name(type->u.str.str, type->u.str.len);
+    if (elem_type < 0) {
+        return knit_error(kstate, KNIT_RUNTIME_ERR, "array(type, n) was called with an unknown type, expecting int32, int64 or uint8");
+    }
+    if (n->u.integer.value < 0) {
+        return knit_error(kstate, KNIT_OUT_OF_RANGE_ERR, "array(type, n) was called with a negative size");
+    }
+    struct knit_array *arr = NULL;
+    rv = knitx_array_new_gcobj(kstate, &arr, elem_type, n->u.integer.value, NULL);
+    if (rv != KNIT_OK)
+        return rv;
+    rv = knitx_stack_rpush(kstate, &kstate->ex.stack, ktobj(arr));
+    if (rv != KNIT_OK)
+        return rv;
+    knitx_creturns(kstate, 1);
+    return KNIT_OK;
+}
+//deque() returns an empty deque, items are pushed and popped at both ends in O(1)
+static int knitxr_deque(struct knit *kstate) {
+    int nargs = knitx_nargs(kstate);
+    if (nargs != 0) { 
+        return knit_error(kstate, KNIT_NARGS, "deque() was called with a wrong number of arguments, expecting 0 arguments");
+    }
+    struct knit_deque *dq = NULL;
+    int rv = knitx_deque_new_gcobj(kstate, &dq);
+    if (rv != KNIT_OK)
+        return rv;
+    rv = knitx_stack_rpush(kstate, &kstate->ex.stack, ktobj(dq));
+    if (rv != KNIT_OK)
+        return rv;
+    knitx_creturns(kstate, 1);
+    return KNIT_OK;
+}
+//heap() and heap(key) return an empty min-heap, items are ordered by key(item) or by themselves
+static int knitxr_heap(struct knit *kstate) {
+    int nargs = knitx_nargs(kstate);
+    if (nargs != 0 && nargs != 1) { 
+        return knit_error(kstate, KNIT_NARGS, "heap(key) was called with a wrong number of arguments, expecting 0 or 1 arguments");
+    }
+    struct knit_obj *key_func = NULL;
+    if (nargs == 1) {
+        int rv = knitx_get_arg(kstate, 0, &key_func); 
+        if (rv != KNIT_OK)
+            return rv;
+        if (key_func->u.ktype != KNIT_KFUNC && key_func->u.ktype != KNIT_CFUNC) {
+            return knit_error(kstate, KNIT_INVALID_TYPE_ERR, "heap(key) was called with an unexpected type, expecting a function");
+        }
+    }
+    struct knit_pqueue *pq = NULL;
+    int rv = knitx_pqueue_new_gcobj(kstate, &pq, key_func);
+    if (rv != KNIT_OK)
+        return rv;
+    rv = knitx_stack_rpush(kstate, &kstate->ex.stack, ktobj(pq));
+    if (rv != KNIT_OK)
+        return rv;
+    knitx_creturns(kstate, 1);
+    return KNIT_OK;
+}
+//set() returns an empty set, set(list) a set of the elements of list
+static int knitxr_set(struct knit *kstate) {
+    int nargs = knitx_nargs(kstate);
+    if (nargs != 0 && nargs != 1) { 
+        return knit_error(kstate, KNIT_NARGS, "set(list) was called with a wrong number of arguments, expecting 0 or 1 arguments");
+    }
+    struct knit_obj *init = NULL;
+    if (nargs == 1) {
+        int rv = knitx_get_arg(kstate, 0, &init); 
+        if (rv != KNIT_OK)
+            return rv;
+        if (init->u.ktype != KNIT_LIST) {
+            return knit_error(kstate, KNIT_INVALID_TYPE_ERR, "set(list) was called with an unexpected type, expecting a list");
+        }
+    }
+    struct knit_set *set = NULL;
+    int rv = knitx_set_new_gcobj(kstate, &set);
+    if (rv != KNIT_OK)
+        return rv;
+    for (int i=0; init && i<init->u.list.len; i++) {
+        struct knit_int tmp_int;
+        rv = knit_set_add(kstate, set, knitx_list_peek(kstate, &init->u.list, i, &tmp_int));
+        if (rv != KNIT_OK)
+            return rv;
+    }
+    rv = knitx_stack_rpush(kstate, &kstate->ex.stack, ktobj(set));
+    if (rv != KNIT_OK)
+        return rv;
+    knitx_creturns(kstate, 1);
+    return KNIT_OK;
+}
+//freeze(obj) makes obj immutable and returns it, frozen strings are used as dict keys without being copied
+static int knitxr_freeze(struct knit *kstate) {
+    int nargs = knitx_nargs(kstate);
+    if (nargs != 1) { 
+        return knit_error(kstate, KNIT_NARGS, "freeze(obj) was called with a wrong number of arguments, expecting 1 argument");
+    }
+    struct knit_obj *obj = NULL;
+    int rv = knitx_get_arg(kstate, 0, &obj); 
+    if (rv != KNIT_OK)
+        return rv;
+    rv = knitx_obj_freeze(kstate, obj);
+    if (rv != KNIT_OK)
+        return rv;
+    rv = knitx_stack_rpush(kstate, &kstate->ex.stack, obj);
+    if (rv != KNIT_OK)
+        return rv;
+    knitx_creturns(kstate, 1);
+    return KNIT_OK;
+}
 static int knitxr_gcwalk(struct knit *kstate) {
     int nargs = knitx_nargs(kstate);
     if (nargs != 0) { 
@@ -187,8 +1072,7 @@ static int knitxr_meminfo(struct knit *kstate) {
     if (nargs != 0) { 
         return knit_error(kstate, KNIT_NARGS, "knitxr_meminfo(obj) was called with a wrong number of arguments, expecting 0 arguments");
     }
-    printf("hey\n");
-    #ifdef KNIT_MEM_STATS
+    #ifdef KNIT_MEM_PROFILE
         knit_mem_stats_dump(kstate, &kstate->mstats);
     #endif
     knitx_creturns(kstate, 0);
@@ -206,6 +1090,162 @@ const struct knit_builtins kbuiltins = {
         .append = {
             .ktype = KNIT_CFUNC,
             .fptr = knitx_list_append,
+        },
+        .sort = {
+            .ktype = KNIT_CFUNC,
+            .fptr = knitx_list_sort_method,
+        }
+    },
+    .kstrbuilder = {
+        .append = {
+            .ktype = KNIT_CFUNC,
+            .fptr = knitx_strbuilder_append,
+        },
+        .build = {
+            .ktype = KNIT_CFUNC,
+            .fptr = knitx_strbuilder_build,
+        }
+    },
+    .kbitset = {
+        .set_range = {
+            .ktype = KNIT_CFUNC,
+            .fptr = knitx_bitset_set_range,
+        },
+        .clear_range = {
+            .ktype = KNIT_CFUNC,
+            .fptr = knitx_bitset_clear_range,
+        },
+        .count = {
+            .ktype = KNIT_CFUNC,
+            .fptr = knitx_bitset_count,
+        },
+        .next_set = {
+            .ktype = KNIT_CFUNC,
+            .fptr = knitx_bitset_next_set,
+        },
+        .next_unset = {
+            .ktype = KNIT_CFUNC,
+            .fptr = knitx_bitset_next_unset,
+        },
+        .bit_and = {
+            .ktype = KNIT_CFUNC,
+            .fptr = knitx_bitset_bit_and,
+        },
+        .bit_or = {
+            .ktype = KNIT_CFUNC,
+            .fptr = knitx_bitset_bit_or,
+        },
+        .bit_xor = {
+            .ktype = KNIT_CFUNC,
+            .fptr = knitx_bitset_bit_xor,
+        },
+        .bit_andn = {
+            .ktype = KNIT_CFUNC,
+            .fptr = knitx_bitset_bit_andn,
+        }
+    },
+    .karray = {
+        .sum = {
+            .ktype = KNIT_CFUNC,
+            .fptr = knitx_array_sum,
+        },
+        .min = {
+            .ktype = KNIT_CFUNC,
+            .fptr = knitx_array_min,
+        },
+        .max = {
+            .ktype = KNIT_CFUNC,
+            .fptr = knitx_array_max,
+        },
+        .dot = {
+            .ktype = KNIT_CFUNC,
+            .fptr = knitx_array_dot,
+        },
+        .scale = {
+            .ktype = KNIT_CFUNC,
+            .fptr = knitx_array_scale,
+        },
+        .add = {
+            .ktype = KNIT_CFUNC,
+            .fptr = knitx_array_add,
+        },
+        .mask_lt = {
+            .ktype = KNIT_CFUNC,
+            .fptr = knitx_array_mask_lt,
+        },
+        .mask_gt = {
+            .ktype = KNIT_CFUNC,
+            .fptr = knitx_array_mask_gt,
+        },
+        .mask_eq = {
+            .ktype = KNIT_CFUNC,
+            .fptr = knitx_array_mask_eq,
+        }
+    },
+    .kdeque = {
+        .push_back = {
+            .ktype = KNIT_CFUNC,
+            .fptr = knitx_deque_push_back,
+        },
+        .push_front = {
+            .ktype = KNIT_CFUNC,
+            .fptr = knitx_deque_push_front,
+        },
+        .pop_back = {
+            .ktype = KNIT_CFUNC,
+            .fptr = knitx_deque_pop_back,
+        },
+        .pop_front = {
+            .ktype = KNIT_CFUNC,
+            .fptr = knitx_deque_pop_front,
+        },
+        .back = {
+            .ktype = KNIT_CFUNC,
+            .fptr = knitx_deque_back,
+        },
+        .front = {
+            .ktype = KNIT_CFUNC,
+            .fptr = knitx_deque_front,
+        }
+    },
+    .kpqueue = {
+        .push = {
+            .ktype = KNIT_CFUNC,
+            .fptr = knitx_pqueue_push,
+        },
+        .pop = {
+            .ktype = KNIT_CFUNC,
+            .fptr = knitx_pqueue_pop,
+        },
+        .peek = {
+            .ktype = KNIT_CFUNC,
+            .fptr = knitx_pqueue_peek,
+        }
+    },
+    .kset = {
+        .add = {
+            .ktype = KNIT_CFUNC,
+            .fptr = knitx_set_add,
+        },
+        .remove = {
+            .ktype = KNIT_CFUNC,
+            .fptr = knitx_set_remove,
+        },
+        .contains = {
+            .ktype = KNIT_CFUNC,
+            .fptr = knitx_set_contains,
+        },
+        .union_ = {
+            .ktype = KNIT_CFUNC,
+            .fptr = knitx_set_union,
+        },
+        .intersection = {
+            .ktype = KNIT_CFUNC,
+            .fptr = knitx_set_intersection,
+        },
+        .difference = {
+            .ktype = KNIT_CFUNC,
+            .fptr = knitx_set_difference,
         }
     },
     .funcs = {
@@ -236,6 +1276,42 @@ const struct knit_builtins kbuiltins = {
         .meminfo = {
             .ktype = KNIT_CFUNC,
             .fptr = knitxr_meminfo,
+        },
+        .string_builder = {
+            .ktype = KNIT_CFUNC,
+            .fptr = knitxr_string_builder,
+        },
+        .freeze = {
+            .ktype = KNIT_CFUNC,
+            .fptr = knitxr_freeze,
+        },
+        .sorted = {
+            .ktype = KNIT_CFUNC,
+            .fptr = knitxr_sorted,
+        },
+        .range = {
+            .ktype = KNIT_CFUNC,
+            .fptr = knitxr_range,
+        },
+        .bitset = {
+            .ktype = KNIT_CFUNC,
+            .fptr = knitxr_bitset,
+        },
+        .array = {
+            .ktype = KNIT_CFUNC,
+            .fptr = knitxr_array,
+        },
+        .deque = {
+            .ktype = KNIT_CFUNC,
+            .fptr = knitxr_deque,
+        },
+        .heap = {
+            .ktype = KNIT_CFUNC,
+            .fptr = knitxr_heap,
+        },
+        .set = {
+            .ktype = KNIT_CFUNC,
+            .fptr = knitxr_set,
         }
     }
 };
@@ -287,6 +1363,33 @@ static int knitxr_register_stdlib(struct knit *kstate) {
     if (rv != KNIT_OK)
         return rv;
     rv = knitx_register_constcfunction(kstate, "meminfo", &kbuiltins.funcs.meminfo); 
+    if (rv != KNIT_OK)
+        return rv;
+    rv = knitx_register_constcfunction(kstate, "string_builder", &kbuiltins.funcs.string_builder); 
+    if (rv != KNIT_OK)
+        return rv;
+    rv = knitx_register_constcfunction(kstate, "freeze", &kbuiltins.funcs.freeze); 
+    if (rv != KNIT_OK)
+        return rv;
+    rv = knitx_register_constcfunction(kstate, "sorted", &kbuiltins.funcs.sorted); 
+    if (rv != KNIT_OK)
+        return rv;
+    rv = knitx_register_constcfunction(kstate, "range", &kbuiltins.funcs.range); 
+    if (rv != KNIT_OK)
+        return rv;
+    rv = knitx_register_constcfunction(kstate, "bitset", &kbuiltins.funcs.bitset); 
+    if (rv != KNIT_OK)
+        return rv;
+    rv = knitx_register_constcfunction(kstate, "array", &kbuiltins.funcs.array); 
+    if (rv != KNIT_OK)
+        return rv;
+    rv = knitx_register_constcfunction(kstate, "deque", &kbuiltins.funcs.deque); 
+    if (rv != KNIT_OK)
+        return rv;
+    rv = knitx_register_constcfunction(kstate, "heap", &kbuiltins.funcs.heap); 
+    if (rv != KNIT_OK)
+        return rv;
+    rv = knitx_register_constcfunction(kstate, "set", &kbuiltins.funcs.set); 
     if (rv != KNIT_OK)
         return rv;
     return KNIT_OK;
@@ -13,6 +13,7 @@ static struct knopts {
     int verbose;
     int interactive;
     char *infile;
+    char *memprofile;
 } knopts = {0};
 
 static void help(char *progname) {
@@ -20,6 +21,7 @@ static void help(char *progname) {
             "-f     : input file\n"
             "-v     : verbose\n"
             "-i     : interactive\n"
+            "-p     : write a sampled allocation profile (collapsed stacks) to a file, needs KNIT_MEM_PROFILE\n"
             "-h     : help\n", progname == NULL ? "knit" : progname);
     exit(0);
 }
@@ -45,6 +47,10 @@ static void parse_argv(char *argv[], int argc) {
                 i++;
             }
         }
+        else if (strcmp(argv[i], "-p") == 0 && argc > i + 1) {
+            knopts.memprofile = argv[i+1];
+            i++;
+        }
         else if (i == argc - 1) {
             knopts.infile = argv[i];
         }
@@ -79,6 +85,17 @@ char *readordie(const char *filename) {
     return m;
 }
 
+static void write_memprofile(struct knit *knit) {
+    if (!knopts.memprofile)
+        return;
+    FILE *f = fopen(knopts.memprofile, "w");
+    if (!f)
+        idie("failed to open '%s'\n", knopts.memprofile);
+    if (knitx_mem_profile_dump(knit, f) != KNIT_OK)
+        fprintf(stderr, "knit was built without KNIT_MEM_PROFILE, no profile was written\n");
+    fclose(f);
+}
+
 void interactive(const char *n) {
     struct knit knit;
     knitx_init(&knit, KNIT_POLICY_EXIT);
@@ -137,6 +154,7 @@ void interactive(const char *n) {
         knitx_globals_dump(&knit);
     }
 #endif
+    write_memprofile(&knit);
     knitx_deinit(&knit);
 }
 
@@ -156,6 +174,7 @@ void exec_file(const char *filename) {
         knitx_globals_dump(&knit);
     }
 #endif
+    write_memprofile(&knit);
     knitx_deinit(&knit);
 }
 int main(int argc, char **argv) {